@@ -0,0 +1,174 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include "config.h"
+#include "common.h"
+
+#include <stdint.h>
+
+// Cortex-M7 L1 caches and TCM
+//
+// The caches are enabled by reset_handler() (CONFIG_ARM_ICACHE /
+// CONFIG_ARM_DCACHE) and turned off again just before the jump to the
+// application, which starts with the core as it comes out of reset.
+//
+// Without an MPU configuration the flash is normal write-through memory, so
+// the D-cache never holds dirty flash lines, but it does hold stale ones once
+// the flash changes under it: after programming / erasing, after filling the
+// latch (latch writes are flash writes as far as the cache is concerned) and
+// around reading the user signature (mapped over the flash array). The flash
+// drivers invalidate the affected range with cache_dcache_invalidate_range().
+//
+// The TCMs are sized by the GPNVM bits (set when the part is programmed, not
+// here); CONFIG_ITCM_SIZE / CONFIG_DTCM_SIZE have to match. Code marked
+// __itcm and data marked __dtcm is placed in them by the linker script.
+
+#define SCB_CCR			MMIO32(0xE000ED14)
+#define SCB_CCSIDR		MMIO32(0xE000ED80)
+#define SCB_CSSELR		MMIO32(0xE000ED84)
+#define SCB_ICIALLU		MMIO32(0xE000EF50)
+#define SCB_DCIMVAC		MMIO32(0xE000EF5C)
+#define SCB_DCISW		MMIO32(0xE000EF60)
+#define SCB_DCCISW		MMIO32(0xE000EF74)
+#define SCB_ITCMCR		MMIO32(0xE000EF90)
+#define SCB_DTCMCR		MMIO32(0xE000EF94)
+
+#define SCB_CCR_DC		(1 << 16)
+#define SCB_CCR_IC		(1 << 17)
+
+#define SCB_TCMCR_EN	(1 << 0)
+
+#define CACHE_LINE_SIZE	32
+
+// CCSIDR geometry of the selected cache
+#define CCSIDR_SETS(ccsidr)		((((ccsidr) >> 13) & 0x7FFF) + 1)
+#define CCSIDR_WAYS(ccsidr)		((((ccsidr) >> 3) & 0x3FF) + 1)
+
+// Set / way operand for the M7 data cache (4 ways, 32 byte lines)
+#define DCSW(set, way)	(((way) << 30) | ((set) << 5))
+
+__attribute__((always_inline)) static inline void cache_icache_enable( void )
+{
+	__DSB();
+	__ISB();
+	SCB_ICIALLU = 0;
+	__DSB();
+	__ISB();
+	SCB_CCR |= SCB_CCR_IC;
+	__DSB();
+	__ISB();
+}
+
+__attribute__((always_inline)) static inline void cache_icache_disable( void )
+{
+	__DSB();
+	__ISB();
+	SCB_CCR &= ~SCB_CCR_IC;
+	SCB_ICIALLU = 0;
+	__DSB();
+	__ISB();
+}
+
+// Invalidate (enable) or clean + invalidate (disable) every line by set / way
+__attribute__((always_inline)) static inline void __cache_dcache_all( volatile uint32_t * op )
+{
+	uint32_t ccsidr;
+	uint32_t sets;
+	uint32_t ways;
+	uint32_t way;
+
+	SCB_CSSELR = 0; // L1 data cache
+	__DSB();
+
+	ccsidr = SCB_CCSIDR;
+	sets = CCSIDR_SETS( ccsidr );
+	ways = CCSIDR_WAYS( ccsidr );
+
+	while ( sets-- ) {
+		for ( way = 0; way < ways; way++ ) {
+			*op = DCSW( sets, way );
+		}
+	}
+
+	__DSB();
+}
+
+__attribute__((always_inline)) static inline void cache_dcache_enable( void )
+{
+	__cache_dcache_all( &SCB_DCISW ); // Contents are undefined out of reset
+	SCB_CCR |= SCB_CCR_DC;
+	__DSB();
+	__ISB();
+}
+
+__attribute__((always_inline)) static inline void cache_dcache_disable( void )
+{
+	SCB_CCR &= ~SCB_CCR_DC;
+	__DSB();
+	__cache_dcache_all( &SCB_DCCISW ); // Write back SRAM lines first
+	__ISB();
+}
+
+// Drop the lines covering [addr, addr + len); only for write-through memory
+// (the flash), anything dirty in the range is lost
+__attribute__((always_inline)) static inline void cache_dcache_invalidate_range( uint32_t addr, uint32_t len )
+{
+#if defined(CONFIG_ARM_DCACHE)
+	uint32_t end = addr + len;
+
+	__DSB();
+	for ( addr &= ~(CACHE_LINE_SIZE - 1); addr < end; addr += CACHE_LINE_SIZE ) {
+		SCB_DCIMVAC = addr;
+	}
+	__DSB();
+	__ISB();
+#else
+	(void)addr;
+	(void)len;
+#endif // defined(CONFIG_ARM_DCACHE)
+}
+
+// Called by reset_handler() before main()
+__attribute__((always_inline)) static inline void cache_init( void )
+{
+#if defined(CONFIG_ARM_ICACHE)
+	cache_icache_enable();
+#endif // defined(CONFIG_ARM_ICACHE)
+
+#if defined(CONFIG_ARM_DCACHE)
+	cache_dcache_enable();
+#endif // defined(CONFIG_ARM_DCACHE)
+}
+
+// Hand the core over with the caches off (and the D-cache written back)
+__attribute__((always_inline)) static inline void cache_deinit( void )
+{
+#if defined(CONFIG_ARM_DCACHE)
+	cache_dcache_disable();
+#endif // defined(CONFIG_ARM_DCACHE)
+
+#if defined(CONFIG_ARM_ICACHE)
+	cache_icache_disable();
+#endif // defined(CONFIG_ARM_ICACHE)
+}
+
+__attribute__((always_inline)) static inline void tcm_init( void )
+{
+#if defined(CONFIG_TCM)
+	SCB_ITCMCR |= SCB_TCMCR_EN;
+	SCB_DTCMCR |= SCB_TCMCR_EN;
+	__DSB();
+	__ISB();
+#endif // defined(CONFIG_TCM)
+}
+
+#endif // CACHE_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,45 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef DWT_H
+#define DWT_H
+
+#include "common.h"
+
+#include <stdint.h>
+
+// Cortex-M Data Watchpoint and Trace unit; only the cycle counter is used. It
+// counts core clock cycles (clock_get_core_hz()) and wraps every 2^32 cycles,
+// so differences must be taken with unsigned arithmetic.
+
+#define DEMCR			MMIO32(0xE000EDFC)
+#define DEMCR_TRCENA	(1 << 24)
+
+#define DWT_BASE		0xE0001000
+#define DWT_CTRL		MMIO32(DWT_BASE + 0x000)
+#define DWT_CYCCNT		MMIO32(DWT_BASE + 0x004)
+#define DWT_LAR			MMIO32(DWT_BASE + 0xFB0)
+
+#define DWT_CTRL_CYCCNTENA	(1 << 0)
+#define DWT_LAR_KEY			0xC5ACCE55 // CoreSight unlock key (required on the M7)
+
+__attribute__((always_inline)) static inline void dwt_init( void )
+{
+	DEMCR |= DEMCR_TRCENA;
+	DWT_LAR = DWT_LAR_KEY;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
+__attribute__((always_inline)) static inline uint32_t dwt_get_cycles( void )
+{
+	return DWT_CYCCNT;
+}
+
+#endif // DWT_H
+
+#ifdef __cplusplus
+}
+#endif
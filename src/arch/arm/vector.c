@@ -2,6 +2,8 @@
 #include "vector.h"
 #include "config.h"
 #include "common.h"
+#include "dwt.h"
+#include "cache.h"
 
 void blocking_handler( void )
 {
@@ -21,6 +23,14 @@ extern uint32_t _szero; // Start of zero-initialized section
 extern uint32_t _ezero; // End of zero-initialized section
 extern uint32_t _estack; // End of stack section (stack start address)
 
+#if defined(CONFIG_TCM)
+extern uint32_t _litcm; // Load address of the ITCM code (in flash)
+extern uint32_t _sitcm; // Start of ITCM code
+extern uint32_t _eitcm; // End of ITCM code
+extern uint32_t _sdtcm; // Start of DTCM data (zero-initialized)
+extern uint32_t _edtcm; // End of DTCM data
+#endif // defined(CONFIG_TCM)
+
 // Vector table
 // TODO: (90) [robustness] @nth Enforce vector table alignment requirements...somehow (here or in linker script)
 __attribute__((section(".vectors")))
@@ -49,15 +59,22 @@ vector_table_t vector_table = {
 // void __attribute__((optimize("-fno-tree-loop-distribute-patterns"))) reset_handler()
 void __attribute__((naked)) reset_handler()
 {
-#if defined(CONFIG_RAM_BUILD)
-	// Set VTOR to FlexRAM vector table
+	// Point VTOR at our vector table in every build: it resets to 0x00000000,
+	// which is where tcm_init() maps the ITCM (and .itcm code is copied over
+	// whatever vectors were there)
 	// TODO: (60) [refactor] @magic Define for VTOR address
 	MMIO32(0xE000ED08) = (uint32_t)&vector_table;
+	__DSB();
 
+#if defined(CONFIG_RAM_BUILD)
 	// Manually set the stack pointer since it's not being initialized while I load out of RAM
 	__set_MSP( (uint32_t)&_estack );
 #endif // defined(CONFIG_RAM_BUILD)
 
+	// Start the cycle counter first thing so it counts from (very nearly) reset;
+	// used as the time base by the trace layer
+	dwt_init();
+
 	// Copy data to SRAM (static data)
 	// /*volatile*/ unsigned *src, *dest;
 	uint32_t *src, *dest;
@@ -72,6 +89,23 @@ void __attribute__((naked)) reset_handler()
 		*dest = 0;
 	}
 
+#if defined(CONFIG_TCM)
+	// The TCMs have to be enabled before anything is copied into them
+	tcm_init();
+
+	for ( src = &_litcm, dest = &_sitcm; dest < &_eitcm; src++, dest++ ) {
+		*dest = *src;
+	}
+
+	for ( dest = &_sdtcm; dest < &_edtcm; dest++ ) {
+		*dest = 0;
+	}
+#endif // defined(CONFIG_TCM)
+
+	// Caches last; nothing above is worth caching and the D-cache would only
+	// have to be cleaned of it
+	cache_init();
+
 	// Call the main function
 	main();
 
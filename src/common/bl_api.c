@@ -0,0 +1,175 @@
+
+#include "bl_api.h"
+#include "config.h"
+
+#include "flash.h"
+#include "crc.h"
+#include "boot_record.h"
+
+#include <stddef.h>
+
+#if defined(CONFIG_BL_API)
+
+_Static_assert( sizeof(bl_api_t) <= BL_API_SIZE, "API table outgrew its reservation" );
+_Static_assert( sizeof(bl_api_partition_t) == sizeof(flash_partition_t), "Partition layouts differ" );
+
+// NOTE: Everything reachable from here runs on the application's behalf after
+// the jump; it must not use the bootloader's RAM (.data / .bss / .ramfunc) or
+// the TCM, which the application owns by then
+
+static int __api_get_partition( uint32_t id, bl_api_partition_t * partition )
+{
+	flash_partition_t p;
+
+	if ( (! partition) || (flash_get_partition( id, &p ) < 0) ) {
+		return (-1);
+	}
+
+	partition->start = p.start;
+	partition->end = p.end;
+
+	return 0;
+}
+
+static int __api_erase_pages( uint32_t id, uint32_t page, uint32_t n_pages )
+{
+	if ( (page > 0xFFFF) || (n_pages > 0xFFFF) ) {
+		return (-2);
+	}
+
+	return flash_erase_pages( id, page, n_pages );
+}
+
+// flash_write_page() without the latch claim (a RAM counter) and without the
+// alignment requirement on 'data'
+static int __api_write_page( uint32_t id, const uint8_t * data, uint32_t page )
+{
+	flash_partition_t partition;
+	volatile uint32_t * latch;
+	uint32_t i;
+
+	if ( (! data) || (flash_get_partition( id, &partition ) < 0) ) {
+		return (-1);
+	}
+
+	if ( page >= ((partition.end - partition.start) / CONFIG_PAGE_SIZE) ) {
+		return (-2);
+	}
+
+	// Any address in the flash array fills the latch; the page's own keeps
+	// the D-cache lines flash_commit_latch() invalidates to the one page
+	latch = (volatile uint32_t *)(partition.start + (page * CONFIG_PAGE_SIZE));
+	for ( i = 0; i < CONFIG_PAGE_SIZE; i += 4 ) {
+		latch[i / 4] = data[i] | (data[i + 1] << 8) | (data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24);
+	}
+
+	return flash_commit_latch( id, page );
+}
+
+#if defined(CONFIG_BOOT_RECORD)
+
+// Program one of the boot record lines shared by both copies (boot_record.h).
+// Only the record block can be read from here (the user signature takes code
+// in RAM); the bootloader keeps the two copies' shared lines the same.
+static int __api_line_write( uint32_t offset, const void * line )
+{
+	int ret;
+
+	ret = flash_program_user_signature( offset, (const uint32_t *)line, BOOT_RECORD_LINE_LEN );
+	if ( ret < 0 ) {
+		return ret;
+	}
+
+	return flash_program_record( offset, (const uint32_t *)line, BOOT_RECORD_LINE_LEN );
+}
+
+static int __api_activate( uint32_t id, uint32_t length, uint32_t crc )
+{
+	const volatile uint32_t * line = (const volatile uint32_t *)(FLASH_RECORD_ADDRESS + offsetof(boot_record_t, activate));
+	boot_record_request_t request;
+	flash_partition_t partition;
+	uint32_t i;
+
+	if ( (id >= BOOT_RECORD_N_SLOTS) || (flash_get_partition( id, &partition ) < 0) ) {
+		return (-1);
+	}
+
+	if ( (length == 0) || (length > (partition.end - partition.start)) ) {
+		return (-1);
+	}
+
+	// Already requested since the last reset (the line is programmed once)
+	for ( i = 0; i < (BOOT_RECORD_LINE_LEN / sizeof(uint32_t)); i++ ) {
+		if ( line[i] != BOOT_RECORD_ERASED ) {
+			return (-2);
+		}
+	}
+
+	request.request = BOOT_RECORD_REQUEST_ACTIVATE;
+	request.slot = id;
+	request.length = length;
+	request.crc = crc;
+
+	return __api_line_write( offsetof(boot_record_t, activate), &request );
+}
+
+// Same as boot_record_confirm(), on the record block's boot log
+static int __api_confirm( void )
+{
+#if defined(CONFIG_BOOT_ATTEMPTS)
+	const boot_record_t * record = (const boot_record_t *)FLASH_RECORD_ADDRESS;
+	boot_record_mark_t mark;
+	uint32_t confirmed;
+	uint32_t attempts;
+	uint32_t next;
+
+	attempts = boot_record_log_count( record, &confirmed, &next );
+	if ( attempts == confirmed ) {
+		return 0;
+	}
+
+	mark.mark = attempts;
+	mark.reserved[0] = BOOT_RECORD_ERASED;
+	mark.reserved[1] = BOOT_RECORD_ERASED;
+	mark.reserved[2] = BOOT_RECORD_ERASED;
+
+	return __api_line_write( offsetof(boot_record_t, confirmed) + (next * BOOT_RECORD_LINE_LEN), &mark );
+#else
+	return 0; // Nothing counted
+#endif // defined(CONFIG_BOOT_ATTEMPTS)
+}
+
+#else
+
+static int __api_activate( uint32_t id, uint32_t length, uint32_t crc )
+{
+	(void)id;
+	(void)length;
+	(void)crc;
+
+	return (-1);
+}
+
+static int __api_confirm( void )
+{
+	return 0;
+}
+
+#endif // defined(CONFIG_BOOT_RECORD)
+
+__attribute__((section(".bl_api"), used))
+const bl_api_t bl_api_g = {
+	.magic = BL_API_MAGIC,
+	.version = BL_API_VERSION,
+	.size = sizeof(bl_api_t),
+	.page_size = CONFIG_PAGE_SIZE,
+	.erase_min_pages = FLASH_ERASE_MIN_PAGES,
+	.crc_32_update = crc_32_update_bytes,
+	.get_partition = __api_get_partition,
+	.erase_pages = __api_erase_pages,
+	.write_page = __api_write_page,
+	.activate = __api_activate,
+	.confirm = __api_confirm
+};
+
+#endif // defined(CONFIG_BL_API)
@@ -0,0 +1,837 @@
+
+#include "boot_record.h"
+
+#include "flash.h"
+#include "crc.h"
+#include "handoff.h"
+#include "dwt.h"
+
+#include <stddef.h>
+
+#if defined(CONFIG_BOOT_RECORD)
+
+// The record has to fit in the user signature (one page) with room for at
+// least one progress line
+_Static_assert( (CONFIG_PAGE_SIZE / BOOT_RECORD_LINE_LEN) > BOOT_RECORD_FIXED_LINES, "Boot record doesn't fit in the user signature; reduce CONFIG_BOOT_LOG_LINES" );
+_Static_assert( sizeof(boot_record_t) == CONFIG_PAGE_SIZE, "Boot record lines aren't 16 bytes" );
+
+// NOTE: Slot index == partition id for the application partitions
+_Static_assert( BOOT_RECORD_N_SLOTS == 2, "Fallback assumes two application slots" );
+
+// A full log is restarted with the unconfirmed boots (fewer than the maximum)
+_Static_assert( BOOT_RECORD_LOG_LINES >= BOOT_RECORD_MAX_ATTEMPTS, "Boot log shorter than CONFIG_BOOT_MAX_ATTEMPTS" );
+
+// The lines kept the same in both copies: the activate request and the boot log
+#define SHARED_START	offsetof(boot_record_t, activate)
+#define SHARED_END		offsetof(boot_record_t, progress)
+
+// Where the copies live; record_g was read from / last written to bank_g
+#define BANK_USER_SIGNATURE		0
+#define BANK_RECORD_BLOCK		1
+
+static boot_record_t record_g;
+static bool valid_g = false;
+static uint32_t bank_g = BANK_RECORD_BLOCK; // The first write goes to the user signature
+
+// The shared lines in record_g were changed other than by programming both
+// copies (e.g. the log restarted); the next rewrite does both copies
+static bool shared_dirty_g = false;
+
+// Pages committed to the upload session; ahead of the flash between checkpoints
+static uint32_t committed_g = 0;
+
+static void __record_clear()
+{
+	uint32_t i;
+	for ( i = 0; i < (sizeof(boot_record_t) / sizeof(uint32_t)); i++ ) {
+		((uint32_t *)&record_g)[i] = BOOT_RECORD_ERASED;
+	}
+}
+
+static int __bank_read( uint32_t bank, uint32_t offset, uint32_t * data, uint32_t len )
+{
+	const volatile uint32_t * block = (const volatile uint32_t *)(FLASH_RECORD_ADDRESS + offset);
+	uint32_t i;
+
+	if ( bank == BANK_USER_SIGNATURE ) {
+		return flash_read_user_signature( offset, data, len );
+	}
+
+	for ( i = 0; i < (len / sizeof(uint32_t)); i++ ) {
+		data[i] = block[i];
+	}
+
+	return 0;
+}
+
+static int __bank_write( uint32_t bank, uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	if ( bank == BANK_USER_SIGNATURE ) {
+		return flash_write_user_signature( offset, data, len );
+	}
+
+	return flash_write_record( offset, data, len );
+}
+
+static int __bank_erase( uint32_t bank )
+{
+	if ( bank == BANK_USER_SIGNATURE ) {
+		return flash_erase_user_signature();
+	}
+
+	return flash_erase_record();
+}
+
+// Program one line of record_g in place (the rest of the copy is untouched)
+static int __line_write( void * line )
+{
+	return __bank_write( bank_g, (uint32_t)((uint8_t *)line - (uint8_t *)&record_g),
+		(uint32_t *)line, BOOT_RECORD_LINE_LEN );
+}
+
+// Program one of the shared lines of record_g into both copies; the one that
+// isn't current needn't be valid, it only has to keep the same lines
+static int __shared_line_write( void * line )
+{
+	uint32_t offset = (uint32_t)((uint8_t *)line - (uint8_t *)&record_g);
+	uint32_t bank = (bank_g == BANK_USER_SIGNATURE) ? BANK_RECORD_BLOCK : BANK_USER_SIGNATURE;
+	int ret;
+
+	ret = __bank_write( bank_g, offset, (uint32_t *)line, BOOT_RECORD_LINE_LEN );
+	if ( ret < 0 ) {
+		return ret;
+	}
+
+	return __bank_write( bank, offset, (uint32_t *)line, BOOT_RECORD_LINE_LEN );
+}
+
+// Whether the shared lines of a copy differ from record_g's
+static bool __bank_shared_differs( uint32_t bank )
+{
+	uint32_t line[BOOT_RECORD_LINE_LEN / sizeof(uint32_t)];
+	uint32_t offset;
+	uint32_t i;
+
+	for ( offset = SHARED_START; offset < SHARED_END; offset += BOOT_RECORD_LINE_LEN ) {
+		if ( __bank_read( bank, offset, line, BOOT_RECORD_LINE_LEN ) < 0 ) {
+			return true;
+		}
+
+		for ( i = 0; i < (BOOT_RECORD_LINE_LEN / sizeof(uint32_t)); i++ ) {
+			if ( line[i] != ((uint32_t *)((uint8_t *)&record_g + offset))[i] ) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Everything up to the marks except the CRC word itself
+static uint32_t __record_crc( const boot_record_t * record )
+{
+	uint32_t crc = CRC_32_INIT_VALUE;
+
+	crc = crc_32_update_block( crc, (const uint8_t *)record, offsetof(boot_record_t, crc) );
+	crc = crc_32_update_block( crc, (const uint8_t *)&record->active,
+		offsetof(boot_record_t, verified) - offsetof(boot_record_t, active) );
+
+	return crc_32_finalize( crc );
+}
+
+// NOTE: A record may exist before any slot is made active (an upload session
+// was started on a blank device)
+static bool __record_is_valid( const boot_record_t * record )
+{
+	return (record->magic == BOOT_RECORD_MAGIC) &&
+		(record->version == BOOT_RECORD_VERSION) &&
+		(record->crc == __record_crc( record )) &&
+		((record->active < BOOT_RECORD_N_SLOTS) || (record->active == BOOT_RECORD_ERASED));
+}
+
+static void __request_copy( boot_record_request_t * dst, const boot_record_request_t * src )
+{
+	dst->request = src->request;
+	dst->slot = src->slot;
+	dst->length = src->length;
+	dst->crc = src->crc;
+}
+
+static void __request_clear( boot_record_request_t * request )
+{
+	request->request = BOOT_RECORD_ERASED;
+	request->slot = BOOT_RECORD_ERASED;
+	request->length = BOOT_RECORD_ERASED;
+	request->crc = BOOT_RECORD_ERASED;
+}
+
+static inline bool __mark_is_set( const boot_record_mark_t * mark )
+{
+	// Anything other than erased counts; a partially programmed mark is still a mark
+	return (mark->mark != BOOT_RECORD_ERASED);
+}
+
+// Restart the boot log with 'unconfirmed' boots in it; the old lines are only
+// dropped by rewriting both copies
+static void __log_reset( uint32_t unconfirmed )
+{
+	uint32_t mark;
+	uint32_t i;
+
+	for ( i = 0; i < BOOT_RECORD_LOG_LINES; i++ ) {
+		mark = (i < unconfirmed) ? BOOT_RECORD_MARK_SET : BOOT_RECORD_ERASED;
+
+		if ( (record_g.attempts[i].mark != mark) || __mark_is_set( &record_g.confirmed[i] ) ) {
+			shared_dirty_g = true;
+		}
+
+		record_g.attempts[i].mark = mark;
+		record_g.confirmed[i].mark = BOOT_RECORD_ERASED;
+	}
+}
+
+static int __mark_set( boot_record_mark_t * mark )
+{
+	mark->mark = BOOT_RECORD_MARK_SET;
+
+	return __line_write( mark );
+}
+
+static inline bool __session_is_open()
+{
+	return valid_g && (record_g.session.slot < BOOT_RECORD_N_SLOTS);
+}
+
+static void __session_clear()
+{
+	uint32_t i;
+
+	record_g.session.slot = BOOT_RECORD_ERASED;
+	record_g.session.length = BOOT_RECORD_ERASED;
+	record_g.session.crc = BOOT_RECORD_ERASED;
+	record_g.session.committed = BOOT_RECORD_ERASED;
+
+	for ( i = 0; i < BOOT_RECORD_PROGRESS_LINES; i++ ) {
+		record_g.progress[i].mark = BOOT_RECORD_ERASED;
+	}
+
+	committed_g = 0;
+}
+
+// Last checkpoint: the count in the session line or the last progress line
+static uint32_t __session_checkpoint()
+{
+	uint32_t committed = record_g.session.committed;
+	uint32_t i;
+
+	if ( committed == BOOT_RECORD_ERASED ) {
+		committed = 0;
+	}
+
+	for ( i = 0; i < BOOT_RECORD_PROGRESS_LINES; i++ ) {
+		if ( ! __mark_is_set( &record_g.progress[i] ) ) {
+			break;
+		}
+
+		if ( record_g.progress[i].mark > committed ) {
+			committed = record_g.progress[i].mark;
+		}
+	}
+
+	return committed;
+}
+
+static int __record_load( boot_record_request_t * activate );
+
+// Rewrite the whole record from RAM into the other copy; the current one stays
+// as it is until the next rewrite, so there's always a valid copy to go back to.
+// If the shared lines changed, it's rewritten right after (it still has the old
+// ones).
+static int __record_write()
+{
+	uint32_t bank;
+	bool again;
+	int ret;
+
+	do {
+		bank = (bank_g == BANK_USER_SIGNATURE) ? BANK_RECORD_BLOCK : BANK_USER_SIGNATURE;
+
+		record_g.sequence++;
+		record_g.crc = __record_crc( &record_g );
+
+		ret = __bank_erase( bank );
+		if ( ret >= 0 ) {
+			ret = __bank_write( bank, 0, (uint32_t *)&record_g, sizeof(boot_record_t) );
+		}
+
+		// If anything went wrong the RAM copy no longer reflects the flash; go by
+		// what's actually there
+		if ( ret < 0 ) {
+			__record_load( NULL );
+			return ret;
+		}
+
+		bank_g = bank;
+
+		again = shared_dirty_g;
+		shared_dirty_g = false;
+	} while ( again );
+
+	return 0;
+}
+
+// CRC-32 of the first 'length' bytes of partition 'id'
+static int __image_crc( uint32_t id, uint32_t length, uint32_t * crc )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1);
+	}
+
+	// At least a vector table's worth (initial SP and reset vector)
+	if ( (length < 8) || (length > (partition.end - partition.start)) ) {
+		return (-1);
+	}
+
+	*crc = crc_32( (uint8_t *)(partition.start), length );
+
+	return 0;
+}
+
+// Read both copies and go by the newer valid one. The application's activate
+// request is handed to the caller (if it wants it) and dropped from record_g, so
+// no rewrite carries it over; without a valid copy it's taken from the record
+// block (the application writes both).
+static int __record_load( boot_record_request_t * activate )
+{
+	boot_record_t other;
+	bool other_valid;
+	uint32_t i;
+
+	valid_g = false;
+	shared_dirty_g = false;
+	committed_g = 0;
+
+	valid_g = (__bank_read( BANK_USER_SIGNATURE, 0, (uint32_t *)&record_g, sizeof(boot_record_t) ) >= 0) &&
+		__record_is_valid( &record_g );
+	other_valid = (__bank_read( BANK_RECORD_BLOCK, 0, (uint32_t *)&other, sizeof(boot_record_t) ) >= 0) &&
+		__record_is_valid( &other );
+
+	// The newer copy (the other one is what it replaced, or a rewrite that
+	// didn't finish and doesn't check out)
+	if ( other_valid && ((! valid_g) || ((int32_t)(other.sequence - record_g.sequence) > 0)) ) {
+		for ( i = 0; i < (sizeof(boot_record_t) / sizeof(uint32_t)); i++ ) {
+			((uint32_t *)&record_g)[i] = ((uint32_t *)&other)[i];
+		}
+
+		valid_g = true;
+		bank_g = BANK_RECORD_BLOCK;
+	} else {
+		bank_g = BANK_USER_SIGNATURE;
+	}
+
+	if ( activate ) {
+		__request_copy( activate, valid_g ? &record_g.activate : &other.activate );
+	}
+
+	if ( record_g.activate.request != BOOT_RECORD_ERASED ) {
+		__request_clear( &record_g.activate );
+		shared_dirty_g = true;
+	}
+
+	if ( ! valid_g ) {
+		__record_clear();
+		bank_g = BANK_RECORD_BLOCK;
+		return (-1);
+	}
+
+	committed_g = __session_checkpoint();
+
+	return 0;
+}
+
+int boot_record_init()
+{
+	boot_record_request_t activate;
+	uint32_t bank;
+
+	__record_load( &activate );
+
+	// An activation checks the image first (a request for an image that isn't
+	// there is dropped) and restarts the boot log, which rewrites both copies
+	if ( activate.request == BOOT_RECORD_REQUEST_ACTIVATE ) {
+		boot_record_set_active( activate.slot, activate.length, activate.crc );
+	}
+
+	// The shared lines are programmed into both copies, and a line only once
+	// between erases: a dropped request, or a copy out of step (a reset between
+	// the two writes) takes a rewrite. Without a record a copy is just erased.
+	if ( valid_g ) {
+		if ( shared_dirty_g || __bank_shared_differs( (bank_g == BANK_USER_SIGNATURE) ? BANK_RECORD_BLOCK : BANK_USER_SIGNATURE ) ) {
+			__record_write();
+		}
+	} else {
+		for ( bank = BANK_USER_SIGNATURE; bank <= BANK_RECORD_BLOCK; bank++ ) {
+			if ( __bank_shared_differs( bank ) ) {
+				__bank_erase( bank );
+			}
+		}
+	}
+
+	return valid_g ? 0 : (-1);
+}
+
+bool boot_record_valid()
+{
+	return valid_g;
+}
+
+int boot_record_get_active()
+{
+	if ( (! valid_g) || (record_g.active >= BOOT_RECORD_N_SLOTS) ) {
+		return (-1);
+	}
+
+	return (int)record_g.active;
+}
+
+uint32_t boot_record_log_count( const boot_record_t * record, uint32_t * confirmed, uint32_t * next )
+{
+	uint32_t attempts;
+	uint32_t count;
+	uint32_t i;
+
+	for ( attempts = 0; attempts < BOOT_RECORD_LOG_LINES; attempts++ ) {
+		if ( ! __mark_is_set( &record->attempts[attempts] ) ) {
+			break;
+		}
+	}
+
+	count = 0;
+	for ( i = 0; i < BOOT_RECORD_LOG_LINES; i++ ) {
+		if ( ! __mark_is_set( &record->confirmed[i] ) ) {
+			break;
+		}
+
+		count = record->confirmed[i].mark;
+	}
+
+	// NOTE: A partially programmed count reads high; it was still a confirmation
+	if ( confirmed ) {
+		*confirmed = (count > attempts) ? attempts : count;
+	}
+	if ( next ) {
+		*next = i;
+	}
+
+	return attempts;
+}
+
+uint32_t boot_record_get_attempts()
+{
+	uint32_t confirmed;
+	uint32_t attempts;
+
+	attempts = boot_record_log_count( &record_g, &confirmed, NULL );
+
+	return attempts - confirmed;
+}
+
+void boot_record_get( boot_record_t * record )
+{
+	uint32_t i;
+
+	if ( ! record ) {
+		return;
+	}
+
+	for ( i = 0; i < (sizeof(boot_record_t) / sizeof(uint32_t)); i++ ) {
+		((uint32_t *)record)[i] = ((uint32_t *)&record_g)[i];
+	}
+}
+
+int boot_record_set_active( uint32_t id, uint32_t length, uint32_t crc )
+{
+	uint32_t image_crc;
+
+	if ( id >= BOOT_RECORD_N_SLOTS ) {
+		return (-1);
+	}
+
+	if ( __image_crc( id, length, &image_crc ) < 0 ) {
+		return (-1);
+	}
+
+	if ( image_crc != crc ) {
+		return (-2);
+	}
+
+	if ( ! valid_g ) {
+		__record_clear();
+		record_g.magic = BOOT_RECORD_MAGIC;
+		record_g.version = BOOT_RECORD_VERSION;
+	}
+
+	// The other slot's description (and verified mark) carry over
+	record_g.active = id;
+	record_g.slot[id].length = length;
+	record_g.slot[id].crc = crc;
+	record_g.verified[id].mark = BOOT_RECORD_MARK_SET; // Just checked it
+
+	__log_reset( 0 );
+
+	// The upload to this slot is done
+	if ( record_g.session.slot == id ) {
+		__session_clear();
+	}
+
+	valid_g = true;
+
+	return __record_write();
+}
+
+int boot_record_invalidate( uint32_t id )
+{
+	if ( (! valid_g) || (id >= BOOT_RECORD_N_SLOTS) ) {
+		return 0;
+	}
+
+	// Nothing recorded about this slot; save the erase
+	if ( (record_g.slot[id].length == BOOT_RECORD_ERASED) &&
+		(! __mark_is_set( &record_g.verified[id] )) ) {
+		return 0;
+	}
+
+	record_g.slot[id].length = BOOT_RECORD_ERASED;
+	record_g.slot[id].crc = BOOT_RECORD_ERASED;
+	record_g.verified[id].mark = BOOT_RECORD_ERASED;
+
+	return __record_write();
+}
+
+int boot_record_check( uint32_t id )
+{
+	uint32_t crc;
+	uint32_t start;
+	int ret;
+
+	if ( (! valid_g) || (id >= BOOT_RECORD_N_SLOTS) ) {
+		return (-1);
+	}
+
+	if ( record_g.slot[id].length == BOOT_RECORD_ERASED ) {
+		return (-1);
+	}
+
+	if ( __mark_is_set( &record_g.verified[id] ) ) {
+		return 0;
+	}
+
+	start = dwt_get_cycles();
+	ret = __image_crc( id, record_g.slot[id].length, &crc );
+	handoff_add_verify_cycles( dwt_get_cycles() - start );
+
+	if ( ret < 0 ) {
+		return (-2);
+	}
+
+	if ( crc != record_g.slot[id].crc ) {
+		return (-2);
+	}
+
+	// NOTE: The mark is only a cache; if it can't be written we just hash the
+	// slot again next time
+	__mark_set( &record_g.verified[id] );
+
+	return 0;
+}
+
+int boot_record_select( uint32_t * id )
+{
+	uint32_t active;
+	uint32_t other;
+
+	if ( ! id ) {
+		return (-1);
+	}
+
+	// An upload still open on the slot (e.g. the first one, before any slot is
+	// active) means a half-written image; wait for the host to resume it
+	if ( __session_is_open() && (record_g.session.slot == *id) ) {
+		return (-1);
+	}
+
+	if ( (! valid_g) || (record_g.active >= BOOT_RECORD_N_SLOTS) ) {
+		return 0; // No record (or no active slot yet); caller's default stands
+	}
+
+	active = record_g.active;
+	other = (active == 0) ? 1 : 0;
+
+	if ( (boot_record_get_attempts() < BOOT_RECORD_MAX_ATTEMPTS) &&
+		(boot_record_check( active ) == 0) ) {
+		*id = active;
+		return 0;
+	}
+
+	if ( boot_record_check( other ) == 0 ) {
+		*id = other;
+		return 0;
+	}
+
+	return (-1);
+}
+
+int boot_record_attempt( uint32_t id )
+{
+#if defined(CONFIG_BOOT_ATTEMPTS)
+	uint32_t confirmed;
+	uint32_t attempts;
+	int ret;
+
+	if ( (! valid_g) || (id != record_g.active) ) {
+		return 0;
+	}
+
+	attempts = boot_record_log_count( &record_g, &confirmed, NULL );
+	if ( (attempts - confirmed) >= BOOT_RECORD_MAX_ATTEMPTS ) {
+		return 0;
+	}
+
+	// Log full; start over with the unconfirmed boots
+	if ( attempts >= BOOT_RECORD_LOG_LINES ) {
+		attempts -= confirmed;
+		__log_reset( attempts );
+
+		ret = __record_write();
+		if ( ret < 0 ) {
+			return ret;
+		}
+	}
+
+	record_g.attempts[attempts].mark = BOOT_RECORD_MARK_SET;
+
+	return __shared_line_write( &record_g.attempts[attempts] );
+#else
+	(void)id;
+
+	return 0;
+#endif // defined(CONFIG_BOOT_ATTEMPTS)
+}
+
+int boot_record_confirm()
+{
+	uint32_t confirmed;
+	uint32_t attempts;
+	uint32_t next;
+
+	if ( ! valid_g ) {
+		return (-1);
+	}
+
+	attempts = boot_record_log_count( &record_g, &confirmed, &next );
+	if ( attempts == confirmed ) {
+		return 0;
+	}
+
+	// NOTE: Each line confirms more boots than the last, so there's always one
+	// free while a boot is unconfirmed
+	record_g.confirmed[next].mark = attempts;
+
+	return __shared_line_write( &record_g.confirmed[next] );
+}
+
+int boot_record_session_begin( uint32_t id, uint32_t length, uint32_t crc )
+{
+	flash_partition_t partition;
+
+	if ( (id >= BOOT_RECORD_N_SLOTS) || (flash_get_partition( id, &partition ) < 0) ) {
+		return (-1);
+	}
+
+	if ( (length == 0) || (length > (partition.end - partition.start)) ) {
+		return (-1);
+	}
+
+	if ( ! valid_g ) {
+		__record_clear();
+		record_g.magic = BOOT_RECORD_MAGIC;
+		record_g.version = BOOT_RECORD_VERSION;
+	}
+
+	// The slot is about to be rewritten; forget the old image in the same write
+	record_g.slot[id].length = BOOT_RECORD_ERASED;
+	record_g.slot[id].crc = BOOT_RECORD_ERASED;
+	record_g.verified[id].mark = BOOT_RECORD_ERASED;
+
+	__session_clear();
+	record_g.session.slot = id;
+	record_g.session.length = length;
+	record_g.session.crc = crc;
+	record_g.session.committed = 0;
+
+	valid_g = true;
+
+	return __record_write();
+}
+
+int boot_record_session_get( boot_record_session_t * session )
+{
+	if ( (! session) || (! __session_is_open()) ) {
+		return (-1);
+	}
+
+	session->slot = record_g.session.slot;
+	session->length = record_g.session.length;
+	session->crc = record_g.session.crc;
+	session->committed = committed_g;
+
+	return 0;
+}
+
+// Save the count in the next free progress line; once they're used up the
+// record is rewritten with the count in the session line
+static int __session_checkpoint_write()
+{
+	uint32_t i;
+
+	for ( i = 0; i < BOOT_RECORD_PROGRESS_LINES; i++ ) {
+		if ( ! __mark_is_set( &record_g.progress[i] ) ) {
+			record_g.progress[i].mark = committed_g;
+			return __line_write( &record_g.progress[i] );
+		}
+	}
+
+	record_g.session.committed = committed_g;
+	for ( i = 0; i < BOOT_RECORD_PROGRESS_LINES; i++ ) {
+		record_g.progress[i].mark = BOOT_RECORD_ERASED;
+	}
+
+	return __record_write();
+}
+
+int boot_record_session_commit( uint32_t id, uint32_t page )
+{
+	uint32_t pages;
+
+	if ( (! __session_is_open()) || (id != record_g.session.slot) ) {
+		return 0;
+	}
+
+	// Rewrites of committed pages and pages past a gap don't move the count
+	if ( page != committed_g ) {
+		return 0;
+	}
+
+	pages = (record_g.session.length + (CONFIG_PAGE_SIZE - 1)) / CONFIG_PAGE_SIZE;
+	if ( committed_g >= pages ) {
+		return 0;
+	}
+
+	committed_g++;
+
+	// NOTE: Between checkpoints the count only lives in RAM; a reset loses at
+	// most CONFIG_UPLOAD_CHECKPOINT_PAGES - 1 pages, which are simply resent
+	if ( ((committed_g % BOOT_RECORD_CHECKPOINT_PAGES) != 0) && (committed_g != pages) ) {
+		return 0;
+	}
+
+	return __session_checkpoint_write();
+}
+
+int boot_record_session_end( uint32_t id )
+{
+	if ( (! __session_is_open()) || (id != record_g.session.slot) ) {
+		return 0;
+	}
+
+	__session_clear();
+
+	return __record_write();
+}
+
+#else // ! defined(CONFIG_BOOT_RECORD)
+
+int boot_record_init() { return (-1); }
+bool boot_record_valid() { return false; }
+int boot_record_get_active() { return (-1); }
+uint32_t boot_record_get_attempts() { return 0; }
+
+void boot_record_get( boot_record_t * record )
+{
+	uint32_t i;
+
+	if ( ! record ) {
+		return;
+	}
+
+	for ( i = 0; i < (sizeof(boot_record_t) / sizeof(uint32_t)); i++ ) {
+		((uint32_t *)record)[i] = BOOT_RECORD_ERASED;
+	}
+}
+
+int boot_record_set_active( uint32_t id, uint32_t length, uint32_t crc )
+{
+	(void)id;
+	(void)length;
+	(void)crc;
+
+	return (-1);
+}
+
+int boot_record_invalidate( uint32_t id )
+{
+	(void)id;
+	return 0;
+}
+
+int boot_record_check( uint32_t id )
+{
+	(void)id;
+	return (-1);
+}
+
+int boot_record_select( uint32_t * id )
+{
+	(void)id;
+	return 0;
+}
+
+int boot_record_attempt( uint32_t id )
+{
+	(void)id;
+	return 0;
+}
+
+int boot_record_confirm() { return (-1); }
+
+// Nothing to record; the upload goes ahead, it just can't be resumed
+int boot_record_session_begin( uint32_t id, uint32_t length, uint32_t crc )
+{
+	(void)id;
+	(void)length;
+	(void)crc;
+
+	return 0;
+}
+
+int boot_record_session_get( boot_record_session_t * session )
+{
+	(void)session;
+	return (-1);
+}
+
+int boot_record_session_commit( uint32_t id, uint32_t page )
+{
+	(void)id;
+	(void)page;
+	return 0;
+}
+
+int boot_record_session_end( uint32_t id )
+{
+	(void)id;
+	return 0;
+}
+
+#endif // defined(CONFIG_BOOT_RECORD)
@@ -0,0 +1,249 @@
+
+#include "copy.h"
+
+#include "config.h"
+#include "flash.h"
+
+#include <stdbool.h>
+
+#define PAGE_WORDS	(CONFIG_PAGE_SIZE / sizeof(uint32_t))
+
+static struct {
+	copy_progress_t progress;
+	uint32_t src;
+	uint32_t dst;
+	uint32_t length;
+	uint32_t src_start;	// Addresses of the partitions
+	uint32_t dst_start;
+	uint32_t dirty;		// Current erase block has a page in the way
+	uint32_t run_start;	// Pending erase run (pages)
+	uint32_t run_pages;
+} copy_g;
+
+// Staging buffer for flash_write_page() (the source can't be programmed from
+// directly; the page has to go through the latch from RAM)
+static uint32_t page_g[PAGE_WORDS] __attribute__((aligned (32)));
+
+static inline const uint32_t * __src_page( uint32_t page )
+{
+	return (const uint32_t *)(copy_g.src_start + (page * CONFIG_PAGE_SIZE));
+}
+
+static inline const uint32_t * __dst_page( uint32_t page )
+{
+	return (const uint32_t *)(copy_g.dst_start + (page * CONFIG_PAGE_SIZE));
+}
+
+static bool __page_matches( uint32_t page )
+{
+	const uint32_t * src = __src_page( page );
+	const uint32_t * dst = __dst_page( page );
+	uint32_t i;
+
+	for ( i = 0; i < PAGE_WORDS; i++ ) {
+		if ( src[i] != dst[i] ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// The destination page has to be erased before the source can be programmed
+// over it (programming only clears bits)
+static bool __page_in_way( uint32_t page )
+{
+	const uint32_t * dst = __dst_page( page );
+	uint32_t i;
+
+	if ( __page_matches( page ) ) {
+		return false;
+	}
+
+	for ( i = 0; i < PAGE_WORDS; i++ ) {
+		if ( dst[i] != 0xFFFFFFFF ) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static void __fail( int32_t error )
+{
+	copy_g.progress.state = COPY_ERROR;
+	copy_g.progress.error = error;
+}
+
+static int __erase_run()
+{
+	int ret;
+
+	if ( copy_g.run_pages == 0 ) {
+		return 0;
+	}
+
+	ret = flash_erase_pages( copy_g.dst, copy_g.run_start, copy_g.run_pages );
+	if ( ret < 0 ) {
+		__fail( ret );
+		return ret;
+	}
+
+	copy_g.progress.erased += copy_g.run_pages;
+	copy_g.run_pages = 0;
+
+	return 0;
+}
+
+int copy_start( uint32_t src, uint32_t dst, uint32_t length )
+{
+	flash_partition_t src_partition;
+	flash_partition_t dst_partition;
+
+	if ( src == dst ) {
+		return (-1);
+	}
+
+	if ( (flash_get_partition( src, &src_partition ) < 0) ||
+		(flash_get_partition( dst, &dst_partition ) < 0) ) {
+		return (-1);
+	}
+
+	if ( (length == 0) ||
+		(length > (src_partition.end - src_partition.start)) ||
+		(length > (dst_partition.end - dst_partition.start)) ) {
+		return (-1);
+	}
+
+	copy_g.src = src;
+	copy_g.dst = dst;
+	copy_g.length = length;
+	copy_g.src_start = src_partition.start;
+	copy_g.dst_start = dst_partition.start;
+	copy_g.dirty = 0;
+	copy_g.run_pages = 0;
+
+	copy_g.progress.state = COPY_ERASE;
+	copy_g.progress.error = 0;
+	copy_g.progress.page = 0;
+	copy_g.progress.pages = (length + (CONFIG_PAGE_SIZE - 1)) / CONFIG_PAGE_SIZE;
+	copy_g.progress.erased = 0;
+	copy_g.progress.programmed = 0;
+	copy_g.progress.skipped = 0;
+
+	return 0;
+}
+
+// NOTE: The erase phase walks whole erase blocks (the last one may reach past
+// the copied pages); pages past the end aren't checked and only get erased if
+// their block has to be anyway
+static void __erase_step()
+{
+	copy_progress_t * p = &copy_g.progress;
+	uint32_t blocks_end = ((p->pages + (FLASH_ERASE_MIN_PAGES - 1)) / FLASH_ERASE_MIN_PAGES) * FLASH_ERASE_MIN_PAGES;
+
+	if ( (p->page < p->pages) && __page_in_way( p->page ) ) {
+		copy_g.dirty = 1;
+	}
+
+	p->page++;
+
+	// End of an erase block: grow the pending run or erase it
+	if ( (p->page % FLASH_ERASE_MIN_PAGES) == 0 ) {
+		if ( copy_g.dirty ) {
+			if ( copy_g.run_pages == 0 ) {
+				copy_g.run_start = p->page - FLASH_ERASE_MIN_PAGES;
+			}
+			copy_g.run_pages += FLASH_ERASE_MIN_PAGES;
+			copy_g.dirty = 0;
+		} else if ( __erase_run() < 0 ) {
+			return;
+		}
+	}
+
+	if ( p->page >= blocks_end ) {
+		if ( __erase_run() < 0 ) {
+			return;
+		}
+
+		p->state = COPY_PROGRAM;
+		p->page = 0;
+	}
+}
+
+static void __program_step()
+{
+	copy_progress_t * p = &copy_g.progress;
+	const uint32_t * src;
+	uint32_t i;
+	int ret;
+
+	if ( __page_matches( p->page ) ) {
+		p->skipped++;
+	} else {
+		src = __src_page( p->page );
+		for ( i = 0; i < PAGE_WORDS; i++ ) {
+			page_g[i] = src[i];
+		}
+
+		ret = flash_write_page( copy_g.dst, (uint8_t *)page_g, p->page );
+		if ( ret < 0 ) {
+			__fail( ret );
+			return;
+		}
+
+		if ( ! __page_matches( p->page ) ) {
+			__fail( -1 );
+			return;
+		}
+
+		p->programmed++;
+	}
+
+	p->page++;
+
+	if ( p->page >= p->pages ) {
+		p->state = COPY_DONE;
+	}
+}
+
+void copy_poll()
+{
+	switch ( copy_g.progress.state ) {
+		case COPY_ERASE:
+			__erase_step();
+			break;
+		case COPY_PROGRAM:
+			__program_step();
+			break;
+		default:
+			break;
+	}
+}
+
+void copy_progress( copy_progress_t * progress )
+{
+	uint32_t i;
+
+	if ( ! progress ) {
+		return;
+	}
+
+	// NOTE: Word copy rather than a struct assignment (no memcpy, -nostdlib)
+	for ( i = 0; i < (sizeof(copy_progress_t) / sizeof(uint32_t)); i++ ) {
+		((uint32_t *)progress)[i] = ((uint32_t *)&copy_g.progress)[i];
+	}
+}
+
+int copy_is( uint32_t src, uint32_t dst, uint32_t length )
+{
+	return (copy_g.progress.state != COPY_IDLE)
+		&& (copy_g.src == src)
+		&& (copy_g.dst == dst)
+		&& (copy_g.length == length);
+}
+
+void copy_cancel()
+{
+	copy_g.progress.state = COPY_IDLE;
+}
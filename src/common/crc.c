@@ -1,5 +1,9 @@
 
 #include "crc.h"
+#include "config.h"
+#include "common.h"
+
+#include <stdbool.h>
 
 // TODO: May want to provide the option to calculate these tables at run-time and store them in RAM; this would reduce binary size quite a bit which would (possibly) be useful for the bootloader (1.5 K is just tables right now)
 
@@ -108,13 +112,13 @@ static const uint32_t crc_32_table_g[256] = {
 };
 
 // Initial CRC value must be 0x0000
-uint16_t crc_16ibm_update( uint16_t crc, uint8_t data )
+__itcm uint16_t crc_16ibm_update( uint16_t crc, uint8_t data )
 {
 	return ((crc >> 8) ^ crc_16ansi_table_g[(crc ^ (uint16_t)data) & 0xFF]);
 }
 
 // Initial CRC value must be 0xFFFFFFFF
-uint32_t crc_32_update( uint32_t crc, uint8_t data )
+__itcm uint32_t crc_32_update( uint32_t crc, uint8_t data )
 {
 	return ((crc >> 8) ^ crc_32_table_g[(crc ^ (uint32_t)data) & 0xFF]);
 }
@@ -124,19 +128,106 @@ uint32_t crc_32_finalize( uint32_t crc )
 	return (crc ^ 0xFFFFFFFFUL);
 }
 
+#if defined(CONFIG_CRC_SLICE_BY_4)
+// Slicing-by-4 tables; crc_32_table_g is table 0 and the other three are
+// derived from it the first time they're needed (RAM rather than another 3 KB
+// of flash): table[k][i] = (table[k-1][i] >> 8) ^ table[0][table[k-1][i] & 0xFF]
+static uint32_t crc_32_slice_g[3][256] __dtcm;
+static bool crc_32_slice_ready_g = false;
+
+static void __crc_32_slice_init()
+{
+	uint32_t i;
+	uint32_t k;
+	uint32_t c;
+
+	for ( i = 0; i < 256; i++ ) {
+		c = crc_32_table_g[i];
+		for ( k = 0; k < 3; k++ ) {
+			c = (c >> 8) ^ crc_32_table_g[c & 0xFF];
+			crc_32_slice_g[k][i] = c;
+		}
+	}
+
+	crc_32_slice_ready_g = true;
+}
+#endif // defined(CONFIG_CRC_SLICE_BY_4)
+
+// NOTE: Words are consumed in memory order, i.e. the same result as feeding
+// the bytes of each (little-endian) word to crc_32_update() one at a time
+__itcm uint32_t crc_32_update_words( uint32_t crc, const uint32_t * data, uint32_t n_words )
+{
+	uint32_t i;
+
+#if defined(CONFIG_CRC_SLICE_BY_4)
+	if ( ! crc_32_slice_ready_g ) {
+		__crc_32_slice_init();
+	}
+
+	for ( i = 0; i < n_words; i++ ) {
+		crc ^= data[i];
+		crc = crc_32_slice_g[2][crc & 0xFF]
+			^ crc_32_slice_g[1][(crc >> 8) & 0xFF]
+			^ crc_32_slice_g[0][(crc >> 16) & 0xFF]
+			^ crc_32_table_g[crc >> 24];
+	}
+#else
+	uint32_t w;
+
+	for ( i = 0; i < n_words; i++ ) {
+		w = data[i];
+		crc = (crc >> 8) ^ crc_32_table_g[(crc ^ w) & 0xFF];
+		crc = (crc >> 8) ^ crc_32_table_g[(crc ^ (w >> 8)) & 0xFF];
+		crc = (crc >> 8) ^ crc_32_table_g[(crc ^ (w >> 16)) & 0xFF];
+		crc = (crc >> 8) ^ crc_32_table_g[(crc ^ (w >> 24)) & 0xFF];
+	}
+#endif // defined(CONFIG_CRC_SLICE_BY_4)
+
+	return crc;
+}
+
+// Byte-wise up to a word boundary, word-wise through the middle, byte-wise for
+// the tail
+__itcm uint32_t crc_32_update_block( uint32_t crc, const uint8_t * data, uint32_t len )
+{
+	uint32_t n_words;
+
+	while ( len && ((uintptr_t)data & 0x3) ) {
+		crc = crc_32_update( crc, *data++ );
+		len--;
+	}
+
+	n_words = len / 4;
+	crc = crc_32_update_words( crc, (const uint32_t *)data, n_words );
+	data += n_words * 4;
+	len -= n_words * 4;
+
+	while ( len-- ) {
+		crc = crc_32_update( crc, *data++ );
+	}
+
+	return crc;
+}
+
+uint32_t crc_32_update_bytes( uint32_t crc, const uint8_t * data, uint32_t len )
+{
+	while ( len-- ) {
+		crc = (crc >> 8) ^ crc_32_table_g[(crc ^ (uint32_t)*data++) & 0xFF];
+	}
+
+	return crc;
+}
+
 uint32_t crc_32( uint8_t * data, uint32_t len )
 {
 	uint32_t crc = CRC_32_INIT_VALUE;
-	uint32_t i;
 
 	// TODO: Is this how we want to handle NULL data pointers (?)
 	if ( ! data ) {
 		return crc;
 	}
 
-	for ( i = 0; i < len; i++ ) {
-		crc = crc_32_update( crc, data[i] );
-	}
+	crc = crc_32_update_block( crc, data, len );
 
 	return crc_32_finalize( crc );
 }
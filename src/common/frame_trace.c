@@ -0,0 +1,59 @@
+#include "frame_trace.h"
+#include "trace.h"
+
+#if defined(CONFIG_FRAME_TRACE)
+
+_Static_assert( (sizeof(frame_trace_header_t) == 24) && (sizeof(frame_trace_record_t) == (8 + FRAME_TRACE_DATA_LEN)),
+	"Frame trace layout changed; update FRAME_TRACE_VERSION and the readers" );
+
+// NOTE: Not static; the debugger dumps it by name
+frame_trace_t frame_trace_g;
+
+void frame_trace_init()
+{
+	frame_trace_g.header.magic = FRAME_TRACE_MAGIC;
+	frame_trace_g.header.version = FRAME_TRACE_VERSION;
+	frame_trace_g.header.record_size = sizeof(frame_trace_record_t);
+	frame_trace_g.header.timebase_hz = TRACE_TIMEBASE_HZ;
+	frame_trace_g.header.n_records = CONFIG_FRAME_TRACE_ENTRIES;
+	frame_trace_g.header.head = 0;
+	frame_trace_g.header.page_size = CONFIG_PAGE_SIZE;
+	frame_trace_g.header.origin = FRAME_TRACE_ORIGIN_DEVICE;
+	frame_trace_g.header.reserved = 0;
+}
+
+// NOTE: Byte copy rather than memcpy (-nostdlib); at most a frame's worth, once
+// per frame. 'head' moves last; a record only counts once it's complete.
+void frame_trace_add( frame_trace_kind_t kind, const uint8_t * data, uint32_t len )
+{
+	frame_trace_record_t * record = &frame_trace_g.records[frame_trace_g.header.head % CONFIG_FRAME_TRACE_ENTRIES];
+	uint32_t i;
+
+	if ( (! data) || (len > FRAME_TRACE_DATA_LEN) ) {
+		len = data ? FRAME_TRACE_DATA_LEN : 0;
+	}
+
+	record->time = trace_now();
+	record->kind = (uint8_t)kind;
+	record->reserved = 0;
+	record->len = (uint16_t)len;
+
+	for ( i = 0; i < len; i++ ) {
+		record->data[i] = data[i];
+	}
+
+	frame_trace_g.header.head++;
+}
+
+#else // ! defined(CONFIG_FRAME_TRACE)
+
+void frame_trace_init() {}
+
+void frame_trace_add( frame_trace_kind_t kind, const uint8_t * data, uint32_t len )
+{
+	(void)kind;
+	(void)data;
+	(void)len;
+}
+
+#endif // defined(CONFIG_FRAME_TRACE)
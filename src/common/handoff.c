@@ -0,0 +1,81 @@
+
+#include "handoff.h"
+
+#include "boot_record.h"
+#include "stats.h"
+#include "crc.h"
+#include "dwt.h"
+#include "clock.h"
+
+#if defined(CONFIG_HANDOFF)
+
+_Static_assert( sizeof(handoff_t) <= HANDOFF_SIZE, "Handoff block outgrew its reservation" );
+_Static_assert( (sizeof(handoff_t) % sizeof(uint32_t)) == 0, "Handoff block CRC is over whole words" );
+
+#define handoff_g	(*(volatile handoff_t *)(HANDOFF_ADDRESS))
+
+static uint32_t verify_cycles_g = 0;
+
+void handoff_init()
+{
+	handoff_g.magic = 0;
+}
+
+void handoff_add_verify_cycles( uint32_t cycles )
+{
+	verify_cycles_g += cycles;
+}
+
+void handoff_fill( uint32_t id, uint32_t reason )
+{
+	boot_record_t record;
+	stats_t stats;
+
+	boot_record_get( &record );
+	stats_get( &stats );
+
+	handoff_g.magic = HANDOFF_MAGIC;
+	handoff_g.version = HANDOFF_VERSION;
+	handoff_g.size = sizeof(handoff_t);
+	handoff_g.reason = reason;
+	handoff_g.slot = id;
+
+	if ( boot_record_valid() && (id < BOOT_RECORD_N_SLOTS) ) {
+		handoff_g.image_length = record.slot[id].length;
+		handoff_g.image_crc = record.slot[id].crc;
+	} else {
+		handoff_g.image_length = BOOT_RECORD_ERASED;
+		handoff_g.image_crc = BOOT_RECORD_ERASED;
+	}
+
+	handoff_g.attempts = (boot_record_get_active() == (int)id) ? boot_record_get_attempts() : 0;
+
+	handoff_g.clock_hz = clock_get_core_hz();
+	handoff_g.verify_cycles = verify_cycles_g;
+	handoff_g.rpc_requests = stats.server_requests;
+	handoff_g.link_errors = stats.sll_crc_errors + stats.sll_len_errors
+		+ stats.usart_overruns + stats.usart_frame_errors;
+
+	// Last, so the figure covers everything up to the jump but the CRC
+	handoff_g.jump_cycles = dwt_get_cycles();
+
+	handoff_g.crc = crc_32_finalize( crc_32_update_words( CRC_32_INIT_VALUE,
+		(const uint32_t *)&handoff_g, (sizeof(handoff_t) / sizeof(uint32_t)) - 1 ) );
+}
+
+#else
+
+void handoff_init() {}
+
+void handoff_add_verify_cycles( uint32_t cycles )
+{
+	(void)cycles;
+}
+
+void handoff_fill( uint32_t id, uint32_t reason )
+{
+	(void)id;
+	(void)reason;
+}
+
+#endif // defined(CONFIG_HANDOFF)
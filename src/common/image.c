@@ -0,0 +1,92 @@
+
+#include "image.h"
+
+#include "config.h"
+#include "crc.h"
+#include "flash.h"
+
+static inline uint16_t __le16( const uint8_t * data )
+{
+	return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static inline uint32_t __le32( const uint8_t * data )
+{
+	return ((uint32_t)data[0])
+		| ((uint32_t)data[1] << 8)
+		| ((uint32_t)data[2] << 16)
+		| ((uint32_t)data[3] << 24);
+}
+
+int image_header_parse( const uint8_t * data, uint32_t len, image_header_t * header )
+{
+	uint32_t crc = CRC_32_INIT_VALUE;
+	uint32_t i;
+
+	if ( (! data) || (! header) || (len < IMAGE_HEADER_SIZE) ) {
+		return IMAGE_E_HEADER;
+	}
+
+	header->magic = __le32( &data[0] );
+	header->version = data[4];
+	header->slot = data[5];
+	header->flags = data[6];
+	header->header_size = data[7];
+	header->length = __le32( &data[8] );
+	header->crc = __le32( &data[12] );
+	header->load_address = __le32( &data[16] );
+	header->page_size = __le16( &data[20] );
+	header->page_count = __le16( &data[22] );
+	header->reserved = __le32( &data[24] );
+	header->header_crc = __le32( &data[28] );
+
+	// NOTE: The header CRC is checked here since it's over the raw bytes
+	for ( i = 0; i < (IMAGE_HEADER_SIZE - 4); i++ ) {
+		crc = crc_32_update( crc, data[i] );
+	}
+
+	if ( crc_32_finalize( crc ) != header->header_crc ) {
+		return IMAGE_E_HEADER;
+	}
+
+	return 0;
+}
+
+int image_header_check( const image_header_t * header, uint32_t id )
+{
+	flash_partition_t partition;
+
+	if ( ! header ) {
+		return IMAGE_E_HEADER;
+	}
+
+	if ( (header->magic != IMAGE_MAGIC) ||
+		(header->version != IMAGE_VERSION) ||
+		(header->header_size != IMAGE_HEADER_SIZE) ) {
+		return IMAGE_E_HEADER;
+	}
+
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return IMAGE_E_SLOT;
+	}
+
+	if ( (header->slot != IMAGE_SLOT_ANY) && (header->slot != id) ) {
+		return IMAGE_E_SLOT;
+	}
+
+	// NOTE: Applications aren't position independent; an image linked for the
+	// other slot would pass the slot check if built with IMAGE_SLOT_ANY
+	if ( header->load_address != partition.start ) {
+		return IMAGE_E_ADDRESS;
+	}
+
+	if ( header->page_size != CONFIG_PAGE_SIZE ) {
+		return IMAGE_E_PAGE_SIZE;
+	}
+
+	if ( (header->length == 0) || (header->length > (partition.end - partition.start)) ) {
+		return IMAGE_E_LENGTH;
+	}
+
+	return 0;
+}
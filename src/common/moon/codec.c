@@ -72,6 +72,13 @@ void moon_codec_write_u32( uint8_t * buffer, uint32_t var, uint32_t offset )
 	*(uint32_t *)&buffer[offset] = var;
 }
 
+// NOTE: Written as two words; a u64 argument is only guaranteed 4-byte alignment in the message buffer
+void moon_codec_write_u64( uint8_t * buffer, uint64_t var, uint32_t offset )
+{
+	*(uint32_t *)&buffer[offset] = (uint32_t)(var & 0xFFFFFFFF);
+	*(uint32_t *)&buffer[offset + 4] = (uint32_t)(var >> 32);
+}
+
 // -- SIGNED -- //
 
 // TODO: These could probably just cast the result of the matching u* call but since it's already one line that seems pointless. Might be worth considering for the "always aligned" version.
@@ -109,6 +116,12 @@ void moon_codec_read_u32( uint8_t * buffer, uint32_t * var, uint32_t offset )
 	*var = *(uint32_t *)&buffer[offset];
 }
 
+void moon_codec_read_u64( uint8_t * buffer, uint64_t * var, uint32_t offset )
+{
+	*var = (uint64_t)(*(uint32_t *)&buffer[offset])
+		| ((uint64_t)(*(uint32_t *)&buffer[offset + 4]) << 32);
+}
+
 // -- SIGNED -- //
 
 void moon_codec_read_i8( uint8_t * buffer, int8_t * var, uint32_t offset )
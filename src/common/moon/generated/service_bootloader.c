@@ -21,6 +21,38 @@ int service_bootloader_handler( moon_msg_t * message ) {
 			return bl_setBootAction_shim( message );
 		case kBootloader_bl_boot_id:
 			return bl_boot_shim( message );
+		case kBootloader_bl_getStats_id:
+			return bl_getStats_shim( message );
+		case kBootloader_bl_getTrace_id:
+			return bl_getTrace_shim( message );
+		case kBootloader_bl_resetTrace_id:
+			return bl_resetTrace_shim( message );
+		case kBootloader_bl_setActiveApp_id:
+			return bl_setActiveApp_shim( message );
+		case kBootloader_bl_getBootRecord_id:
+			return bl_getBootRecord_shim( message );
+		case kBootloader_bl_confirmBoot_id:
+			return bl_confirmBoot_shim( message );
+		case kBootloader_bl_checkImage_id:
+			return bl_checkImage_shim( message );
+		case kBootloader_bl_verifyApp_id:
+			return bl_verifyApp_shim( message );
+		case kBootloader_bl_readApp_id:
+			return bl_readApp_shim( message );
+		case kBootloader_bl_copyApp_id:
+			return bl_copyApp_shim( message );
+		case kBootloader_bl_getCopyStatus_id:
+			return bl_getCopyStatus_shim( message );
+		case kBootloader_bl_beginUpload_id:
+			return bl_beginUpload_shim( message );
+		case kBootloader_bl_getUploadSession_id:
+			return bl_getUploadSession_shim( message );
+		case kBootloader_bl_writeAddress_id:
+			return bl_writeAddress_shim( message );
+		case kBootloader_bl_flushWrites_id:
+			return bl_flushWrites_shim( message );
+		case kBootloader_bl_getInfo_id:
+			return bl_getInfo_shim( message );
 		default:
 			message->header.protocol = MOON_PROT_E_NO_METHOD;
 			return MOON_RET_E_NO_METHOD;
@@ -215,3 +247,464 @@ int bl_boot_shim( moon_msg_t * message )
 
 	return MOON_RET_OK;
 }
+
+int bl_getStats_shim( moon_msg_t * message )
+{
+	// Arguments
+	uint8_t _reset;
+	moon_codec_read_u8( message->buffer, &_reset, 3 );
+	bool reset = (_reset != 0);
+
+	// Call actual served function
+	int8_t resp;
+	Stats stats;
+	resp = bl_getStats( reset, &stats );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	// NOTE: The return value takes the padding byte at index 3 so the (all
+	// u32) struct members start aligned at index 4
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_u32( message->buffer, stats.sll_frames, 4 );
+	moon_codec_write_u32( message->buffer, stats.sll_crc_errors, 8 );
+	moon_codec_write_u32( message->buffer, stats.sll_len_errors, 12 );
+	moon_codec_write_u32( message->buffer, stats.usart_overruns, 16 );
+	moon_codec_write_u32( message->buffer, stats.usart_frame_errors, 20 );
+	moon_codec_write_u32( message->buffer, stats.transport_errors, 24 );
+	moon_codec_write_u32( message->buffer, stats.server_requests, 28 );
+	moon_codec_write_u32( message->buffer, stats.server_retries, 32 );
+	moon_codec_write_u32( message->buffer, stats.server_no_service, 36 );
+	moon_codec_write_u32( message->buffer, stats.server_no_method, 40 );
+	moon_codec_write_u32( message->buffer, stats.server_syntax_errors, 44 );
+	moon_codec_write_u32( message->buffer, stats.server_codec_errors, 48 );
+	message->write_len = 52;
+
+	return MOON_RET_OK;
+}
+
+int bl_getTrace_shim( moon_msg_t * message )
+{
+	// Arguments
+	uint8_t index;
+	moon_codec_read_u8( message->buffer, &index, 3 );
+
+	// Call actual served function
+	int8_t resp;
+	TraceEntry entry;
+	resp = bl_getTrace( index, &entry );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	// NOTE: Members are ordered for alignment; the u8 members fill out the
+	// first word after the return value and the u64 lands on an 8-byte offset
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_u8( message->buffer, (uint8_t)entry.kind, 4 );
+	moon_codec_write_u8( message->buffer, entry.id, 5 );
+	moon_codec_write_u8( message->buffer, entry.method, 6 );
+	moon_codec_write_u8( message->buffer, 0, 7 ); // Padding
+	moon_codec_write_u32( message->buffer, entry.count, 8 );
+	moon_codec_write_u32( message->buffer, entry.min, 12 );
+	moon_codec_write_u32( message->buffer, entry.max, 16 );
+	moon_codec_write_u32( message->buffer, entry.timebase_hz, 20 );
+	moon_codec_write_u64( message->buffer, entry.sum, 24 );
+	message->write_len = 32;
+
+	return MOON_RET_OK;
+}
+
+int bl_resetTrace_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	bl_resetTrace();
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	message->write_len = 3;
+
+	return MOON_RET_OK;
+}
+
+int bl_setActiveApp_shim( moon_msg_t * message )
+{
+	// Arguments
+	uint8_t _app_id;
+	AppId app_id;
+	uint32_t length;
+	uint32_t crc;
+
+	// NOTE: Same layout as writePage; the u8 fills the padding byte at index 3
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u32( message->buffer, &length, 4 );
+	moon_codec_read_u32( message->buffer, &crc, 8 );
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_setActiveApp( app_id, length, crc );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_getBootRecord_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	BootRecord record;
+	resp = bl_getBootRecord( &record );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_i8( message->buffer, record.active, 4 );
+	moon_codec_write_u8( message->buffer, record.attempts, 5 );
+	moon_codec_write_u8( message->buffer, record.max_attempts, 6 );
+	moon_codec_write_u8( message->buffer, record.verified, 7 );
+	moon_codec_write_u32( message->buffer, record.app1_length, 8 );
+	moon_codec_write_u32( message->buffer, record.app1_crc, 12 );
+	moon_codec_write_u32( message->buffer, record.app2_length, 16 );
+	moon_codec_write_u32( message->buffer, record.app2_crc, 20 );
+	message->write_len = 24;
+
+	return MOON_RET_OK;
+}
+
+int bl_confirmBoot_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	resp = bl_confirmBoot();
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_checkImage_shim( moon_msg_t * message )
+{
+	// Arguments
+	//
+	// app_id = [3,1]
+	// header_len = [4,1]
+	// header = [8,header_len] (padded out to a word boundary)
+	uint8_t _app_id;
+	AppId app_id;
+	uint8_t header_len;
+	uint8_t * header;
+
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u8( message->buffer, &header_len, 4 );
+	header = &message->buffer[8]; // u8 list, use in place
+
+	if ( (8 + (uint32_t)header_len) > message->read_len ) {
+		message->header.protocol = MOON_PROT_E_BAD_SYNTAX;
+		return MOON_RET_E_SYNTAX;
+	}
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_checkImage( app_id, header_len, header );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_verifyApp_shim( moon_msg_t * message )
+{
+	// Arguments
+	uint8_t _app_id;
+	AppId app_id;
+	uint32_t length;
+	uint32_t crc;
+
+	// NOTE: Same layout as setActiveApp
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u32( message->buffer, &length, 4 );
+	moon_codec_read_u32( message->buffer, &crc, 8 );
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_verifyApp( app_id, length, crc );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_readApp_shim( moon_msg_t * message )
+{
+	// Arguments
+	//
+	// app_id = [3,1]
+	// offset = [4,4]
+	// length = [8,4]
+	// frames = [12,1]
+	uint8_t _app_id;
+	AppId app_id;
+	uint32_t offset;
+	uint32_t length;
+	uint8_t frames;
+
+	if ( message->read_len < 13 ) {
+		message->header.protocol = MOON_PROT_E_BAD_SYNTAX;
+		return MOON_RET_E_SYNTAX;
+	}
+
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u32( message->buffer, &offset, 4 );
+	moon_codec_read_u32( message->buffer, &length, 8 );
+	moon_codec_read_u8( message->buffer, &frames, 12 );
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_readApp( app_id, offset, length, frames );
+
+	// Build response
+	// NOTE: The data follows as stream frames once this response is sent
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_copyApp_shim( moon_msg_t * message )
+{
+	// Arguments
+	//
+	// src_id = [3,1]
+	// dst_id = [4,1]
+	// length = [8,4]
+	uint8_t _src_id;
+	uint8_t _dst_id;
+	AppId src_id;
+	AppId dst_id;
+	uint32_t length;
+
+	moon_codec_read_u8( message->buffer, &_src_id, 3 );
+	src_id = (AppId)(_src_id); // Cast to enum type
+	moon_codec_read_u8( message->buffer, &_dst_id, 4 );
+	dst_id = (AppId)(_dst_id); // Cast to enum type
+	moon_codec_read_u32( message->buffer, &length, 8 );
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_copyApp( src_id, dst_id, length );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_getCopyStatus_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	CopyStatus status;
+	resp = bl_getCopyStatus( &status );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_u8( message->buffer, status.state, 4 );
+	moon_codec_write_i8( message->buffer, status.error, 5 );
+	moon_codec_write_u16( message->buffer, status.pages, 6 );
+	moon_codec_write_u16( message->buffer, status.page, 8 );
+	moon_codec_write_u16( message->buffer, status.erased, 10 );
+	moon_codec_write_u16( message->buffer, status.programmed, 12 );
+	moon_codec_write_u16( message->buffer, status.skipped, 14 );
+	message->write_len = 16;
+
+	return MOON_RET_OK;
+}
+
+int bl_beginUpload_shim( moon_msg_t * message )
+{
+	// Arguments
+	uint8_t _app_id;
+	AppId app_id;
+	uint32_t length;
+	uint32_t crc;
+
+	// NOTE: Same layout as setActiveApp
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u32( message->buffer, &length, 4 );
+	moon_codec_read_u32( message->buffer, &crc, 8 );
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_beginUpload( app_id, length, crc );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_getUploadSession_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	UploadSession session;
+	resp = bl_getUploadSession( &session );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_i8( message->buffer, session.app_id, 4 );
+	moon_codec_write_u8( message->buffer, session.reserved, 5 );
+	moon_codec_write_u16( message->buffer, session.committed, 6 );
+	moon_codec_write_u32( message->buffer, session.length, 8 );
+	moon_codec_write_u32( message->buffer, session.crc, 12 );
+	message->write_len = 16;
+
+	return MOON_RET_OK;
+}
+
+int bl_writeAddress_shim( moon_msg_t * message )
+{
+	// Arguments
+	//
+	// app_id = [3,1]
+	// data_len = [4,1]
+	// offset = [8,4]
+	// data = [12,data_len]
+	uint8_t _app_id;
+	AppId app_id;
+	uint8_t data_len;
+	uint32_t offset;
+	uint8_t * data;
+
+	moon_codec_read_u8( message->buffer, &_app_id, 3 );
+	app_id = (AppId)(_app_id); // Cast to enum type
+	moon_codec_read_u8( message->buffer, &data_len, 4 );
+	moon_codec_read_u32( message->buffer, &offset, 8 );
+	data = &message->buffer[12]; // u8 list, use in place
+
+	if ( (12 + (uint32_t)data_len) > message->read_len ) {
+		message->header.protocol = MOON_PROT_E_BAD_SYNTAX;
+		return MOON_RET_E_SYNTAX;
+	}
+
+	// Call actual served function
+	int8_t resp;
+	resp = bl_writeAddress( app_id, offset, data_len, data );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_flushWrites_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	resp = bl_flushWrites();
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	message->write_len = 4;
+
+	return MOON_RET_OK;
+}
+
+int bl_getInfo_shim( moon_msg_t * message )
+{
+	// Call actual served function
+	int8_t resp;
+	DeviceInfo info;
+	resp = bl_getInfo( &info );
+
+	// Build response
+	message->header.type = MSG_TYPE_SINGLE_NORMAL;
+	message->header.protocol = MOON_PROT_OK;
+
+	moon_codec_write_header( message->buffer, &(message->header) );
+	moon_codec_write_i8( message->buffer, resp, 3 );
+	moon_codec_write_u8( message->buffer, info.info_version, 4 );
+	moon_codec_write_u8( message->buffer, info.codec_version, 5 );
+	moon_codec_write_u16( message->buffer, info.page_size, 6 );
+	moon_codec_write_u16( message->buffer, info.max_message_len, 8 );
+	moon_codec_write_u16( message->buffer, info.erase_pages, 10 );
+	moon_codec_write_u32( message->buffer, info.features, 12 );
+	moon_codec_write_u32( message->buffer, info.baud_rate, 16 );
+	moon_codec_write_u32( message->buffer, info.app1_start, 20 );
+	moon_codec_write_u32( message->buffer, info.app1_size, 24 );
+	moon_codec_write_u32( message->buffer, info.app2_start, 28 );
+	moon_codec_write_u32( message->buffer, info.app2_size, 32 );
+	message->write_len = 36;
+
+	return MOON_RET_OK;
+}
@@ -29,4 +29,36 @@ int bl_setBootAction_shim( moon_msg_t * message );
 
 int bl_boot_shim( moon_msg_t * message );
 
+int bl_getStats_shim( moon_msg_t * message );
+
+int bl_getTrace_shim( moon_msg_t * message );
+
+int bl_resetTrace_shim( moon_msg_t * message );
+
+int bl_setActiveApp_shim( moon_msg_t * message );
+
+int bl_getBootRecord_shim( moon_msg_t * message );
+
+int bl_confirmBoot_shim( moon_msg_t * message );
+
+int bl_checkImage_shim( moon_msg_t * message );
+
+int bl_verifyApp_shim( moon_msg_t * message );
+
+int bl_readApp_shim( moon_msg_t * message );
+
+int bl_copyApp_shim( moon_msg_t * message );
+
+int bl_getCopyStatus_shim( moon_msg_t * message );
+
+int bl_beginUpload_shim( moon_msg_t * message );
+
+int bl_getUploadSession_shim( moon_msg_t * message );
+
+int bl_writeAddress_shim( moon_msg_t * message );
+
+int bl_flushWrites_shim( moon_msg_t * message );
+
+int bl_getInfo_shim( moon_msg_t * message );
+
 #endif // SERVICE_BOOTLOADER_H
@@ -3,11 +3,32 @@
 #include "moon/transport.h"
 #include "moon/codec.h"
 
+#include "stats.h"
+#include "trace.h"
+
 static moon_msg_t message_g;
 
+// Identity of the previous request; used to spot retransmissions (the client
+// re-sending a request whose response it never saw keeps the same sequence)
+static struct {
+	uint8_t valid;
+	uint8_t service;
+	uint8_t method;
+	uint8_t sequence;
+} last_request_g;
+
+// Stream in progress (see moon_server_stream_start())
+static struct {
+	moon_stream_fill_t fill;
+	uint32_t credit;
+	moon_msg_hdr_t header;
+} stream_g;
+
 // Internal function used to respond to messages based on moon_services_handler() return value (e.g. responding appropriately to MOON_RET_E_* versus MOON_RET_OK)
 moon_ret_t _server_response( moon_ret_t ret );
 
+moon_ret_t _server_stream();
+
 moon_ret_t moon_server_init()
 {
 	moon_ret_t ret;
@@ -18,6 +39,8 @@ moon_ret_t moon_server_init()
 		return MOON_RET_E_TRANSPORT;
 	}
 
+	trace_init();
+
 	// Get reference to buffer from the transport layer (for use with codec)
 	message_g.buffer = moon_transport_get_msg_buffer();
 	message_g.read_len = 0;
@@ -40,11 +63,24 @@ moon_ret_t moon_server_poll()
 
 	ret = moon_transport_read();
 
+	// Nothing arriving; the link is ours to send the next stream frame. NOT
+	// READY is also returned partway through a request, whose bytes are in the
+	// buffer the frame would be built in; the stream waits for it.
+	if ( (ret == MOON_RET_MSG_NOT_READY) && stream_g.credit && moon_transport_is_idle() ) {
+		return _server_stream();
+	}
+
 	// Return if a message isn't ready or if there's an error from the transport layer
 	if ( (ret == MOON_RET_MSG_NOT_READY) || ( ret != MOON_RET_MSG_READY )  ) {
 		return ret;
 	}
 
+	// A new request ends any stream; the served function may start another
+	moon_server_stream_stop();
+
+	uint32_t t_start = TRACE_NOW();
+	uint32_t t_stage;
+
 	// Set the read length (used by shim functions to validate message syntax)
 	message_g.read_len = moon_transport_get_read_length();
 
@@ -54,10 +90,49 @@ moon_ret_t moon_server_poll()
 	// Read the header
 	ret = moon_codec_read_header( message_g.buffer, &(message_g.header) );
 	// TODO: Check result of this function (only failure possible is header version not matching MOON_CODEC_VERSION); what is the action if the header version doesn't match? We can't rely on *any* of the data in the header in that case (well, we could add the ability to support old versions, but probably won't)
+	if ( ret < 0 ) {
+		STATS_INC(server_codec_errors);
+	}
+
+	STATS_INC(server_requests);
+
+	if ( last_request_g.valid
+		&& (last_request_g.service == message_g.header.service)
+		&& (last_request_g.method == message_g.header.method)
+		&& (last_request_g.sequence == message_g.header.sequence) ) {
+		STATS_INC(server_retries);
+	}
+
+	last_request_g.valid = 1;
+	last_request_g.service = message_g.header.service;
+	last_request_g.method = message_g.header.method;
+	last_request_g.sequence = message_g.header.sequence;
+
+	t_stage = TRACE_NOW();
+	TRACE_STAGE( TRACE_STAGE_DECODE, t_start, t_stage );
+	t_start = t_stage;
 
 	// Message ready, pass to service handler
 	ret = moon_services_handler( &message_g );
 
+	t_stage = TRACE_NOW();
+	TRACE_STAGE( TRACE_STAGE_DISPATCH, t_start, t_stage );
+	TRACE_METHOD( message_g.header.service, message_g.header.method, t_start, t_stage );
+
+	switch ( ret ) {
+		case MOON_RET_E_NO_SERVICE:
+			STATS_INC(server_no_service);
+			break;
+		case MOON_RET_E_NO_METHOD:
+			STATS_INC(server_no_method);
+			break;
+		case MOON_RET_E_SYNTAX:
+			STATS_INC(server_syntax_errors);
+			break;
+		default:
+			break;
+	}
+
 	return _server_response( ret );
 }
 
@@ -76,6 +151,9 @@ moon_ret_t _server_response( moon_ret_t ret )
 	// NOTE: Default value of protocol; over-written if the message has failed (see below). I'm working to isolate the protocol field from the shim functions - the protocol field should indicate server-layer stuff, not message functionality (this is a change from encoding a boolean response in the protocol field).
 	// message_g.header.protocol = MOON_PROT_OK; // OK
 
+	uint32_t t_start = TRACE_NOW();
+	uint32_t t_stage;
+
 	// Shims will *only* return MOON_RET_OK or a value mapping to the "single normal" response protocol field (e.g. MOON_RET_E_NO_SERVICE)
 	if ( ret != MOON_RET_OK ) {
 		// Configure response 
@@ -87,5 +165,64 @@ moon_ret_t _server_response( moon_ret_t ret )
 		moon_codec_write_header( message_g.buffer, &(message_g.header) );
 	}
 
-	return moon_transport_write( message_g.write_len );
+	t_stage = TRACE_NOW();
+	TRACE_STAGE( TRACE_STAGE_ENCODE, t_start, t_stage );
+	t_start = t_stage;
+
+	ret = moon_transport_write( message_g.write_len );
+
+	TRACE_STAGE( TRACE_STAGE_TRANSMIT, t_start, TRACE_NOW() );
+
+	return ret;
+}
+
+void moon_server_stream_start( moon_stream_fill_t fill, uint32_t n_frames )
+{
+	if ( (! fill) || (n_frames == 0) ) {
+		moon_server_stream_stop();
+		return;
+	}
+
+	stream_g.fill = fill;
+	stream_g.credit = n_frames;
+
+	// NOTE: message_g still holds the header of the request being served
+	stream_g.header.type = MSG_TYPE_MULTI_STREAM;
+	stream_g.header.service = message_g.header.service;
+	stream_g.header.method = message_g.header.method;
+	stream_g.header.sequence = message_g.header.sequence;
+	stream_g.header.protocol = MOON_PROT_OK;
+}
+
+void moon_server_stream_stop()
+{
+	stream_g.fill = 0;
+	stream_g.credit = 0;
+}
+
+// Build and send one stream frame
+moon_ret_t _server_stream()
+{
+	uint8_t last = 0;
+	int len;
+
+	len = stream_g.fill( &(message_g.buffer[MOON_STREAM_HDR_LEN]),
+		(moon_transport_get_max_length() - MOON_STREAM_HDR_LEN), &last );
+
+	if ( len < 0 ) {
+		moon_server_stream_stop();
+		return MOON_RET_OK;
+	}
+
+	stream_g.credit--;
+	if ( last ) {
+		stream_g.credit = 0;
+	}
+
+	// The header write covers the flags byte as well (it writes a word); set
+	// the flags after it
+	moon_codec_write_header( message_g.buffer, &(stream_g.header) );
+	moon_codec_write_u8( message_g.buffer, (last ? MOON_STREAM_FLAG_LAST : 0), 3 );
+
+	return moon_transport_write( MOON_STREAM_HDR_LEN + (uint32_t)len );
 }
@@ -1,17 +1,19 @@
 
+#include "config.h"
 #include "moon/server.h"
 #include "moon/transport.h"
 
 #include "sll.h"
 #include "usart.h"
+#include "stats.h"
+#include "frame_trace.h"
 
 // Sanity check message size against maximum payload size
 #if (MOON_MAX_MESSAGE_LEN > SLL_MAX_PAYLOD_LEN)
 	#error "Maximum message size cannot be greater than SLL maximum payload size"
 #endif
 
-// TODO: This should maybe be in a header; It should at least be a CONFIG variable
-#define TRANSPORT_USART_NO 1
+#define TRANSPORT_USART_NO CONFIG_MOON_TRANSPORT_USART
 
 // Internal frame and buffer declarations
 static sll_decode_frame_t sll_frame_g;
@@ -37,6 +39,8 @@ moon_ret_t moon_transport_init()
 		return MOON_RET_E_TRANSPORT;
 	}
 
+	frame_trace_init();
+
 	return MOON_RET_OK;
 }
 
@@ -50,6 +54,11 @@ uint32_t moon_transport_get_read_length()
 	return sll_get_decoded_len( &sll_frame_g );
 }
 
+uint32_t moon_transport_get_max_length()
+{
+	return SLL_MAX_PAYLOD_LEN;
+}
+
 // Non-blocking transport 
 moon_ret_t moon_transport_read()
 {
@@ -74,8 +83,17 @@ moon_ret_t moon_transport_read()
 	// Check if there's a character ready from USART
 	ret = usart_read( TRANSPORT_USART_NO, &c, USART_FLAGS_NONBLOCK );
 
-	// TODO: Distinguish between error types
+	// NOTE: The error types are only distinguished in the statistics; the
+	// server gets a generic E_TRANSPORT either way (see above)
 	if ( ret < 0 ) {
+		if ( ret == USART_E_OVERRUN ) {
+			STATS_INC(usart_overruns);
+		} else if ( ret == USART_E_FRAMING ) {
+			STATS_INC(usart_frame_errors);
+		}
+
+		FRAME_TRACE( FRAME_TRACE_RX_ERROR, 0, 0 );
+		STATS_INC(transport_errors);
 		return MOON_RET_E_TRANSPORT;
 	} else if ( ret == 0 ) {
 		return MOON_RET_MSG_NOT_READY;
@@ -84,8 +102,11 @@ moon_ret_t moon_transport_read()
 	// Advance the SLL FSM; check if a frame is ready
 	ret = sll_decode( &sll_frame_g, c );
 
-	// TODO: Distinguish between error types
+	// NOTE: CRC failures are counted by the SLL; the payload is still in the
+	// buffer for the trace
 	if ( ret < 0 ) {
+		FRAME_TRACE( FRAME_TRACE_RX_CRC, sll_get_data_buffer( &sll_frame_g ), sll_get_decoded_len( &sll_frame_g ) );
+		STATS_INC(transport_errors);
 		return MOON_RET_E_TRANSPORT; // Error
 	} else if ( ret == 0 ) {
 		return MOON_RET_MSG_NOT_READY;
@@ -97,10 +118,17 @@ moon_ret_t moon_transport_read()
 	// set it smaller for some reason. If so, we need to check that the returned
 	// size of the payload is lte to the max message length.
 
+	FRAME_TRACE( FRAME_TRACE_RX, sll_get_data_buffer( &sll_frame_g ), sll_get_decoded_len( &sll_frame_g ) );
+
 	// Frame is ready, indicate so
 	return MOON_RET_MSG_READY;
 }
 
+bool moon_transport_is_idle()
+{
+	return sll_decode_is_idle( &sll_frame_g );
+}
+
 moon_ret_t moon_transport_write( uint32_t len )
 {
 	// TODO: Is len == 0 an error (?)
@@ -109,16 +137,21 @@ moon_ret_t moon_transport_write( uint32_t len )
 	// function to have a consistent API for SLL. Some of these weird API issues
 	// are because I'm writing this in C...
 	//
+	// NOTE: Traced before the encode; it frames the payload in place
+	FRAME_TRACE( FRAME_TRACE_TX, sll_get_data_buffer( &sll_frame_g ), len );
+
 	// sll_encode returns the length of the encoded frame or ltz on failure
 	int ret = sll_encode( &sll_frame_g, len );
 
 	if ( ret < 0 ) {
+		STATS_INC(transport_errors);
 		return MOON_RET_E_TRANSPORT;
 	}
 
 	ret = usart_write( TRANSPORT_USART_NO, sll_buffer_g, ret );
 
 	if ( ret < 0 ) {
+		STATS_INC(transport_errors);
 		return MOON_RET_E_TRANSPORT;
 	}
 
@@ -0,0 +1,248 @@
+
+#include "page_cache.h"
+
+#include "flash.h"
+
+#include <stdbool.h>
+
+#define PAGE_WORDS	(CONFIG_PAGE_SIZE / sizeof(uint32_t))
+#define MASK_WORDS	(CONFIG_PAGE_SIZE / 32)	// One bit per byte
+
+_Static_assert( (CONFIG_PAGE_SIZE % 32) == 0, "Page cache masks assume a multiple of 32 byte pages" );
+
+typedef union __attribute__((aligned (32))) {
+	uint8_t u8[CONFIG_PAGE_SIZE];
+	uint32_t u32[PAGE_WORDS];
+} cache_page_t;
+
+typedef struct {
+	cache_page_t data;
+	uint32_t mask[MASK_WORDS];	// Bytes written since the page was loaded
+	uint32_t id;
+	uint32_t page;
+	uint32_t used;				// LRU stamp; 0 == free entry
+} cache_entry_t;
+
+static cache_entry_t entries_g[PAGE_CACHE_ENTRIES];
+static uint32_t stamp_g = 0;
+
+static inline bool __entry_is_free( const cache_entry_t * entry )
+{
+	return (entry->used == 0);
+}
+
+static inline void __entry_free( cache_entry_t * entry )
+{
+	entry->used = 0;
+}
+
+static bool __entry_is_full( const cache_entry_t * entry )
+{
+	uint32_t i;
+
+	for ( i = 0; i < MASK_WORDS; i++ ) {
+		if ( entry->mask[i] != 0xFFFFFFFF ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static inline void __entry_touch( cache_entry_t * entry )
+{
+	// NOTE: Wraps after 2^32 writes; the order is only off for one eviction
+	if ( ++stamp_g == 0 ) {
+		stamp_g = 1;
+	}
+
+	entry->used = stamp_g;
+}
+
+// Program the entry and check it read back; the entry is freed either way
+static int __entry_commit( cache_entry_t * entry, const flash_partition_t * partition )
+{
+	const uint32_t * flash;
+	uint32_t i;
+	int ret;
+
+	ret = flash_write_page( entry->id, entry->data.u8, entry->page );
+
+	if ( ret >= 0 ) {
+		flash = (const uint32_t *)(partition->start + (entry->page * CONFIG_PAGE_SIZE));
+		for ( i = 0; i < PAGE_WORDS; i++ ) {
+			if ( flash[i] != entry->data.u32[i] ) {
+				ret = PAGE_CACHE_E_READBACK;
+				break;
+			}
+		}
+	}
+
+	__entry_free( entry );
+
+	return ret;
+}
+
+static int __entry_commit_id( cache_entry_t * entry )
+{
+	flash_partition_t partition;
+
+	if ( flash_get_partition( entry->id, &partition ) < 0 ) {
+		__entry_free( entry );
+		return (-1);
+	}
+
+	return __entry_commit( entry, &partition );
+}
+
+// Find the entry for the page, or load one (evicting the least recently used)
+static cache_entry_t * __entry_get( uint32_t id, uint32_t page, const flash_partition_t * partition, int * ret )
+{
+	cache_entry_t * victim = &entries_g[0];
+	const uint32_t * flash;
+	uint32_t i;
+
+	*ret = 0;
+
+	for ( i = 0; i < PAGE_CACHE_ENTRIES; i++ ) {
+		if ( (! __entry_is_free( &entries_g[i] )) &&
+			(entries_g[i].id == id) && (entries_g[i].page == page) ) {
+			return &entries_g[i];
+		}
+	}
+
+	for ( i = 0; i < PAGE_CACHE_ENTRIES; i++ ) {
+		if ( __entry_is_free( &entries_g[i] ) ) {
+			victim = &entries_g[i];
+			break;
+		}
+
+		if ( entries_g[i].used < victim->used ) {
+			victim = &entries_g[i];
+		}
+	}
+
+	if ( ! __entry_is_free( victim ) ) {
+		*ret = __entry_commit_id( victim );
+	}
+
+	flash = (const uint32_t *)(partition->start + (page * CONFIG_PAGE_SIZE));
+	for ( i = 0; i < PAGE_WORDS; i++ ) {
+		victim->data.u32[i] = flash[i];
+	}
+
+	for ( i = 0; i < MASK_WORDS; i++ ) {
+		victim->mask[i] = 0;
+	}
+
+	victim->id = id;
+	victim->page = page;
+
+	return victim;
+}
+
+int page_cache_write( uint32_t id, uint32_t offset, const uint8_t * data, uint32_t len )
+{
+	flash_partition_t partition;
+	cache_entry_t * entry;
+	uint32_t page;
+	uint32_t index;
+	uint32_t n;
+	uint32_t i;
+	int ret = 0;
+	int evict_ret;
+
+	if ( (! data) || (flash_get_partition( id, &partition ) < 0) ) {
+		return (-1);
+	}
+
+	if ( (offset > (partition.end - partition.start)) ||
+		(len > ((partition.end - partition.start) - offset)) ) {
+		return (-1);
+	}
+
+	while ( len > 0 ) {
+		page = offset / CONFIG_PAGE_SIZE;
+		index = offset % CONFIG_PAGE_SIZE;
+
+		n = CONFIG_PAGE_SIZE - index;
+		if ( n > len ) {
+			n = len;
+		}
+
+		entry = __entry_get( id, page, &partition, &evict_ret );
+		if ( (evict_ret < 0) && (ret == 0) ) {
+			ret = evict_ret;
+		}
+
+		for ( i = 0; i < n; i++ ) {
+			entry->data.u8[index + i] = data[i];
+			entry->mask[(index + i) / 32] |= (1UL << ((index + i) % 32));
+		}
+
+		__entry_touch( entry );
+
+		if ( __entry_is_full( entry ) ) {
+			evict_ret = __entry_commit( entry, &partition );
+			if ( (evict_ret < 0) && (ret == 0) ) {
+				ret = evict_ret;
+			}
+		}
+
+		offset += n;
+		data += n;
+		len -= n;
+	}
+
+	return ret;
+}
+
+int page_cache_flush( uint32_t id )
+{
+	uint32_t i;
+	int ret = 0;
+	int commit_ret;
+
+	for ( i = 0; i < PAGE_CACHE_ENTRIES; i++ ) {
+		if ( __entry_is_free( &entries_g[i] ) ) {
+			continue;
+		}
+
+		if ( (id != PAGE_CACHE_ALL) && (entries_g[i].id != id) ) {
+			continue;
+		}
+
+		commit_ret = __entry_commit_id( &entries_g[i] );
+		if ( (commit_ret < 0) && (ret == 0) ) {
+			ret = commit_ret;
+		}
+	}
+
+	return ret;
+}
+
+void page_cache_discard( uint32_t id, uint32_t page )
+{
+	uint32_t i;
+
+	for ( i = 0; i < PAGE_CACHE_ENTRIES; i++ ) {
+		if ( (entries_g[i].id == id) &&
+			((page == PAGE_CACHE_ALL) || (entries_g[i].page == page)) ) {
+			__entry_free( &entries_g[i] );
+		}
+	}
+}
+
+uint32_t page_cache_pending()
+{
+	uint32_t i;
+	uint32_t n = 0;
+
+	for ( i = 0; i < PAGE_CACHE_ENTRIES; i++ ) {
+		if ( ! __entry_is_free( &entries_g[i] ) ) {
+			n++;
+		}
+	}
+
+	return n;
+}
@@ -1,6 +1,9 @@
 
 #include "config.h"
 #include "moon/services/bootloader.h"
+#include "moon/server.h"
+#include "moon/codec.h"
+#include "moon/transport.h"
 
 #include "crc.h"
 #include "printf.h"
@@ -9,6 +12,13 @@
 #include "system.h"
 
 #include "flash.h"
+#include "boot_record.h"
+#include "image.h"
+#include "verify.h"
+#include "copy.h"
+#include "page_cache.h"
+#include "stats.h"
+#include "trace.h"
 
 // TODO: The return types for most methods is 'int8_t'; however, it would probably be more clear / useful to have an enum mapped to error values. This is a good example of where mapping from the internal representation (e.g. int32_t / enum) to the "on wire" representation (probably 'int8_t') will be an interesting implementation detail. Oh, the TODO is to swap these out for enums at some point.
 
@@ -23,7 +33,24 @@ typedef union __attribute__((aligned (32))) {
 	uint32_t u32[CONFIG_PAGE_SIZE / sizeof(uint32_t)];
 } page_buffer_t;
 
-static page_buffer_t page_buffer_g;
+#if defined(CONFIG_FLASH_DIRECT_LATCH)
+	// The page buffer is the flash controller's latch (see flash.h); chunks are
+	// written straight into it and bl_writePage only issues the program
+	// command. The latch can't be read back, so the page CRC is kept as the
+	// data goes in, which means chunks have to arrive in ascending order (gaps
+	// read as FF).
+	static struct {
+		uint32_t owner;	// Latch generation claimed by bl_erasePageBuffer; 0 == not claimed
+		uint32_t next;	// Byte offset the running CRC has reached
+		uint32_t word;	// Latch word being assembled
+		uint32_t crc;	// Running CRC of [0, next)
+		uint32_t last_app;	// Last page programmed; bl_writePage resent for it is answered 0
+		uint32_t last_page;
+		uint32_t last_crc;
+	} latch_g = { .last_page = 0xFFFFFFFF };
+#else
+	static page_buffer_t page_buffer_g __dtcm;
+#endif // defined(CONFIG_FLASH_DIRECT_LATCH)
 
 // Configuration per "app":
 // - page_no (max) (min is always 0)
@@ -36,6 +63,107 @@ void bl_ping()
 // TODO: (10) [refactor] @error_handling Is "data_len" of 0 an error (?)
 // TODO: (10) [refactor] @error_handling I should probably check for data == NULL (?); the call comes from generated code, but someone could also use these manually (that's the whole point)
 // TODO: (10) [api] Define return type values (e.g. invalid offset, invalid data_len (or just the combination of them))
+#if defined(CONFIG_FLASH_DIRECT_LATCH)
+
+// Append a byte at latch_g.next; complete words go straight to the latch
+static inline void __latch_put( uint8_t data )
+{
+	uint32_t shift = (latch_g.next & 0x3) * 8;
+
+	latch_g.word = (latch_g.word & ~(0xFFUL << shift)) | ((uint32_t)data << shift);
+	latch_g.crc = crc_32_update( latch_g.crc, data );
+
+	if ( (latch_g.next & 0x3) == 0x3 ) {
+		flash_latch_write( (latch_g.next & ~0x3UL), latch_g.word );
+		latch_g.word = 0xFFFFFFFF;
+	}
+
+	latch_g.next++;
+}
+
+// NOTE: Returns (-3) if the chunk overlaps what's already been written (or
+// bl_erasePageBuffer wasn't called after the last bl_writePage) and (-4) if
+// another flash write took the latch since bl_erasePageBuffer
+int8_t bl_writePageBuffer( uint16_t offset, uint8_t data_len, const uint8_t * data )
+{
+	if ( ! data ) {
+		return (-1);
+	}
+
+	// Check offset / length arguments
+	if ( (offset + data_len) > CONFIG_PAGE_SIZE ) {
+		return (-2);
+	}
+
+	if ( latch_g.owner == 0 ) {
+		return (-3);
+	}
+
+	// A chunk resent after a lost response has already gone in; if it was
+	// different after all, the page CRC in bl_writePage catches it
+	if ( (offset + data_len) <= latch_g.next ) {
+		return 0;
+	}
+
+	if ( offset < latch_g.next ) {
+		return (-3);
+	}
+
+	if ( latch_g.owner != flash_latch_owner() ) {
+		return (-4);
+	}
+
+	// Skipped bytes are FF (the latch already is)
+	while ( latch_g.next < offset ) {
+		__latch_put( 0xFF );
+	}
+
+	uint32_t i;
+	for ( i = 0; i < data_len; i++ ) {
+		__latch_put( data[i] );
+	}
+
+	return 0;
+}
+
+// A bl_writePage resent after its response was lost finds the latch spent (or
+// already holding the next page); it's done if it names the page programmed
+// last and that page still holds it
+static bool __latch_is_repeat( uint32_t app_id, uint32_t page_no, uint32_t crc )
+{
+	flash_partition_t partition;
+	uint32_t page_crc;
+
+	if ( (app_id != latch_g.last_app) || (page_no != latch_g.last_page) || (crc != latch_g.last_crc) ) {
+		return false;
+	}
+
+	if ( flash_get_partition( app_id, &partition ) < 0 ) {
+		return false;
+	}
+
+	page_crc = crc_32_update_block( CRC_32_INIT_VALUE,
+		(const uint8_t *)(partition.start + (page_no * CONFIG_PAGE_SIZE)), CONFIG_PAGE_SIZE );
+
+	return (crc_32_finalize( page_crc ) == crc);
+}
+
+void bl_erasePageBuffer(void)
+{
+	uint32_t i;
+
+	latch_g.owner = flash_latch_claim();
+	latch_g.next = 0;
+	latch_g.word = 0xFFFFFFFF;
+	latch_g.crc = CRC_32_INIT_VALUE;
+
+	for ( i = 0; i < CONFIG_PAGE_SIZE; i += 4 ) {
+		flash_latch_write( i, 0xFFFFFFFF );
+	}
+}
+
+#else // ! defined(CONFIG_FLASH_DIRECT_LATCH)
+
 int8_t bl_writePageBuffer( uint16_t offset, uint8_t data_len, const uint8_t * data )
 {
 	printf( "write_page_buf @ $%04X len %u\n\r", offset, data_len );
@@ -70,6 +198,8 @@ void bl_erasePageBuffer(void)
 	}
 }
 
+#endif // defined(CONFIG_FLASH_DIRECT_LATCH)
+
 // Ok, memory layout:
 // - Designed for SAMRH71 (smallest internal flash)
 // - Internal flash: 128 Kb
@@ -88,6 +218,13 @@ int8_t bl_eraseApp( AppId app_id )
 	uint32_t ret;
 	ret = flash_erase_partition( app_id );
 
+	// Whatever the boot record said about this slot no longer holds
+	boot_record_invalidate( app_id );
+	boot_record_session_end( app_id );
+	page_cache_discard( app_id, PAGE_CACHE_ALL );
+	verify_cancel();
+	copy_cancel();
+
 	return (int8_t)ret;
 }
 
@@ -105,14 +242,62 @@ int8_t bl_writePage( AppId app_id, uint16_t page_no, uint32_t crc )
 	// }
 
 	// Verify page CRC against buffer
+#if defined(CONFIG_FLASH_DIRECT_LATCH)
+	if ( __latch_is_repeat( app_id, page_no, crc ) ) {
+		return 0;
+	}
+
+	if ( latch_g.owner == 0 ) {
+		return (-3); // Nothing in the latch since the last page
+	}
+
+	// The rest of the page is FF; this also writes out a partial last word
+	while ( latch_g.next < CONFIG_PAGE_SIZE ) {
+		__latch_put( 0xFF );
+	}
+
+	uint32_t buffer_crc = crc_32_finalize( latch_g.crc );
+#else
 	uint32_t buffer_crc = crc_32( page_buffer_g.u8, CONFIG_PAGE_SIZE );
+#endif // defined(CONFIG_FLASH_DIRECT_LATCH)
 	printf( "  buffer_crc $%08X\n\r", buffer_crc );
 
 	if ( crc != buffer_crc ) {
 		return (-2);
 	}
 
+	// The slot is changing under the boot record (no flash access unless the
+	// record still describes it, i.e. the slot wasn't erased with bl_eraseApp)
+	boot_record_invalidate( app_id );
+	page_cache_discard( app_id, page_no ); // This page replaces anything cached for it
+	verify_cancel();
+	copy_cancel();
+
+#if defined(CONFIG_FLASH_DIRECT_LATCH)
+	// Another write went through the latch (e.g. boot_record_invalidate()
+	// above, if the record still described the slot); the page has to be sent
+	// again
+	if ( latch_g.owner != flash_latch_owner() ) {
+		latch_g.owner = 0;
+		return (-4);
+	}
+
+	latch_g.owner = 0; // The latch is spent; bl_erasePageBuffer before the next page
+
+	int ret = flash_commit_latch( app_id, page_no );
+	if ( ret >= 0 ) {
+		latch_g.last_app = app_id;
+		latch_g.last_page = page_no;
+		latch_g.last_crc = crc;
+	}
+#else
 	int ret = flash_write_page( app_id, page_buffer_g.u8, page_no );
+#endif // defined(CONFIG_FLASH_DIRECT_LATCH)
+
+	// Counts towards the upload session if it's the next page in order
+	if ( ret >= 0 ) {
+		boot_record_session_commit( app_id, page_no );
+	}
 
 	// TODO: Should we CRC the page after writing it (?) I just discovered the case where you didn't erase the page and then when you write to it you get the combination of the old data and the new...
 	// TODO: Should maybe check for / warn for / error for writing to a page that hasn't been erased (keep a bitmask of erase state)
@@ -152,9 +337,439 @@ int8_t bl_boot()
 {
 	printf( "boot\n\r" );
 
-	// Validate CRC of application
-	// ...
-	
-	// Set global state variable for "perform boot"
+	// Set global state variable for "perform boot"; the application is checked
+	// against the boot record (if the record describes the slot) first
 	return (int8_t)sys_set_boot_enable();
 }
+
+// NOTE: No printf here; this is polled by tools while traffic is flowing and
+// shouldn't perturb the numbers it reports
+int8_t bl_getStats( bool reset, Stats * stats )
+{
+	stats_t s;
+
+	if ( ! stats ) {
+		return (-1);
+	}
+
+	stats_get( &s );
+
+	// Counters are cleared after the snapshot so nothing is lost between the
+	// read and the reset
+	if ( reset ) {
+		stats_reset();
+	}
+
+	stats->sll_frames = s.sll_frames;
+	stats->sll_crc_errors = s.sll_crc_errors;
+	stats->sll_len_errors = s.sll_len_errors;
+	stats->usart_overruns = s.usart_overruns;
+	stats->usart_frame_errors = s.usart_frame_errors;
+	stats->transport_errors = s.transport_errors;
+	stats->server_requests = s.server_requests;
+	stats->server_retries = s.server_retries;
+	stats->server_no_service = s.server_no_service;
+	stats->server_no_method = s.server_no_method;
+	stats->server_syntax_errors = s.server_syntax_errors;
+	stats->server_codec_errors = s.server_codec_errors;
+
+	return 0;
+}
+
+// Rows past the end (or every row, if CONFIG_TRACE is unset) return (-1) so the
+// tool knows where to stop
+int8_t bl_getTrace( uint8_t index, TraceEntry * entry )
+{
+	trace_entry_t e;
+
+	if ( ! entry ) {
+		return (-1);
+	}
+
+	if ( trace_get( index, &e ) < 0 ) {
+		entry->kind = TRACE_STAGE;
+		entry->id = 0;
+		entry->method = 0;
+		entry->count = 0;
+		entry->min = 0;
+		entry->max = 0;
+		entry->timebase_hz = 0;
+		entry->sum = 0;
+		return (-1);
+	}
+
+	entry->kind = (e.kind == TRACE_KIND_METHOD) ? TRACE_METHOD : TRACE_STAGE;
+	entry->id = e.id;
+	entry->method = e.method;
+	entry->count = e.hist.count;
+	entry->min = (e.hist.count > 0) ? e.hist.min : 0;
+	entry->max = e.hist.max;
+	entry->timebase_hz = TRACE_TIMEBASE_HZ;
+	entry->sum = e.hist.sum;
+
+	return 0;
+}
+
+void bl_resetTrace()
+{
+	trace_reset();
+}
+
+// NOTE: This hashes 'length' bytes of the slot before answering; the image is
+// then marked verified so the boot path doesn't have to hash it again
+int8_t bl_setActiveApp( AppId app_id, uint32_t length, uint32_t crc )
+{
+	printf( "setActiveApp %i len %u crc $%08X\n\r", app_id, length, crc );
+
+	// Pages still cached from bl_writeAddress are part of the image
+	page_cache_flush( app_id );
+
+	int ret = boot_record_set_active( app_id, length, crc );
+
+	return (ret < 0) ? ((ret < (-2)) ? (-3) : (int8_t)ret) : 0;
+}
+
+int8_t bl_getBootRecord( BootRecord * record )
+{
+	boot_record_t r;
+	uint32_t i;
+
+	if ( ! record ) {
+		return (-1);
+	}
+
+	boot_record_get( &r );
+
+	record->active = (int8_t)boot_record_get_active();
+	record->attempts = (uint8_t)boot_record_get_attempts();
+#if defined(CONFIG_BOOT_ATTEMPTS)
+	record->max_attempts = BOOT_RECORD_MAX_ATTEMPTS;
+#else
+	record->max_attempts = 0; // Not counted
+#endif // defined(CONFIG_BOOT_ATTEMPTS)
+	record->verified = 0;
+	for ( i = 0; i < BOOT_RECORD_N_SLOTS; i++ ) {
+		if ( r.verified[i].mark != BOOT_RECORD_ERASED ) {
+			record->verified |= (1 << i);
+		}
+	}
+	record->app1_length = r.slot[APP_1].length;
+	record->app1_crc = r.slot[APP_1].crc;
+	record->app2_length = r.slot[APP_2].length;
+	record->app2_crc = r.slot[APP_2].crc;
+
+	return boot_record_valid() ? 0 : (-1);
+}
+
+int8_t bl_confirmBoot()
+{
+	printf( "confirmBoot\n\r" );
+
+	return (boot_record_confirm() < 0) ? (-1) : 0;
+}
+
+// Called by the host before erasing a slot; nothing is written, the header is
+// only checked against the slot
+int8_t bl_checkImage( AppId app_id, uint8_t header_len, const uint8_t * header )
+{
+	image_header_t h;
+	int ret;
+
+	ret = image_header_parse( header, header_len, &h );
+	if ( ret < 0 ) {
+		return (int8_t)ret;
+	}
+
+	ret = image_header_check( &h, app_id );
+
+	printf( "checkImage %i len %u crc $%08X: %i\n\r", app_id, h.length, h.crc, ret );
+
+	return (int8_t)ret;
+}
+
+// Polled by the host: the first call (or a call with different arguments)
+// starts hashing the slot in the background (see verify_poll() in main) and
+// returns 1 while it's running; 0 once the CRC matched, (-2) if it didn't and
+// (-1) for an invalid slot / length
+int8_t bl_verifyApp( AppId app_id, uint32_t length, uint32_t crc )
+{
+	if ( ! verify_is( app_id, length, crc ) ) {
+		page_cache_flush( app_id ); // Hash what the host has written so far
+
+		if ( verify_start( app_id, length, crc ) < 0 ) {
+			return (-1);
+		}
+	}
+
+	switch ( verify_status() ) {
+		case VERIFY_BUSY:
+			return 1;
+		case VERIFY_MATCH:
+			return 0;
+		default:
+			return (-2);
+	}
+}
+
+// Readback in progress (bl_readApp); addresses are absolute, the offset is
+// what goes on the wire
+static struct {
+	uint32_t address;
+	uint32_t end;
+	uint32_t offset;
+} readback_g;
+
+// Stream fill for bl_readApp: [0:3] partition offset of the data, [4:] data
+static int __readback_fill( uint8_t * data, uint32_t max_len, uint8_t * last )
+{
+	uint32_t n;
+	uint32_t i;
+
+	if ( max_len <= 4 ) {
+		return (-1);
+	}
+
+	n = readback_g.end - readback_g.address;
+	if ( n > (max_len - 4) ) {
+		n = (max_len - 4);
+	}
+
+	moon_codec_write_u32( data, readback_g.offset, 0 );
+
+	// NOTE: Byte copy; the data isn't word aligned in the frame and the link
+	// is orders of magnitude slower than this loop
+	for ( i = 0; i < n; i++ ) {
+		data[4 + i] = ((const uint8_t *)readback_g.address)[i];
+	}
+
+	readback_g.address += n;
+	readback_g.offset += n;
+
+	*last = (readback_g.address >= readback_g.end) ? 1 : 0;
+
+	return (int)(4 + n);
+}
+
+// Stream 'length' bytes of a slot starting at 'offset'. The response is
+// followed by up to 'frames' stream frames of data (see moon_server_stream_start());
+// to continue, call again from the offset after the last frame received.
+// Returns 0 if the stream was started, (-1) for an invalid slot or range.
+int8_t bl_readApp( AppId app_id, uint32_t offset, uint32_t length, uint8_t frames )
+{
+	flash_partition_t partition;
+
+	if ( flash_get_partition( app_id, &partition ) < 0 ) {
+		return (-1);
+	}
+
+	if ( (length == 0) || (frames == 0) ||
+		(offset > (partition.end - partition.start)) ||
+		(length > ((partition.end - partition.start) - offset)) ) {
+		return (-1);
+	}
+
+	readback_g.address = partition.start + offset;
+	readback_g.end = readback_g.address + length;
+	readback_g.offset = offset;
+
+	moon_server_stream_start( __readback_fill, frames );
+
+	return 0;
+}
+
+// Copy the first 'length' bytes of slot 'src_id' to slot 'dst_id' on the
+// device (see copy.h). Poll with the same arguments: 1 while it's running, 0
+// once the destination matches the source, (-1) for invalid arguments and
+// (-2) if it failed (details in bl_getCopyStatus). After a failure or an
+// interruption (e.g. a reset) the next call starts over, which skips whatever
+// was already copied.
+int8_t bl_copyApp( AppId src_id, AppId dst_id, uint32_t length )
+{
+	copy_progress_t progress;
+	bool same;
+
+	copy_progress( &progress );
+	same = copy_is( src_id, dst_id, length );
+
+	// Report a failure once; the copy restarts on the next call
+	if ( same && (progress.state == COPY_ERROR) ) {
+		copy_cancel();
+		return (-2);
+	}
+
+	if ( ! same ) {
+		if ( copy_start( src_id, dst_id, length ) < 0 ) {
+			return (-1);
+		}
+
+		// The destination is about to change
+		boot_record_invalidate( dst_id );
+		boot_record_session_end( dst_id );
+		page_cache_discard( dst_id, PAGE_CACHE_ALL );
+		verify_cancel();
+
+		copy_progress( &progress );
+	}
+
+	return (progress.state == COPY_DONE) ? 0 : 1;
+}
+
+// Returns 0 and the progress of the current / last copy, (-1) if there's none
+int8_t bl_getCopyStatus( CopyStatus * status )
+{
+	copy_progress_t progress;
+
+	copy_progress( &progress );
+
+	status->state = (uint8_t)progress.state;
+	status->error = (progress.error < INT8_MIN) ? INT8_MIN : (int8_t)progress.error;
+	status->pages = (uint16_t)progress.pages;
+	status->page = (uint16_t)progress.page;
+	status->erased = (uint16_t)progress.erased;
+	status->programmed = (uint16_t)progress.programmed;
+	status->skipped = (uint16_t)progress.skipped;
+
+	return (progress.state == COPY_IDLE) ? (-1) : 0;
+}
+
+// Erase slot 'app_id' and start a resumable upload of an image of 'length'
+// bytes with CRC-32 'crc' (see boot_record.h). Pages written in order with
+// bl_writePage are committed to the session; bl_setActiveApp ends it. Returns
+// 0, (-1) for invalid arguments or a flash error code. Without a boot record
+// the slot is erased all the same, there's just no session to resume.
+int8_t bl_beginUpload( AppId app_id, uint32_t length, uint32_t crc )
+{
+	int ret;
+
+	printf( "beginUpload %i len %u crc $%08X\n\r", app_id, length, crc );
+
+	page_cache_discard( app_id, PAGE_CACHE_ALL );
+	verify_cancel();
+	copy_cancel();
+
+	ret = flash_erase_partition( app_id );
+	if ( ret < 0 ) {
+		return (int8_t)ret;
+	}
+
+	ret = boot_record_session_begin( app_id, length, crc );
+
+	return (ret < INT8_MIN) ? INT8_MIN : (int8_t)ret;
+}
+
+// Returns 0 and the upload session, (-1) if there's none. The host resumes
+// from page 'committed' (everything before it was written in order).
+int8_t bl_getUploadSession( UploadSession * session )
+{
+	boot_record_session_t s;
+
+	if ( boot_record_session_get( &s ) < 0 ) {
+		session->app_id = (-1);
+		session->reserved = 0;
+		session->committed = 0;
+		session->length = 0;
+		session->crc = 0;
+		return (-1);
+	}
+
+	session->app_id = (int8_t)s.slot;
+	session->reserved = 0;
+	session->committed = (uint16_t)s.committed;
+	session->length = s.length;
+	session->crc = s.crc;
+
+	return 0;
+}
+
+// Write 'data_len' bytes at 'offset' into slot 'app_id' through the page cache
+// (see page_cache.h); the slot should be erased first (bl_eraseApp /
+// bl_beginUpload). Writes may come in any order and leave gaps. Returns 0,
+// (-1) for an invalid slot / range, or the error of a page committed on the
+// way ((-2) if it didn't read back, i.e. it wasn't erased).
+int8_t bl_writeAddress( AppId app_id, uint32_t offset, uint8_t data_len, const uint8_t * data )
+{
+	int ret;
+
+	if ( ! data ) {
+		return (-1);
+	}
+
+	// The slot is changing under the boot record / background work
+	boot_record_invalidate( app_id );
+	verify_cancel();
+	copy_cancel();
+
+	ret = page_cache_write( app_id, offset, data, data_len );
+
+	return (ret < INT8_MIN) ? INT8_MIN : (int8_t)ret;
+}
+
+// Commit every page still cached by bl_writeAddress. Returns 0 or the first
+// commit error.
+int8_t bl_flushWrites()
+{
+	int ret = page_cache_flush( PAGE_CACHE_ALL );
+
+	return (ret < INT8_MIN) ? INT8_MIN : (int8_t)ret;
+}
+
+// DeviceInfo layout; bump when fields are appended
+#define BL_INFO_VERSION		1
+
+static const uint32_t features_g = 0
+#if defined(CONFIG_BOOT_RECORD)
+	| FEATURE_BOOT_RECORD
+#endif
+#if defined(CONFIG_FAST_BOOT)
+	| FEATURE_FAST_BOOT
+#endif
+#if defined(CONFIG_HANDOFF)
+	| FEATURE_HANDOFF
+#endif
+#if defined(CONFIG_BL_API)
+	| FEATURE_BL_API
+#endif
+#if defined(CONFIG_FLASH_DIRECT_LATCH)
+	| FEATURE_DIRECT_LATCH
+#endif
+#if defined(CONFIG_STATS)
+	| FEATURE_STATS
+#endif
+#if defined(CONFIG_TRACE)
+	| FEATURE_TRACE
+#endif
+#if defined(CONFIG_RAM_BUILD)
+	| FEATURE_RAM_BUILD
+#endif
+	;
+
+// Everything the host would otherwise take from a per-board table. A slot
+// that doesn't exist reads as start / size 0. Always returns 0.
+int8_t bl_getInfo( DeviceInfo * info )
+{
+	flash_partition_t partition;
+
+	info->info_version = BL_INFO_VERSION;
+	info->codec_version = MOON_CODEC_VERSION;
+	info->page_size = CONFIG_PAGE_SIZE;
+	info->max_message_len = (uint16_t)moon_transport_get_max_length();
+	info->erase_pages = FLASH_ERASE_MIN_PAGES;
+	info->features = features_g;
+	info->baud_rate = CONFIG_USART_BAUD;
+
+	info->app1_start = 0;
+	info->app1_size = 0;
+	if ( flash_get_partition( APP_1, &partition ) == 0 ) {
+		info->app1_start = partition.start;
+		info->app1_size = partition.end - partition.start;
+	}
+
+	info->app2_start = 0;
+	info->app2_size = 0;
+	if ( flash_get_partition( APP_2, &partition ) == 0 ) {
+		info->app2_start = partition.start;
+		info->app2_size = partition.end - partition.start;
+	}
+
+	return 0;
+}
@@ -2,6 +2,8 @@
 
 #include "sll.h"
 #include "crc.h"
+#include "stats.h"
+#include "common.h"
 
 // TODO: (2) @poorly_defined If the buffer is declared external to the SLL module then it should be a compile-time error to provide a buffer smaller than SLL_MAX_PAYLOD_LEN.
 // TODO: (2) @poorly_defined SLL_MAX_PAYLOD_LEN should maybe be a config variable (?), so it would become CONFIG_SLL_MAX_PAYLOD_LEN
@@ -62,7 +64,7 @@ uint32_t sll_get_decoded_len( sll_decode_frame_t * const frame )
 // - I don't think there's a reason to have a 0-length frame. I can just make that an error on the encode size (both client and server).
 // 
 // TODO: (0) [api] Change length handling such that frame_len(0) = length(1)
-int sll_decode( sll_decode_frame_t * frame, uint8_t c )
+__itcm int sll_decode( sll_decode_frame_t * frame, uint8_t c )
 {
 	switch ( frame->_ctx.state ) {
 		// Waiting for SYNC sequence
@@ -81,6 +83,7 @@ int sll_decode( sll_decode_frame_t * frame, uint8_t c )
 			// NOTE: This assumes that the data buffer is large enough to hold
 			// SLL_MAX_PAYLOD_LEN bytes of data
 			if ( c > SLL_MAX_PAYLOD_LEN ) {
+				STATS_INC(sll_len_errors);
 				frame->_ctx.state = SLL_DECODE_SYNC1;
 				// TODO: (3) [refactor] @error_handling @poorly_defined Hmm. Should this return an error instead of 0 (?)
 				break;
@@ -119,8 +122,10 @@ int sll_decode( sll_decode_frame_t * frame, uint8_t c )
 			frame->_ctx.state = SLL_DECODE_SYNC1;
 
 			if ( frame->_ctx.crc == 0 ) {
+				STATS_INC(sll_frames);
 				return 1; // CRC match
 			} else {
+				STATS_INC(sll_crc_errors);
 				return (-1); // CRC fail
 			}
 
@@ -132,6 +137,12 @@ int sll_decode( sll_decode_frame_t * frame, uint8_t c )
 	return 0;
 }
 
+int sll_decode_is_idle( sll_decode_frame_t * const frame )
+{
+	// NOTE: The sync states don't touch the buffer or the length
+	return (frame->_ctx.state == SLL_DECODE_SYNC1) || (frame->_ctx.state == SLL_DECODE_SYNC2);
+}
+
 int sll_encode( sll_decode_frame_t * const frame, uint32_t data_len )
 {
 	// TODO: (10) [robustness] Enable these asserts
@@ -142,7 +153,8 @@ int sll_encode( sll_decode_frame_t * const frame, uint32_t data_len )
 	// 	return (-1);
 	// }
 
-	if ( data_len >= SLL_MAX_PAYLOD_LEN ) {
+	// NOTE: A full SLL_MAX_PAYLOD_LEN payload is valid (the decoder accepts it)
+	if ( data_len > SLL_MAX_PAYLOD_LEN ) {
 		return (-1);
 	}
 
@@ -0,0 +1,36 @@
+
+#include "stats.h"
+
+#if defined(CONFIG_STATS)
+	stats_t stats_g;
+#endif // defined(CONFIG_STATS)
+
+// NOTE: The copy is done one word at a time (rather than a struct assignment)
+// so the compiler doesn't pull in memcpy; we're built with -nostdlib
+void stats_get( stats_t * stats )
+{
+	uint32_t * dest = (uint32_t *)stats;
+	uint32_t i;
+
+	if ( ! stats ) {
+		return;
+	}
+
+	for ( i = 0; i < (sizeof(stats_t) / sizeof(uint32_t)); i++ ) {
+#if defined(CONFIG_STATS)
+		dest[i] = ((uint32_t *)&stats_g)[i];
+#else
+		dest[i] = 0;
+#endif // defined(CONFIG_STATS)
+	}
+}
+
+void stats_reset()
+{
+#if defined(CONFIG_STATS)
+	uint32_t i;
+	for ( i = 0; i < (sizeof(stats_t) / sizeof(uint32_t)); i++ ) {
+		((uint32_t *)&stats_g)[i] = 0;
+	}
+#endif // defined(CONFIG_STATS)
+}
@@ -5,11 +5,18 @@
 #include "printf.h"
 
 #include "flash.h"
+#include "usart.h"
+#include "dwt.h"
+#include "boot_record.h"
+#include "cache.h"
+#include "clock.h"
+#include "handoff.h"
 
 static bool boot_enable_g = false;
 
 #define BOOT_INVALID_ENTRY 0xFFFFFFFF
 static uint32_t boot_entry_g = BOOT_INVALID_ENTRY; // Initialize to invalid entry point
+static uint32_t boot_id_g;
 
 int sys_set_boot_action( uint32_t id )
 {
@@ -19,16 +26,34 @@ int sys_set_boot_action( uint32_t id )
 	}
 
 	boot_entry_g = partition.start;
+	boot_id_g = id;
 
 	return 0;
 }
 
 int sys_set_boot_enable()
 {
+	boot_record_session_t session;
+
 	if ( boot_entry_g == BOOT_INVALID_ENTRY ) {
 		return (-1);
 	}
 
+	if ( sys_check_app( boot_id_g ) < 0 ) {
+		return (-2); // Nothing bootable there
+	}
+
+	// Only refused on a mismatch; a slot the record doesn't describe (e.g. one
+	// written without bl_setActiveApp) can still be booted by the host
+	if ( boot_record_check( boot_id_g ) == (-2) ) {
+		return (-3);
+	}
+
+	// Nor while an upload to it is open (it's half written)
+	if ( (boot_record_session_get( &session ) == 0) && (session.slot == boot_id_g) ) {
+		return (-3);
+	}
+
 	boot_enable_g = true;
 
 	return 0;
@@ -55,6 +80,17 @@ __attribute__( ( naked, noreturn ) ) void BootJumpASM( uint32_t SP, uint32_t RH
 	__asm__("BX		r1"); // Branch to application entry point, RH passed in RH
 }
 
+// Hand the core over the way it came out of reset: console drained, reset
+// clock tree, caches off (which also writes the handoff block back to SRAM)
+static void __sys_jump( volatile uint32_t * entry, uint32_t reason )
+{
+	usart_flush( 0 );
+	handoff_fill( boot_id_g, reason );
+	clock_deinit();
+	cache_deinit();
+	BootJumpASM( entry[0], entry[1] );
+}
+
 void sys_boot_poll()
 {
 	// Only boot if enabled
@@ -64,5 +100,128 @@ void sys_boot_poll()
 
 	volatile uint32_t * entry = (volatile uint32_t *)(boot_entry_g);
 	printf("Booting from $%08x\n\r", (uint32_t)entry );
-	BootJumpASM( entry[0], entry[1] );
+	__sys_jump( entry, HANDOFF_REASON_HOST );
 }
+
+// NOTE: This is deliberately cheap - it runs on every reset. It catches an
+// erased (all FF) or half-written slot; it doesn't prove the image is intact
+// (that's boot_record_check(), against the length / CRC from the image header)
+int sys_check_app( uint32_t id )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	volatile uint32_t * vectors = (volatile uint32_t *)(partition.start);
+	uint32_t sp = vectors[0];
+	uint32_t reset = vectors[1];
+
+	// Initial stack pointer must be word-aligned and inside SRAM (the top of
+	// SRAM is a valid initial value)
+	if ( (sp & 0x3) ||
+		(sp <= CONFIG_SRAM_BASE_ADDRESS) ||
+		(sp > (CONFIG_SRAM_BASE_ADDRESS + (CONFIG_SRAM_SIZE * 1024))) ) {
+		return (-2);
+	}
+
+	// Reset vector must be a Thumb address inside the partition (past the two
+	// words we just read)
+	if ( ! (reset & 0x1) ||
+		((reset & ~0x1) < (partition.start + 8)) ||
+		((reset & ~0x1) >= partition.end) ) {
+		return (-2);
+	}
+
+	return 0;
+}
+
+#if defined(CONFIG_FAST_BOOT)
+
+void sys_fast_boot()
+{
+	uint32_t id = CONFIG_FAST_BOOT_PARTITION;
+	uint32_t cycles_per_ms = clock_get_core_hz() / 1000; // DWT cycle counter
+	uint32_t start;
+	uint32_t elapsed_ms;
+	uint8_t c;
+	int active;
+	int ret;
+
+	// The boot record (if there is one) picks the slot: the active one, or the
+	// other one if the active slot's attempts are used up or its CRC is bad
+	if ( boot_record_select( &id ) < 0 ) {
+		printf( "Fast boot: no bootable app\n\r" );
+		return;
+	}
+
+	if ( sys_check_app( id ) < 0 ) {
+		printf( "Fast boot: no valid app in partition %u\n\r", id );
+		return;
+	}
+
+#if defined(CONFIG_BOOT_RECORD)
+	// Only an image the record describes (length / CRC) is booted unattended;
+	// e.g. one written without bl_setActiveApp waits for the host
+	if ( boot_record_check( id ) < 0 ) {
+		printf( "Fast boot: partition %u not verified\n\r", id );
+		return;
+	}
+#endif // defined(CONFIG_BOOT_RECORD)
+
+	// Host sync window; any character received on the transport USART keeps us
+	// in the bootloader. The character itself is dropped, which is harmless:
+	// the link layer is hunting for a sync sequence at this point anyway.
+	//
+	// NOTE: Receive errors (e.g. a framing error from a floating line) don't
+	// count as the host; only a character does
+	//
+	// The window is timed a millisecond at a time: the whole window in cycles
+	// doesn't fit the 32-bit counter at PLL clocks (14.3 s at 300 MHz)
+	start = dwt_get_cycles();
+	elapsed_ms = 0;
+	while ( elapsed_ms < CONFIG_FAST_BOOT_WINDOW_MS ) {
+		if ( (dwt_get_cycles() - start) >= cycles_per_ms ) {
+			start += cycles_per_ms;
+			elapsed_ms++;
+			continue;
+		}
+
+		ret = usart_read( CONFIG_MOON_TRANSPORT_USART, &c, USART_FLAGS_NONBLOCK );
+		if ( ret > 0 ) {
+			printf( "Fast boot: cancelled by host\n\r" );
+			return;
+		}
+	}
+
+	// Counted now that we're committed to the jump (with CONFIG_BOOT_ATTEMPTS);
+	// the application clears the count once it's up (see boot_record_confirm())
+	boot_record_attempt( id );
+
+	// Arm the regular boot path so the state is consistent with a host
+	// requested boot
+	sys_set_boot_action( id );
+	boot_enable_g = true;
+
+	volatile uint32_t * entry = (volatile uint32_t *)(boot_entry_g);
+
+#if defined(CONFIG_FAST_BOOT_REPORT)
+	// NOTE: The cycle counter runs from reset_handler() and isn't stopped by
+	// the jump; the application can read DWT_CYCCNT on entry for the exact
+	// figure (this one doesn't include the time taken to print it)
+	printf( "Fast boot: $%08x at %u us\n\r", (uint32_t)entry,
+		dwt_get_cycles() / (clock_get_core_hz() / 1000000) );
+#endif // defined(CONFIG_FAST_BOOT_REPORT)
+
+	// Anything but the active slot (when there is one) is the fallback
+	active = boot_record_get_active();
+	__sys_jump( entry, ((active < 0) || (active == (int)id)) ?
+		HANDOFF_REASON_FAST_BOOT : HANDOFF_REASON_FALLBACK );
+}
+
+#else // ! defined(CONFIG_FAST_BOOT)
+
+void sys_fast_boot() {}
+
+#endif // defined(CONFIG_FAST_BOOT)
+
@@ -0,0 +1,149 @@
+
+#include "trace.h"
+
+#if defined(CONFIG_TRACE)
+
+static trace_hist_t stages_g[TRACE_N_STAGES];
+
+static struct {
+	uint8_t service;
+	uint8_t method;
+	trace_hist_t hist;
+} methods_g[CONFIG_TRACE_MAX_METHODS];
+
+static uint32_t n_methods_g;
+
+static inline void __hist_reset( trace_hist_t * hist )
+{
+	hist->count = 0;
+	hist->min = UINT32_MAX;
+	hist->max = 0;
+	hist->sum = 0;
+}
+
+static inline void __hist_add( trace_hist_t * hist, uint32_t ticks )
+{
+	hist->count++;
+	hist->sum += ticks;
+
+	if ( ticks < hist->min ) {
+		hist->min = ticks;
+	}
+
+	if ( ticks > hist->max ) {
+		hist->max = ticks;
+	}
+}
+
+void trace_init()
+{
+	// NOTE: The DWT cycle counter is started by reset_handler(); nothing to do
+	// for the time base here
+	trace_reset();
+}
+
+void trace_reset()
+{
+	uint32_t i;
+
+	for ( i = 0; i < TRACE_N_STAGES; i++ ) {
+		__hist_reset( &stages_g[i] );
+	}
+
+	// Forget the service / method keys as well so the table can be reused
+	n_methods_g = 0;
+}
+
+void trace_stage( trace_stage_t stage, uint32_t start, uint32_t end )
+{
+	if ( stage >= TRACE_N_STAGES ) {
+		return;
+	}
+
+	__hist_add( &stages_g[stage], (end - start) );
+}
+
+// NOTE: A linear search is fine here; there's a handful of methods and this
+// runs once per request, not per byte
+void trace_method( uint8_t service, uint8_t method, uint32_t start, uint32_t end )
+{
+	uint32_t i;
+
+	for ( i = 0; i < n_methods_g; i++ ) {
+		if ( (methods_g[i].service == service) && (methods_g[i].method == method) ) {
+			break;
+		}
+	}
+
+	if ( i == n_methods_g ) {
+		// Table full, drop the sample
+		if ( n_methods_g >= CONFIG_TRACE_MAX_METHODS ) {
+			return;
+		}
+
+		methods_g[i].service = service;
+		methods_g[i].method = method;
+		__hist_reset( &methods_g[i].hist );
+		n_methods_g++;
+	}
+
+	__hist_add( &methods_g[i].hist, (end - start) );
+}
+
+int trace_get( uint32_t index, trace_entry_t * entry )
+{
+	if ( ! entry ) {
+		return (-1);
+	}
+
+	if ( index < TRACE_N_STAGES ) {
+		entry->kind = TRACE_KIND_STAGE;
+		entry->id = (uint8_t)index;
+		entry->method = 0;
+		entry->hist = stages_g[index];
+		return 0;
+	}
+
+	index -= TRACE_N_STAGES;
+
+	if ( index >= n_methods_g ) {
+		return (-1);
+	}
+
+	entry->kind = TRACE_KIND_METHOD;
+	entry->id = methods_g[index].service;
+	entry->method = methods_g[index].method;
+	entry->hist = methods_g[index].hist;
+
+	return 0;
+}
+
+#else // ! defined(CONFIG_TRACE)
+
+void trace_init() {}
+void trace_reset() {}
+
+void trace_stage( trace_stage_t stage, uint32_t start, uint32_t end )
+{
+	(void)stage;
+	(void)start;
+	(void)end;
+}
+
+void trace_method( uint8_t service, uint8_t method, uint32_t start, uint32_t end )
+{
+	(void)service;
+	(void)method;
+	(void)start;
+	(void)end;
+}
+
+int trace_get( uint32_t index, trace_entry_t * entry )
+{
+	(void)index;
+	(void)entry;
+
+	return (-1); // Tracing not compiled in
+}
+
+#endif // defined(CONFIG_TRACE)
@@ -0,0 +1,81 @@
+
+#include "verify.h"
+
+#include "config.h"
+#include "crc.h"
+#include "flash.h"
+
+// Chunks are whole words so every chunk after the first stays word-aligned
+#if (CONFIG_VERIFY_CHUNK_SIZE % 4)
+	#error "CONFIG_VERIFY_CHUNK_SIZE must be a multiple of 4"
+#endif
+
+static struct {
+	verify_status_t status;
+	uint32_t id;
+	uint32_t length;
+	uint32_t crc;		// Expected
+	uint32_t address;	// Next byte to hash
+	uint32_t remaining;
+	uint32_t running;	// CRC so far (not finalized)
+} verify_g;
+
+int verify_start( uint32_t id, uint32_t length, uint32_t crc )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1);
+	}
+
+	if ( (length == 0) || (length > (partition.end - partition.start)) ) {
+		return (-1);
+	}
+
+	verify_g.id = id;
+	verify_g.length = length;
+	verify_g.crc = crc;
+	verify_g.address = partition.start;
+	verify_g.remaining = length;
+	verify_g.running = CRC_32_INIT_VALUE;
+	verify_g.status = VERIFY_BUSY;
+
+	return 0;
+}
+
+void verify_poll()
+{
+	uint32_t n;
+
+	if ( verify_g.status != VERIFY_BUSY ) {
+		return;
+	}
+
+	n = (verify_g.remaining < CONFIG_VERIFY_CHUNK_SIZE) ? verify_g.remaining : CONFIG_VERIFY_CHUNK_SIZE;
+
+	verify_g.running = crc_32_update_block( verify_g.running, (const uint8_t *)verify_g.address, n );
+	verify_g.address += n;
+	verify_g.remaining -= n;
+
+	if ( verify_g.remaining == 0 ) {
+		verify_g.status = (crc_32_finalize( verify_g.running ) == verify_g.crc) ? VERIFY_MATCH : VERIFY_MISMATCH;
+	}
+}
+
+verify_status_t verify_status()
+{
+	return verify_g.status;
+}
+
+int verify_is( uint32_t id, uint32_t length, uint32_t crc )
+{
+	return (verify_g.status != VERIFY_IDLE)
+		&& (verify_g.id == id)
+		&& (verify_g.length == length)
+		&& (verify_g.crc == crc);
+}
+
+void verify_cancel()
+{
+	verify_g.status = VERIFY_IDLE;
+}
+
@@ -1,5 +1,6 @@
 
 #include "flash.h"
+#include "cache.h"
 #include "config.h"
 
 // TODO: Should probably validate these configs somehow...
@@ -29,24 +30,26 @@
 
 // TODO: Validate alignment requirements
 
+// NOTE: const (i.e. in flash) so flash_get_partition() works without the
+// bootloader's RAM; the application calls it through the API table (bl_api.h)
 #if defined(CONFIG_RAM_BUILD)
-	static flash_partition_t partion_bootloader = {
+	static const flash_partition_t partion_bootloader = {
 		.start = PARTITION_BOOTLOADER_START,
 		.end = PARTITION_BOOTLOADER_END
 	};
 #endif // defined(CONFIG_RAM_BUILD)
 
-static flash_partition_t partion_app1 = {
+static const flash_partition_t partion_app1 = {
 	.start = PARTITION_APP1_START,
 	.end = PARTITION_APP1_END
 };
 
-static flash_partition_t partion_app2 = {
+static const flash_partition_t partion_app2 = {
 	.start = PARTITION_APP2_START,
 	.end = PARTITION_APP2_END
 };
 
-void __copy_partition_struct( flash_partition_t * src, flash_partition_t * dest )
+void __copy_partition_struct( const flash_partition_t * src, flash_partition_t * dest )
 {
 	dest->start = src->start;
 	dest->end = src->end;
@@ -74,3 +77,90 @@ int flash_get_partition( uint32_t id, flash_partition_t * partition )
 
 	return 0;
 }
+
+int flash_erase_pages( uint32_t id, uint16_t page, uint16_t n_pages )
+{
+	flash_partition_t partition;
+	uint32_t end;
+	uint32_t n;
+	int ret;
+
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (page % FLASH_ERASE_MIN_PAGES) || (n_pages % FLASH_ERASE_MIN_PAGES) ) {
+		return (-2);
+	}
+
+	if ( ((uint32_t)page + n_pages) > ((partition.end - partition.start) / CONFIG_PAGE_SIZE) ) {
+		return (-2);
+	}
+
+	// Page numbers within the flash array from here on
+	page += (partition.start - CONFIG_FLASH_BASE_ADDRESS) / CONFIG_PAGE_SIZE;
+	end = (uint32_t)page + n_pages;
+
+	while ( page < end ) {
+		if ( ((page % 32) == 0) && ((end - page) >= 32) ) {
+			n = 32;
+		} else if ( ((page % 16) == 0) && ((end - page) >= 16) ) {
+			n = 16;
+		} else {
+			n = FLASH_ERASE_MIN_PAGES;
+		}
+
+		ret = flash_erase_block( page, n );
+		if ( ret < 0 ) {
+			return ret;
+		}
+
+		page += n;
+	}
+
+	return 0;
+}
+
+// NOTE: The application partitions are multiples of 16 pages and not all
+// aligned to 32, so this is a mix of 32 and 16 page erases (4 instead of 7 on
+// the V71)
+int flash_erase_partition( uint32_t id )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	return flash_erase_pages( id, 0, ((partition.end - partition.start) / CONFIG_PAGE_SIZE) );
+}
+
+static uint32_t latch_owner_g = 0;
+
+uint32_t flash_latch_claim()
+{
+	if ( ++latch_owner_g == 0 ) {
+		latch_owner_g = 1;
+	}
+
+	return latch_owner_g;
+}
+
+uint32_t flash_latch_owner()
+{
+	return latch_owner_g;
+}
+
+int flash_latch_write( uint32_t offset, uint32_t word )
+{
+	if ( (offset & 0x3) || (offset >= CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	*(volatile uint32_t *)(CONFIG_FLASH_BASE_ADDRESS + offset) = word;
+
+	// NOTE: The write went through the D-cache too; the array still holds the
+	// old contents, so don't leave the line around if the latch is abandoned
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS + offset, sizeof(uint32_t) );
+
+	return 0;
+}
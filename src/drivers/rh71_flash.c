@@ -1,9 +1,11 @@
 
 #include "flash.h"
+#include "cache.h"
 
 #include "config.h"
 
 #include "rh71_pmc.h"
+#include "clock.h"
 
 
 // Register interface
@@ -30,7 +32,7 @@
 #define HEFC_CMD_EPA_ARG_NP_16	HEFC_CMD_EPA_ARG_NP(2) // 16
 #define HEFC_CMD_EPA_ARG_NP_32	HEFC_CMD_EPA_ARG_NP(3) // 32
 
-#define HEFC_CMD_EPA_ARG_SP(sp)	((sp & 0xFFF) << 2) // Start page for page erase
+#define HEFC_CMD_EPA_ARG_SP(sp)	((sp) & 0xFFFC) // Start page (FARG[15:2] = page / 4)
 
 #define HEFC_CMD_EPA_ARG(sp,np)	(HEFC_CMD_EPA_ARG_SP(sp) | HEFC_CMD_EPA_ARG_NP(np))
 
@@ -196,6 +198,14 @@ typedef enum {
 // 	return 0;
 // }
 
+// Write / erase clock (GCLK) divisor from MAINCK to 2 MHz; MAINCK is the RC
+// oscillator unless clock_init() got the crystal going
+#define HEFC_GCLK_HZ	2000000
+#define HEFC_GCLK_DIV(mainck)	(((mainck) + (HEFC_GCLK_HZ / 2)) / HEFC_GCLK_HZ)
+
+_Static_assert( (HEFC_GCLK_DIV( CLOCK_MAINCK_HZ ) >= 1) && (HEFC_GCLK_DIV( CLOCK_MAINCK_HZ ) <= 256), "MAINCK can't be divided down to the HEFC write clock" );
+_Static_assert( (HEFC_GCLK_DIV( CLOCK_RC_HZ ) >= 1) && (HEFC_GCLK_DIV( CLOCK_RC_HZ ) <= 256), "The RC oscillator can't be divided down to the HEFC write clock" );
+
 // -- API ------------------------------------------------------------------- //
 
 // RH71 Flash
@@ -209,7 +219,7 @@ int flash_init()
 {
 	// The write/erase clock is provided by the PMC. It must be configured at 2 MHz and enabled before using the erase / write feature on Flash memory.
 	PMC_PCR = ((1 << 28 /* EN */) | (1 << 12 /* CMD - Write Mode */) | (50 /* PID8 */))
-		| (1 << 29 /* GCLKEN */) | (1 << 8 /* GCLKCSS : MAIN_CLK */) | (1 << 20 /* GCLKDIV */);
+		| (1 << 29 /* GCLKEN */) | (1 << 8 /* GCLKCSS : MAIN_CLK */) | ((HEFC_GCLK_DIV( clock_get_mainck_hz() ) - 1) << 20 /* GCLKDIV */);
 
 	// PMC_PCR_EN_Msk | PMC_PCR_CMD_Msk | PMC_PCR_PID(50)  /* HEFC */
  //        | PMC_PCR_GCLKEN_Msk | PMC_PCR_GCLKCSS_MAIN_CLK | PMC_PCR_GCLKDIV(5);
@@ -217,41 +227,6 @@ int flash_init()
 	return 0;
 }
 
-int flash_erase_range( uint16_t page_start, uint16_t page_end )
-{
-	// TODO: (2) [refactor] @magic Replace "512" with (?) CONFIG value for MAX_PAGE_NO
-	if ( (page_start > 512) || (page_end > 512) ) {
-		return (-1);
-	}
-
-	if ( page_end < page_start ) {
-		return (-1);
-	}
-
-	// TODO: (60) [feature] @nth Be more clever about usage of EP vs EPA for page ranges
-
-	uint32_t fcr = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_EP);
-	uint32_t fsr;
-	
-	for ( ; page_start <= page_end; page_start++ ) {
-		fcr &= ~HEFC_FCR_FARG_MASK; // Clear page argument
-		fcr |= HEFC_FCR_FARG( page_start ); // Set page argument
-
-		// Write command to command register
-		HEFC_FCR = fcr;
-
-		// Wait for erase to complete (HEFC_FSR.FRDY)
-		while ( ! ((fsr = HEFC_FSR) & HEFC_FSR_FRDY) );
-
-		// fsr &= (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR);
-		if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
-			return (-fsr); // Some error occurred during the operation
-		}
-	}
-
-	return 0;
-}
-
 // int flash_erase_app()
 // {
 // 	// TODO: (60) [feature] @nth Check that the page isn't already erased
@@ -333,44 +308,46 @@ static inline uint32_t wait_fsr_frdy() {
 // - => valid page range (for error handling)
 // - flash_offset (e.g. 0x4000)
 
-// NOTE: For now this just erases the first app
-// TODO: A better implementation might check that the page range isn't already erased
-int flash_erase_partition( uint32_t id )
+// Erase 1 page (EP) or 16 / 32 pages (EPA); 'page' is the page number within
+// the flash array and must be aligned to the erase size
+int flash_erase_block( uint32_t page, uint32_t n_pages )
 {
-	// TODO: Check that the page isn't already erased
-	
-	flash_partition_t partition;
-	if ( flash_get_partition( id, &partition ) < 0 ) {
-		return (-1); // Partition not found
-	}
-
-	// NOTE: This could be slightly more efficient if I used a more clever erase algorithm. Instead of doing 7 16-page erases I could do 2 32-page erases and then 3 16-page erases. I would need to compare the erase time - it might be constant time and in that case this improvement wouldn't really matter...
-	// 
-	// 16 pages (8 KB total)
-	// - ARG[15:4] = Page_Number / 16
-	// - FARG[3:2] = 0
-	uint32_t page;
 	uint32_t fsr;
 	uint32_t fcr;
-	for ( page = (partition.start / CONFIG_PAGE_SIZE); page < (partition.end / CONFIG_PAGE_SIZE); page += 16 ) {
-		// Wait for flash to be available
-		wait_fsr_frdy();
-
-		// Construct and issue command
-		fcr = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD)
-			| HEFC_FCR_FCMD(HEFC_CMD_EPA)
-			| HEFC_FCR_FARG( HEFC_CMD_EPA_ARG((page & (~0xF)), HEFC_CMD_EPA_ARG_NP_16 ) );
-		HEFC_FCR = fcr;
-
-		// Wait for command to complete
-		fsr = wait_fsr_frdy();
-
-		// Check that the erase succeeded
-		if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
-			return (-fsr); // Some error occurred during the operation
-		}
+
+	if ( page & (n_pages - 1) ) {
+		return (-1);
+	}
+
+	switch ( n_pages ) {
+		case 1:
+			fcr = HEFC_FCR_FCMD(HEFC_CMD_EP) | HEFC_FCR_FARG( page );
+			break;
+		case 16:
+			fcr = HEFC_FCR_FCMD(HEFC_CMD_EPA) | HEFC_FCR_FARG( HEFC_CMD_EPA_ARG(page, HEFC_CMD_EPA_ARG_NP_16) );
+			break;
+		case 32:
+			fcr = HEFC_FCR_FCMD(HEFC_CMD_EPA) | HEFC_FCR_FARG( HEFC_CMD_EPA_ARG(page, HEFC_CMD_EPA_ARG_NP_32) );
+			break;
+		default:
+			return (-1);
 	}
 
+	// Wait for flash to be available
+	wait_fsr_frdy();
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | fcr;
+
+	// Wait for command to complete
+	fsr = wait_fsr_frdy();
+
+	// Check that the erase succeeded
+	if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS + (page * CONFIG_PAGE_SIZE), n_pages * CONFIG_PAGE_SIZE );
+
 	return 0;
 }
 
@@ -385,7 +362,7 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 
 	// Validate page argument
 	uint32_t page_offset = (page * CONFIG_PAGE_SIZE);
-	if ( page_offset >= partition.end ) {
+	if ( (partition.start + page_offset) >= partition.end ) {
 		return (-2); // Invalid page number
 	}
 
@@ -402,6 +379,8 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 
 	// NOTE: This assumes that the page_buffer pointer passed in aligned to 4-byte boundary
 	// TODO: Enforce alignment / assert alignment
+	flash_latch_claim();
+
 	uint32_t i;
 	volatile uint32_t * app_start_addr = (volatile uint32_t *)(partition.start + page_offset);
 	for ( i = 0; i < CONFIG_PAGE_SIZE; i += 4 ) {
@@ -411,6 +390,22 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 		app_start_addr++;
 	}
 
+	return flash_commit_latch( id, page );
+}
+
+int flash_commit_latch( uint32_t id, uint16_t page )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (partition.start + (page * CONFIG_PAGE_SIZE)) >= partition.end ) {
+		return (-2); // Invalid page number
+	}
+
+	uint32_t address = partition.start + (page * CONFIG_PAGE_SIZE);
+
 	// Synchronize pipeline
 	// TODO: Is the ISB necessary (?)
 	__ISB();
@@ -434,5 +429,184 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 		return (-fsr); // Some error occurred during the operation
 	}
 
+	// Drop the lines the latch fill / the old contents left in the D-cache
+	cache_dcache_invalidate_range( address, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// -- User signature -------------------------------------------------------- //
+
+static inline int __user_signature_args( uint32_t offset, uint32_t len )
+{
+	if ( (offset & 0x3) || (len & 0x3) || ((offset + len) > CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	return 0;
+}
+
+// Everything in here has to be in RAM (or inlined): while the user signature
+// is mapped, reads from the flash array (including instruction fetches) return
+// signature data. The mapping is indicated by FRDY falling after STUS.
+__ramfunc int flash_read_user_signature( uint32_t offset, uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * signature = (volatile uint32_t *)(CONFIG_FLASH_BASE_ADDRESS + offset);
+	uint32_t i;
+
+	if ( (! data) || (offset & 0x3) || (len & 0x3) || ((offset + len) > CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	while ( ! (HEFC_FSR & HEFC_FSR_FRDY) );
+
+	// The lines of the array and of the signature share addresses
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_STUS);
+	while ( HEFC_FSR & HEFC_FSR_FRDY );
+
+	for ( i = 0; i < (len / 4); i++ ) {
+		data[i] = signature[i];
+	}
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_SPUS);
+	while ( ! (HEFC_FSR & HEFC_FSR_FRDY) );
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// The latch buffer is loaded through any address in the flash array (the
+// offset within the page is what matters), then WUS programs it into the
+// user signature
+int flash_program_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * latch = (volatile uint32_t *)(CONFIG_FLASH_BASE_ADDRESS);
+	uint32_t i;
+	uint32_t fsr;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	wait_fsr_frdy();
+
+	for ( i = 0; i < (CONFIG_PAGE_SIZE / 4); i++ ) {
+		if ( (i >= (offset / 4)) && (i < ((offset + len) / 4)) ) {
+			latch[i] = data[i - (offset / 4)];
+		} else {
+			latch[i] = 0xFFFFFFFF;
+		}
+	}
+
+	__ISB();
+	__DSB();
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_WUS);
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_write_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_user_signature( offset, data, len );
+}
+
+int flash_erase_user_signature()
+{
+	uint32_t fsr;
+
+	wait_fsr_frdy();
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_EUS);
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// -- Record block ---------------------------------------------------------- //
+
+#if defined(CONFIG_BOOT_RECORD)
+
+// Page number within the flash array
+#define FLASH_RECORD_PAGE	((FLASH_RECORD_ADDRESS - CONFIG_FLASH_BASE_ADDRESS) / CONFIG_PAGE_SIZE)
+
+int flash_program_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * latch = (volatile uint32_t *)(FLASH_RECORD_ADDRESS);
+	uint32_t i;
+	uint32_t fsr;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	wait_fsr_frdy();
+
+	// Words outside the range are written as FF, which leaves them as they are
+	for ( i = 0; i < (CONFIG_PAGE_SIZE / 4); i++ ) {
+		if ( (i >= (offset / 4)) && (i < ((offset + len) / 4)) ) {
+			latch[i] = data[i - (offset / 4)];
+		} else {
+			latch[i] = 0xFFFFFFFF;
+		}
+	}
+
+	__ISB();
+	__DSB();
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_WP) | HEFC_FCR_FARG( FLASH_RECORD_PAGE );
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( FLASH_RECORD_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_write_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_record( offset, data, len );
+}
+
+int flash_erase_record()
+{
+	uint32_t fsr;
+
+	wait_fsr_frdy();
+
+	HEFC_FCR = HEFC_FCR_FKEY(HEFC_FCR_FKEY_PASSWD) | HEFC_FCR_FCMD(HEFC_CMD_EP) | HEFC_FCR_FARG( FLASH_RECORD_PAGE );
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (HEFC_FSR_FCMDE | HEFC_FSR_FLOCKE | HEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( FLASH_RECORD_ADDRESS, FLASH_RECORD_BLOCK_SIZE );
+
 	return 0;
 }
+
+#endif // defined(CONFIG_BOOT_RECORD)
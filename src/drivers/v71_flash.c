@@ -1,5 +1,6 @@
 
 #include "flash.h"
+#include "cache.h"
 #include "config.h"
 #include "common.h"
 
@@ -26,7 +27,7 @@
 #define EEFC_CMD_EPA_ARG_NP_16	EEFC_CMD_EPA_ARG_NP(2) // 16
 #define EEFC_CMD_EPA_ARG_NP_32	EEFC_CMD_EPA_ARG_NP(3) // 32
 
-#define EEFC_CMD_EPA_ARG_SP(sp)	((sp & 0xFFF) << 2) // Start page for page erase
+#define EEFC_CMD_EPA_ARG_SP(sp)	((sp) & 0xFFFC) // Start page (FARG[15:2] = page / 4)
 
 #define EEFC_CMD_EPA_ARG(sp,np)	(EEFC_CMD_EPA_ARG_SP(sp) | EEFC_CMD_EPA_ARG_NP(np))
 
@@ -248,65 +249,52 @@ static inline uint32_t wait_fsr_frdy() {
 	return fsr;
 }
 
-// NOTE: For now this just erases the first app
-// TODO: A better implementation might check that the page range isn't already erased
-int flash_erase_partition( uint32_t id )
+// Erase 16 or 32 pages with EPA; 'page' is the page number within the flash
+// array and must be aligned to the erase size. The 4 / 8 page variants are
+// only valid in the small sectors (the bootloader), so they aren't offered.
+int flash_erase_block( uint32_t page, uint32_t n_pages )
 {
-	// TODO: Check that the page isn't already erased
+	uint32_t np;
+	uint32_t fsr;
+	uint32_t fcr;
 
-	flash_partition_t partition;
-	if ( flash_get_partition( id, &partition ) < 0 ) {
-		return (-1); // Partition not found
+	switch ( n_pages ) {
+		case 16:
+			np = EEFC_CMD_EPA_ARG_NP_16;
+			break;
+		case 32:
+			np = EEFC_CMD_EPA_ARG_NP_32;
+			break;
+		default:
+			return (-1);
 	}
 
-	// The app is located at 0x00404000 (0x4000) and is 0x1000 bytes (4 KB)
-	// App start sector : 0
-	// App start page   : 32
-	//
-	// So that's a EPA (erase pages) command with (32,2) as the argument
-	// (start page = 32, erase 16 pages (smallest size available for 128 KB
-	// sectors))
+	if ( page & (n_pages - 1) ) {
+		return (-1);
+	}
 
+	// Wait for flash to be available
+	wait_fsr_frdy();
 
-	// NOTE: This could be slightly more efficient if I used a more clever erase algorithm. Instead of doing 7 16-page erases I could do 2 32-page erases and then 3 16-page erases. I would need to compare the erase time - it might be constant time and in that case this improvement wouldn't really matter...
-	// 
-	// 16 pages (8 KB total)
-	// - ARG[15:4] = Page_Number / 16
-	// - FARG[3:2] = 0
-	uint32_t page;
-	uint32_t fsr;
-	uint32_t fcr;
-	for ( page = (partition.start / CONFIG_PAGE_SIZE); page < (partition.end / CONFIG_PAGE_SIZE); page += 16 ) {
-		// Wait for flash to be available
-		wait_fsr_frdy();
-
-		// Construct and issue command
-		fcr = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD)
-			| EEFC_FCR_FCMD(EEFC_CMD_EPA)
-			| EEFC_FCR_FARG( EEFC_CMD_EPA_ARG((page & (~0xF)), EEFC_CMD_EPA_ARG_NP_16 ) );
-		EEFC_FCR = fcr;
-
-		// Wait for command to complete
-		fsr = wait_fsr_frdy();
-
-		// Check that the erase succeeded
-		if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
-			return (-fsr); // Some error occurred during the operation
-		}
+	// Construct and issue command
+	fcr = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD)
+		| EEFC_FCR_FCMD(EEFC_CMD_EPA)
+		| EEFC_FCR_FARG( EEFC_CMD_EPA_ARG(page, np) );
+	EEFC_FCR = fcr;
+
+	// Wait for command to complete
+	fsr = wait_fsr_frdy();
+
+	// Check that the erase succeeded
+	if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
 	}
 
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS + (page * CONFIG_PAGE_SIZE), n_pages * CONFIG_PAGE_SIZE );
+
 	return 0;
 }
 
-// int flash_erase_range( uint16_t page_start, uint16_t page_end )
-// {
-// 	(void)page_start;
-// 	(void)page_end;
-
-// 	// NOT IMPLEMENTED
-// 	return (-1);
-// }
-
 // int write_page_buffer( frame_t * frame, uint8_t * page_buffer );
 // Must be a full page
 int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
@@ -318,7 +306,7 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 
 	// Validate page argument
 	uint32_t page_offset = (page * CONFIG_PAGE_SIZE);
-	if ( page_offset >= partition.end ) {
+	if ( (partition.start + page_offset) >= partition.end ) {
 		return (-2); // Invalid page number
 	}
 
@@ -348,6 +336,8 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 	// NOTE: This assumes that the page_buffer pointer passed in aligned to 4-byte boundary
 	// TODO: Enforce alignment / assert alignment
 	// TODO: (2) [refactor] @magic Replace 0x4000 with constant for app offset (in bytes)
+	flash_latch_claim();
+
 	uint32_t i;
 	volatile uint32_t * app_start_addr = (volatile uint32_t *)(partition.start + page_offset);
 	for ( i = 0; i < CONFIG_PAGE_SIZE; i += 4 ) {
@@ -357,14 +347,30 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 		app_start_addr++;
 	}
 
+	return flash_commit_latch( id, page );
+}
+
+int flash_commit_latch( uint32_t id, uint16_t page )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (partition.start + (page * CONFIG_PAGE_SIZE)) >= partition.end ) {
+		return (-2); // Invalid page number
+	}
+
+	uint32_t address = partition.start + (page * CONFIG_PAGE_SIZE);
+
 	// Synchronize pipeline
 	__ISB();
 	__DSB();
 
-	// Commit page
-	// TODO: (2) [refactor] @magic Replace 2 with constant for app offset (in pages)
+	// Commit page (FARG is the page number within the flash array)
+	page += (partition.start - CONFIG_FLASH_BASE_ADDRESS) / CONFIG_PAGE_SIZE;
 	uint32_t fcr = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_WP);
-	fcr |= EEFC_FCR_FARG( (32 + page) ); // 
+	fcr |= EEFC_FCR_FARG( page );
 
 	// Write command to command register
 	EEFC_FCR = fcr;
@@ -376,5 +382,187 @@ int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
 		return (-fsr); // Some error occurred during the operation
 	}
 
+	// Drop the lines the latch fill / the old contents left in the D-cache
+	cache_dcache_invalidate_range( address, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// -- User signature -------------------------------------------------------- //
+
+static inline int __user_signature_args( uint32_t offset, uint32_t len )
+{
+	if ( (offset & 0x3) || (len & 0x3) || ((offset + len) > CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
 	return 0;
 }
+
+// Everything in here has to be in RAM (or inlined): while the user signature
+// is mapped, reads from the flash array (including instruction fetches) return
+// signature data. The mapping is indicated by FRDY falling after STUS.
+__ramfunc int flash_read_user_signature( uint32_t offset, uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * signature = (volatile uint32_t *)(CONFIG_FLASH_BASE_ADDRESS + offset);
+	uint32_t i;
+
+	if ( (! data) || (offset & 0x3) || (len & 0x3) || ((offset + len) > CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	while ( ! (EEFC_FSR & EEFC_FSR_FRDY) );
+
+	// The lines of the array and of the signature share addresses
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_STUS);
+	while ( EEFC_FSR & EEFC_FSR_FRDY );
+
+	for ( i = 0; i < (len / 4); i++ ) {
+		data[i] = signature[i];
+	}
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_SPUS);
+	while ( ! (EEFC_FSR & EEFC_FSR_FRDY) );
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// The latch buffer is loaded through any address in the flash array (the
+// offset within the page is what matters), then WUS programs it into the
+// user signature
+int flash_program_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * latch = (volatile uint32_t *)(CONFIG_FLASH_BASE_ADDRESS);
+	uint32_t i;
+	uint32_t fsr;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	wait_fsr_frdy();
+
+	for ( i = 0; i < (CONFIG_PAGE_SIZE / 4); i++ ) {
+		if ( (i >= (offset / 4)) && (i < ((offset + len) / 4)) ) {
+			latch[i] = data[i - (offset / 4)];
+		} else {
+			latch[i] = 0xFFFFFFFF;
+		}
+	}
+
+	__ISB();
+	__DSB();
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_WUS);
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_write_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_user_signature( offset, data, len );
+}
+
+int flash_erase_user_signature()
+{
+	uint32_t fsr;
+
+	wait_fsr_frdy();
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_EUS);
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( CONFIG_FLASH_BASE_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+// -- Record block ---------------------------------------------------------- //
+
+#if defined(CONFIG_BOOT_RECORD)
+
+_Static_assert( (FLASH_RECORD_ADDRESS - CONFIG_FLASH_BASE_ADDRESS) < (16 * 1024), "The record block has to be in the small sectors (4 page EPA)" );
+
+// Page number within the flash array
+#define FLASH_RECORD_PAGE	((FLASH_RECORD_ADDRESS - CONFIG_FLASH_BASE_ADDRESS) / CONFIG_PAGE_SIZE)
+
+int flash_program_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	volatile uint32_t * latch = (volatile uint32_t *)(FLASH_RECORD_ADDRESS);
+	uint32_t i;
+	uint32_t fsr;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	wait_fsr_frdy();
+
+	// Words outside the range are written as FF, which leaves them as they are
+	for ( i = 0; i < (CONFIG_PAGE_SIZE / 4); i++ ) {
+		if ( (i >= (offset / 4)) && (i < ((offset + len) / 4)) ) {
+			latch[i] = data[i - (offset / 4)];
+		} else {
+			latch[i] = 0xFFFFFFFF;
+		}
+	}
+
+	__ISB();
+	__DSB();
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_WP) | EEFC_FCR_FARG( FLASH_RECORD_PAGE );
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( FLASH_RECORD_ADDRESS, CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_write_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_record( offset, data, len );
+}
+
+int flash_erase_record()
+{
+	uint32_t fsr;
+
+	wait_fsr_frdy();
+
+	EEFC_FCR = EEFC_FCR_FKEY(EEFC_FCR_FKEY_PASSWD) | EEFC_FCR_FCMD(EEFC_CMD_EPA)
+		| EEFC_FCR_FARG( EEFC_CMD_EPA_ARG(FLASH_RECORD_PAGE, EEFC_CMD_EPA_ARG_NP_4) );
+	fsr = wait_fsr_frdy();
+
+	if ( fsr & (EEFC_FSR_FCMDE | EEFC_FSR_FLOCKE | EEFC_FSR_FLERR) ) {
+		return (-fsr); // Some error occurred during the operation
+	}
+
+	cache_dcache_invalidate_range( FLASH_RECORD_ADDRESS, FLASH_RECORD_BLOCK_SIZE );
+
+	return 0;
+}
+
+#endif // defined(CONFIG_BOOT_RECORD)
@@ -0,0 +1,239 @@
+
+#include "clock.h"
+#include "config.h"
+#include "common.h"
+
+#include <stdbool.h>
+
+#if defined(CONFIG_SOC_SERIES_SAMV71)
+	// -- V71 -- //
+	#define PMC_BASE	0x400E0600
+	#define FLASH_FMR	MMIO32(0x400E0C00) // EEFC_FMR
+
+	// Flash access time: one wait state per 23 MHz of MCK (VDDIO 3.3 V)
+	#define CLOCK_FLASH_HZ_PER_WS	23000000
+
+	// -- V71 -- //
+#elif defined(CONFIG_SOC_SERIES_SAMRH71)
+	// -- RH71 -- //
+	#include "rh71_pmc.h"
+
+	#define FLASH_FMR	MMIO32(0x40004000) // HEFC_FMR
+
+	// NOTE: Conservative; the HEFC reads need fewer wait states at the rated
+	// temperature range
+	#define CLOCK_FLASH_HZ_PER_WS	20000000
+
+	// -- RH71 -- //
+#endif // CONFIG_SOC_SERIES_*
+
+#define CKGR_MOR	MMIO32((PMC_BASE) + 0x20)
+#define CKGR_PLLAR	MMIO32((PMC_BASE) + 0x28)
+#define PMC_MCKR	MMIO32((PMC_BASE) + 0x30)
+#define PMC_SR		MMIO32((PMC_BASE) + 0x68)
+
+// CKGR_MOR
+#define CKGR_MOR_KEY_PASSWD	(0x37 << 16)
+#define CKGR_MOR_KEY_MASK	(0xFF << 16)
+#define CKGR_MOR_MOSCXTEN	(1 << 0)
+#define CKGR_MOR_MOSCRCEN	(1 << 3)
+#define CKGR_MOR_MOSCXTST(n)	(((n) & 0xFF) << 8)	// Crystal start-up time, 8 slow clock cycles per count
+#define CKGR_MOR_MOSCSEL	(1 << 24)
+
+// CKGR_PLLAR
+#define CKGR_PLLAR_ONE		(1 << 29)
+#define CKGR_PLLAR_MULA(n)	(((n) & 0x7FF) << 16)	// Multiplier - 1; 0 disables the PLL
+#define CKGR_PLLAR_COUNT(n)	(((n) & 0x3F) << 8)	// Lock time, slow clock cycles
+#define CKGR_PLLAR_DIVA(n)	((n) & 0xFF)
+
+// PMC_MCKR
+#define PMC_MCKR_CSS_MASK	(0x3 << 0)
+#define PMC_MCKR_CSS_MAIN	(1 << 0)
+#define PMC_MCKR_CSS_PLLA	(2 << 0)
+#define PMC_MCKR_PRES_MASK	(0x7 << 4)
+#define PMC_MCKR_MDIV_MASK	(0x3 << 8)
+
+// PMC_SR
+#define PMC_SR_MOSCXTS		(1 << 0)
+#define PMC_SR_LOCKA		(1 << 1)
+#define PMC_SR_MCKRDY		(1 << 3)
+#define PMC_SR_MOSCSELS		(1 << 16)
+
+// EEFC_FMR / HEFC_FMR
+#define FLASH_FMR_FWS_MASK	(0xF << 8)
+#define FLASH_FMR_FWS(n)	(((n) & 0xF) << 8)
+
+#if defined(CONFIG_CLOCK_PLL)
+
+// Polls before a start-up / lock is given up on; the slowest (crystal
+// start-up, 62 * 8 slow clock cycles = ~15 ms) is far inside this on the RC
+#define CLOCK_TIMEOUT	1000000
+
+static uint32_t reset_fmr_g;
+static uint32_t reset_mor_g;
+static bool pll_g = false;
+
+static int __wait_sr( uint32_t mask, uint32_t value )
+{
+	uint32_t i;
+
+	for ( i = 0; i < CLOCK_TIMEOUT; i++ ) {
+		if ( (PMC_SR & mask) == value ) {
+			return 0;
+		}
+	}
+
+	return (-1);
+}
+
+static void __set_mckr( uint32_t mask, uint32_t value )
+{
+	PMC_MCKR = (PMC_MCKR & ~mask) | value;
+	__wait_sr( PMC_SR_MCKRDY, PMC_SR_MCKRDY );
+}
+
+static inline void __set_fws( uint32_t fws )
+{
+	FLASH_FMR = (FLASH_FMR & ~FLASH_FMR_FWS_MASK) | FLASH_FMR_FWS(fws);
+}
+
+_Static_assert( ((uint64_t)CONFIG_CLOCK_XTAL_HZ * CONFIG_CLOCK_PLL_MUL) / CONFIG_CLOCK_PLL_DIV == CONFIG_SYS_CLOCK_HZ,
+	"CONFIG_SYS_CLOCK_HZ has to be CONFIG_CLOCK_XTAL_HZ * CONFIG_CLOCK_PLL_MUL / CONFIG_CLOCK_PLL_DIV" );
+
+// MDIV: 0 = /1, 1 = /2, 2 = /4, 3 = /3
+#if (CONFIG_CLOCK_MCK_DIV == 1)
+	#define PMC_MCKR_MDIV	(0 << 8)
+#elif (CONFIG_CLOCK_MCK_DIV == 2)
+	#define PMC_MCKR_MDIV	(1 << 8)
+#elif (CONFIG_CLOCK_MCK_DIV == 3)
+	#define PMC_MCKR_MDIV	(3 << 8)
+#elif (CONFIG_CLOCK_MCK_DIV == 4)
+	#define PMC_MCKR_MDIV	(2 << 8)
+#else
+	#error "CONFIG_CLOCK_MCK_DIV has to be 1, 2, 3 or 4"
+#endif // CONFIG_CLOCK_MCK_DIV
+
+#define CLOCK_FWS	((CLOCK_MCK_HZ - 1) / CLOCK_FLASH_HZ_PER_WS)
+
+_Static_assert( CLOCK_FWS <= 0xF, "MCK too fast for the flash" );
+
+int clock_init()
+{
+	reset_fmr_g = FLASH_FMR;
+	reset_mor_g = CKGR_MOR & ~CKGR_MOR_KEY_MASK;
+
+	// Wait states for the target clock first; too many is only slow
+	__set_fws( CLOCK_FWS );
+
+	// Start the crystal (next to the RC oscillator, which stays on until the
+	// switch has happened)
+	CKGR_MOR = CKGR_MOR_KEY_PASSWD | reset_mor_g | CKGR_MOR_MOSCRCEN
+		| CKGR_MOR_MOSCXTST(62) | CKGR_MOR_MOSCXTEN;
+	if ( __wait_sr( PMC_SR_MOSCXTS, PMC_SR_MOSCXTS ) < 0 ) {
+		clock_deinit();
+		return (-1);
+	}
+
+	// MAINCK = crystal
+	CKGR_MOR |= CKGR_MOR_KEY_PASSWD | CKGR_MOR_MOSCSEL;
+	if ( __wait_sr( PMC_SR_MOSCSELS, PMC_SR_MOSCSELS ) < 0 ) {
+		clock_deinit();
+		return (-1);
+	}
+
+	// NOTE: MCKR is still on MAINCK at this point, so the core is already on
+	// the crystal; the PLL is only selected once it has locked
+	CKGR_PLLAR = CKGR_PLLAR_ONE | CKGR_PLLAR_MULA(CONFIG_CLOCK_PLL_MUL - 1)
+		| CKGR_PLLAR_COUNT(0x3F) | CKGR_PLLAR_DIVA(CONFIG_CLOCK_PLL_DIV);
+	if ( __wait_sr( PMC_SR_LOCKA, PMC_SR_LOCKA ) < 0 ) {
+		clock_deinit();
+		return (-1);
+	}
+
+	pll_g = true;
+
+	// Divider before source, so MCK never runs above its limit
+	__set_mckr( PMC_MCKR_CSS_MASK | PMC_MCKR_PRES_MASK, PMC_MCKR_CSS_MAIN );
+	__set_mckr( PMC_MCKR_MDIV_MASK, PMC_MCKR_MDIV );
+	__set_mckr( PMC_MCKR_CSS_MASK, PMC_MCKR_CSS_PLLA );
+
+	return 0;
+}
+
+void clock_deinit()
+{
+	if ( pll_g ) {
+		// Source before divider, the reverse of clock_init()
+		__set_mckr( PMC_MCKR_CSS_MASK, PMC_MCKR_CSS_MAIN );
+		__set_mckr( PMC_MCKR_MDIV_MASK | PMC_MCKR_PRES_MASK, 0 );
+		pll_g = false;
+	}
+
+	// Back to the RC oscillator, then stop the PLL and the crystal
+	CKGR_MOR = CKGR_MOR_KEY_PASSWD | (CKGR_MOR & ~(CKGR_MOR_KEY_MASK | CKGR_MOR_MOSCSEL)) | CKGR_MOR_MOSCRCEN;
+	__wait_sr( PMC_SR_MOSCSELS, PMC_SR_MOSCSELS );
+
+	CKGR_PLLAR = CKGR_PLLAR_ONE | CKGR_PLLAR_MULA(0);
+	CKGR_MOR = CKGR_MOR_KEY_PASSWD | reset_mor_g;
+
+	// Only now that the core is back on the RC oscillator
+	__set_fws( (reset_fmr_g & FLASH_FMR_FWS_MASK) >> 8 );
+}
+
+uint32_t clock_get_core_hz()
+{
+	return pll_g ? CONFIG_SYS_CLOCK_HZ : CLOCK_RC_HZ;
+}
+
+uint32_t clock_get_mck_hz()
+{
+	return pll_g ? CLOCK_MCK_HZ : CLOCK_RC_HZ;
+}
+
+uint32_t clock_get_mainck_hz()
+{
+	return pll_g ? CLOCK_MAINCK_HZ : CLOCK_RC_HZ;
+}
+
+uint32_t clock_get_usart_cd( uint32_t baud )
+{
+	if ( pll_g ) {
+		return CLOCK_USART_CD( baud );
+	}
+
+	return ((CLOCK_RC_USART_CD * CLOCK_RC_USART_BAUD) + (baud / 2)) / baud;
+}
+
+#else
+
+int clock_init()
+{
+	return 0;
+}
+
+void clock_deinit()
+{
+	// Never left the reset clock tree
+}
+
+uint32_t clock_get_core_hz()
+{
+	return CONFIG_SYS_CLOCK_HZ;
+}
+
+uint32_t clock_get_mck_hz()
+{
+	return CONFIG_SYS_CLOCK_HZ;
+}
+
+uint32_t clock_get_mainck_hz()
+{
+	return CONFIG_SYS_CLOCK_HZ;
+}
+
+uint32_t clock_get_usart_cd( uint32_t baud )
+{
+	return ((CLOCK_RC_USART_CD * CLOCK_RC_USART_BAUD) + (baud / 2)) / baud;
+}
+
+#endif // defined(CONFIG_CLOCK_PLL)
@@ -2,6 +2,7 @@
 #include "usart.h"
 #include "config.h"
 #include "common.h"
+#include "clock.h"
 
 #include <stddef.h>
 
@@ -13,6 +14,15 @@
 #define USART_THR_OFFSET	0x1C
 #define USART_BRGR_OFFSET	0x20
 
+// USART_CR
+#define USART_CR_RSTSTA		(1 << 8)
+
+// USART_CSR
+#define USART_CSR_RXRDY		(1 << 0)
+#define USART_CSR_TXEMPTY	(1 << 9)
+#define USART_CSR_OVRE		(1 << 5)
+#define USART_CSR_FRAME		(1 << 6)
+
 static inline uint32_t __usart_getreg( volatile uint32_t base, uint32_t offset )
 {
 	return (*(volatile uint32_t *)(base + offset));
@@ -59,7 +69,6 @@ typedef struct usart_config_t {
 	#define MATRIX_BASE	0x40088000
 	#define CCFG_SYSIO	MMIO32((MATRIX_BASE) + 0x114)
 
-	#define USART_FIXED_BAUD	(20 & 0xFFFF) // 38400 at 12 MHz
 	#define USART_N_PERIPH		10
 
 	static usart_config_t usart0_cfg_g = {
@@ -145,7 +154,6 @@ typedef struct usart_config_t {
 	#define FLEXCOM1_BASE	0x40014000
 	#define USART1_BASE (FLEXCOM1_BASE + FLEXCOM_USART_BASE_OFFSET) // FLEXCOM1 USART registers
 
-	#define USART_FIXED_BAUD	(14 & 0xFFFF) // 19200 at ~4 MHz
 	#define USART_N_PERIPH		10
 
 	static usart_config_t usart0_cfg_g = {
@@ -236,6 +244,12 @@ typedef struct usart_config_t {
 	// -- RH71 -- //
 #endif // CONFIG_SOC_SERIES_*
 
+#if defined(CONFIG_CLOCK_PLL)
+	_Static_assert( CLOCK_USART_CD( CONFIG_USART_BAUD ) > 0, "CONFIG_USART_BAUD too high for MCK" );
+#endif // defined(CONFIG_CLOCK_PLL)
+_Static_assert( ((CLOCK_RC_USART_CD * CLOCK_RC_USART_BAUD) + (CONFIG_USART_BAUD / 2)) / CONFIG_USART_BAUD > 0,
+	"CONFIG_USART_BAUD too high for the RC oscillator" );
+
 int __usart_init( usart_config_t * usart )
 {
 	if ( ! usart ) {
@@ -246,8 +260,8 @@ int __usart_init( usart_config_t * usart )
 
 	// -- Configure USART peripheral -- //
 	
-	// Baud rate
-	__usart_setreg( usart->regbase, USART_BRGR_OFFSET, USART_FIXED_BAUD );
+	// Baud rate (for the clock actually running; see clock_init())
+	__usart_setreg( usart->regbase, USART_BRGR_OFFSET, clock_get_usart_cd( CONFIG_USART_BAUD ) & 0xFFFF );
 
 	// No parity, 8 bit payload
 	__usart_setreg( usart->regbase, USART_MR_OFFSET, (4 << 9 /* PAR[2:0] bits 11:9, 4 = no parity */)
@@ -325,16 +339,23 @@ int usart_read( uint32_t usart_no, uint8_t * data, uint32_t flags )
 		return (-1);
 	}
 
-	// NOTE: Ignoring OVRE for now - it will set when a character is received and RXRDY is already set; it overwrites the previous value
-
 	uint32_t csr = __usart_getreg( usart->regbase, USART_CSR_OFFSET );
 
+	// OVRE sets when a character is received while RXRDY is already set (the
+	// previous character is overwritten); FRAME sets on a missing stop bit. Both
+	// are sticky until RSTSTA, so report the error once and clear it. RXRDY is
+	// left alone; the pending character is returned by the next call.
+	if ( csr & (USART_CSR_OVRE | USART_CSR_FRAME) ) {
+		__usart_setreg( usart->regbase, USART_CR_OFFSET, USART_CR_RSTSTA );
+		return (csr & USART_CSR_OVRE) ? USART_E_OVERRUN : USART_E_FRAMING;
+	}
+
 	if ( flags & USART_FLAGS_NONBLOCK ) {
-		if ( ! (csr & ( 1 << 0 /* RXRDY */)) ) {
+		if ( ! (csr & USART_CSR_RXRDY) ) {
 			return 0;
 		}
 	} else {
-		while ( ! (csr & ( 1 << 0 /* RXRDY */)) ) {
+		while ( ! (csr & USART_CSR_RXRDY) ) {
 			// csr = USART1_CSR;
 			csr = __usart_getreg( usart->regbase, USART_CSR_OFFSET );
 			// if ( csr  & (1 << 5 /* OVRE */) ) {
@@ -348,3 +369,15 @@ int usart_read( uint32_t usart_no, uint8_t * data, uint32_t flags )
 
 	return 1;
 }
+
+int usart_flush( uint32_t usart_no )
+{
+	usart_config_t * usart = __get_usart_struct( usart_no );
+	if ( ! usart ) {
+		return (-1);
+	}
+
+	while ( ! (__usart_getreg( usart->regbase, USART_CSR_OFFSET ) & USART_CSR_TXEMPTY) );
+
+	return 0;
+}
@@ -0,0 +1,95 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef BL_API_H
+#define BL_API_H
+
+#include <stdint.h>
+
+// Bootloader API table
+//
+// A versioned table of bootloader routines the running application can call
+// instead of carrying its own CRC-32 and flash code: CRC-32, partition lookup,
+// page programming and the erase planner (fewest erase commands for a range).
+// With them the application can stage an update in the other slot while it
+// keeps running. Version 2 adds the boot record requests: make the staged slot
+// the active one and confirm the boot.
+//
+// The table sits in the last BL_API_SIZE bytes of the bootloader's flash
+// (CONFIG_BOOTLOADER_SIZE), i.e. right before APP_1: 0x00403FC0 (V71) /
+// 0x10003FC0 (RH71) with the default 16 KB. This header doesn't depend on the
+// bootloader's configuration and can be copied into the application as is.
+//
+// The routines run in the caller's context (its stack, its interrupts) and
+// never touch the bootloader's RAM, which belongs to the application by then:
+// the partition table is const, the CRC is the byte-wise table kernel and
+// pages are programmed straight from the caller's buffer. Check 'magic' and
+// 'version' before use; entries are only ever appended, 'size' covers the
+// ones this bootloader has.
+//
+// NOTE: Nothing stops the application from erasing the slot it's running
+// from; that's up to the caller. The boot record can't be rewritten from here
+// (that takes the bootloader's RAM); activate / confirm only program lines of
+// it (boot_record.h), which costs no erase.
+
+#define BL_API_SIZE		64
+
+#define BL_API_MAGIC	0x49504142 // "BAPI"
+#define BL_API_VERSION	2
+
+// Address of the table for a bootloader of 'bootloader_size' bytes at 'flash_base'
+#define BL_API_ADDRESS(flash_base, bootloader_size)	((flash_base) + (bootloader_size) - BL_API_SIZE)
+
+typedef struct {
+	uint32_t start;	// First byte of the partition (absolute address)
+	uint32_t end;	// One past the last byte
+} bl_api_partition_t;
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;				// sizeof(bl_api_t)
+	uint32_t page_size;			// Flash page size in bytes
+	uint32_t erase_min_pages;	// Erase granularity in pages (FLASH_ERASE_MIN_PAGES)
+
+	// CRC-32 (IEEE); start from 0xFFFFFFFF and XOR the result with 0xFFFFFFFF
+	uint32_t (*crc_32_update)( uint32_t crc, const uint8_t * data, uint32_t len );
+
+	// Partition 'id' (0 = APP_1, 1 = APP_2); 0 or (-1) if there's no such partition
+	int (*get_partition)( uint32_t id, bl_api_partition_t * partition );
+
+	// Erase 'n_pages' pages of partition 'id' from 'page' (both multiples of
+	// 'erase_min_pages') with the fewest erase commands. Returns 0, (-1) for an
+	// unknown partition, (-2) for an invalid range or a flash error code.
+	int (*erase_pages)( uint32_t id, uint32_t page, uint32_t n_pages );
+
+	// Program page 'page' of partition 'id' with 'page_size' bytes from 'data'
+	// (any alignment); the page has to be erased. Returns 0, (-1) for an
+	// unknown partition, (-2) for an invalid page or a flash error code.
+	int (*write_page)( uint32_t id, const uint8_t * data, uint32_t page );
+
+	// -- Version 2 -- //
+
+	// Make partition 'id' the active slot at the next reset, holding an image
+	// of 'length' bytes with CRC-32 'crc' (bl_setActiveApp's arguments). The
+	// bootloader checks the image first and ignores the request if it doesn't
+	// match. Returns 0, (-1) for invalid arguments or a bootloader without a
+	// boot record, (-2) if there's already a request since the last reset or a
+	// flash error code.
+	int (*activate)( uint32_t id, uint32_t length, uint32_t crc );
+
+	// The application came up; confirm the boots counted so far (programs a
+	// line of the boot record, nothing if they're already confirmed). The
+	// record is erased once every CONFIG_BOOT_LOG_LINES boots either way.
+	// Returns 0 (also when the bootloader doesn't count boots) or a flash
+	// error code.
+	int (*confirm)( void );
+} bl_api_t;
+
+#endif // BL_API_H
+
+#ifdef __cplusplus
+}
+#endif
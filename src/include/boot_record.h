@@ -0,0 +1,221 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef BOOT_RECORD_H
+#define BOOT_RECORD_H
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Persistent boot record
+//
+// Lives in the flash (see below) and holds the active application slot,
+// the length and CRC-32 of the image in each slot, a "verified" mark per slot
+// and a boot-attempt counter. A slot's image is only hashed when its verified
+// mark isn't set, i.e. once after it changes, so a normal boot costs a read of
+// the record rather than a CRC of the slot.
+//
+// The record is laid out in 16-byte lines. The marks (verified, the boot log)
+// each get their own line and are only ever programmed once between erases
+// (programming clears bits; an erased mark reads FF). Any other change
+// rewrites the whole record.
+//
+// There are two copies: one in the user signature and one in the record block
+// (flash.h). A rewrite erases and programs the copy that wasn't read / written
+// last, with the next sequence number and a CRC-32 of everything up to the
+// marks, so a reset in the middle of it leaves the previous copy in place.
+// boot_record_init() goes by the valid copy with the higher sequence number;
+// marks are programmed into that one.
+//
+// With CONFIG_BOOT_ATTEMPTS, boots of the active slot are logged: a line is
+// marked in 'attempts' just before the jump, and a confirmation (by the host or
+// the application) marks the next line in 'confirmed' with the number of boots
+// logged so far. Boots past the last confirmation are unconfirmed; once
+// CONFIG_BOOT_MAX_ATTEMPTS of them pile up, boot_record_select() falls back to
+// the other slot. Only when the log is full is the record rewritten with the
+// unconfirmed boots carried over, so a confirmed boot costs two programmed
+// lines per copy and an erase of both copies every CONFIG_BOOT_LOG_LINES boots.
+// Without CONFIG_BOOT_ATTEMPTS nothing is counted, since an application that
+// never confirms would otherwise be abandoned.
+//
+// The running application can't rewrite the record (it needs the bootloader's
+// RAM) or read the user signature, so the lines it programs (the boot log and
+// an activate request, through the bootloader API, bl_api.h) are kept the same
+// in both copies: it reads the record block and programs both. The bootloader
+// marks the boot log in both copies too, and boot_record_init() rewrites a copy
+// whose lines are out of step (e.g. after a reset part way through). An
+// activation is applied at the next reset, after checking the image (it's
+// dropped if the image doesn't match), and rewrites both copies; until then a
+// reset applies it again.
+//
+// The rest of the record holds the upload session: the slot being
+// uploaded, the image length / CRC and the number of pages committed in order
+// from page 0. Progress is checkpointed every CONFIG_UPLOAD_CHECKPOINT_PAGES
+// pages into the next free progress line (programmed once, like the marks);
+// when they run out the record is rewritten with the count in the session line.
+// After a reset the upload resumes from the last checkpoint.
+//
+// Without CONFIG_BOOT_RECORD there's never a record; the functions report that
+// and boot selection falls back to the fixed CONFIG_FAST_BOOT_PARTITION.
+
+#define BOOT_RECORD_MAGIC		0x42464C4F // "OLFB"
+#define BOOT_RECORD_VERSION		3
+
+#define BOOT_RECORD_N_SLOTS		2
+
+#if defined(CONFIG_BOOT_MAX_ATTEMPTS)
+	#define BOOT_RECORD_MAX_ATTEMPTS	CONFIG_BOOT_MAX_ATTEMPTS
+#else
+	#define BOOT_RECORD_MAX_ATTEMPTS	1
+#endif // defined(CONFIG_BOOT_MAX_ATTEMPTS)
+
+#if defined(CONFIG_BOOT_LOG_LINES)
+	#define BOOT_RECORD_LOG_LINES	CONFIG_BOOT_LOG_LINES
+#else
+	#define BOOT_RECORD_LOG_LINES	1
+#endif // defined(CONFIG_BOOT_LOG_LINES)
+
+#if defined(CONFIG_UPLOAD_CHECKPOINT_PAGES)
+	#define BOOT_RECORD_CHECKPOINT_PAGES	CONFIG_UPLOAD_CHECKPOINT_PAGES
+#else
+	#define BOOT_RECORD_CHECKPOINT_PAGES	1
+#endif // defined(CONFIG_UPLOAD_CHECKPOINT_PAGES)
+
+#define BOOT_RECORD_MARK_SET	0x00000000
+#define BOOT_RECORD_ERASED		0xFFFFFFFF
+
+// boot_record_request_t.request
+#define BOOT_RECORD_REQUEST_ACTIVATE	0x56544341 // "ACTV"
+
+#define BOOT_RECORD_LINE_LEN	16
+
+// Header, active slot, slots, session, verified marks, the activate request and
+// the boot log
+#define BOOT_RECORD_FIXED_LINES	(2 + BOOT_RECORD_N_SLOTS + 1 + BOOT_RECORD_N_SLOTS + 1 + (2 * BOOT_RECORD_LOG_LINES))
+
+// Whatever is left of the page
+#define BOOT_RECORD_PROGRESS_LINES	((CONFIG_PAGE_SIZE / BOOT_RECORD_LINE_LEN) - BOOT_RECORD_FIXED_LINES)
+
+typedef struct {
+	uint32_t mark;
+	uint32_t reserved[3];
+} boot_record_mark_t;
+
+typedef struct {
+	uint32_t length;	// Image length in bytes; FF if the slot isn't described
+	uint32_t crc;		// CRC-32 of the first 'length' bytes of the slot
+	uint32_t reserved[2];
+} boot_record_slot_t;
+
+typedef struct {
+	uint32_t slot;		// Partition id being uploaded; FF if there's no session
+	uint32_t length;	// Image length in bytes
+	uint32_t crc;		// CRC-32 of the image
+	uint32_t committed;	// Pages committed (in order from page 0)
+} boot_record_session_t;
+
+// Left by the application (see above); FF until it makes one
+typedef struct {
+	uint32_t request;	// BOOT_RECORD_REQUEST_ACTIVATE
+	uint32_t slot;		// Partition id, image length and CRC-32
+	uint32_t length;
+	uint32_t crc;
+} boot_record_request_t;
+
+// NOTE: Everything before 'verified' only changes with a rewrite and is covered
+// by 'crc'; the marks from 'verified' on are programmed in place
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t sequence;	// One up on every rewrite; the higher of two valid copies wins
+	uint32_t crc;		// CRC-32 of the record up to 'verified', without this word
+	uint32_t active;	// Partition id to boot; FF if no slot has been made active yet
+	uint32_t reserved[3];
+	boot_record_slot_t slot[BOOT_RECORD_N_SLOTS];
+	boot_record_session_t session;
+	boot_record_mark_t verified[BOOT_RECORD_N_SLOTS];
+	boot_record_request_t activate;	// Only programmed by the application
+	boot_record_mark_t attempts[BOOT_RECORD_LOG_LINES];		// Boot log (the same in both copies)
+	boot_record_mark_t confirmed[BOOT_RECORD_LOG_LINES];	// mark = boots logged when confirmed
+	boot_record_mark_t progress[BOOT_RECORD_PROGRESS_LINES]; // mark = pages committed
+} boot_record_t;
+
+// Read both copies of the record and keep the newer valid one, then apply the
+// application's activate request; returns 0 if a valid record was found, (-1)
+// otherwise (the record is then treated as empty)
+int boot_record_init();
+
+bool boot_record_valid();
+
+// Returns the active partition id or (-1) if there's no record
+int boot_record_get_active();
+
+// Number of unconfirmed boots of the active slot
+uint32_t boot_record_get_attempts();
+
+// Count the boot log of 'record': returns the boots logged and sets
+// '*confirmed' to how many of them are confirmed and '*next' to the first free
+// line of 'confirmed' (either may be NULL). Only reads 'record'; the
+// bootloader API uses it on the record block.
+uint32_t boot_record_log_count( const boot_record_t * record, uint32_t * confirmed, uint32_t * next );
+
+// Copy the cached record (e.g. for reporting)
+void boot_record_get( boot_record_t * record );
+
+// Make partition 'id' the active slot holding an image of 'length' bytes with
+// CRC-32 'crc'. The image is checked first; returns (-1) on invalid arguments,
+// (-2) if the slot doesn't match or a flash error code. Clears the boot
+// attempts, marks the slot verified and ends an upload session to the slot.
+int boot_record_set_active( uint32_t id, uint32_t length, uint32_t crc );
+
+// Forget the image in partition 'id' (it's been erased / is being rewritten);
+// only touches the flash if the record describes the slot
+int boot_record_invalidate( uint32_t id );
+
+// Check partition 'id' against the record: 0 if the image matches (marks the
+// slot verified the first time), (-1) if the record doesn't describe the slot,
+// (-2) if the image doesn't match
+int boot_record_check( uint32_t id );
+
+// Boot policy: pick the partition to boot. The active slot is used unless its
+// attempts are used up or it fails boot_record_check(), in which case the other
+// slot is tried. Returns 0 and sets 'id', or (-1) if neither slot is bootable.
+// Without an active slot 'id' is left as passed in and 0 is returned, unless an
+// upload to it is still open ((-1)).
+int boot_record_select( uint32_t * id );
+
+// Count a boot attempt of partition 'id' (only the active slot is counted, and
+// only with CONFIG_BOOT_ATTEMPTS)
+int boot_record_attempt( uint32_t id );
+
+// The application came up; confirm the boots logged so far (programs a line of
+// each copy, nothing if there's nothing to confirm)
+int boot_record_confirm();
+
+// -- Upload session -- //
+
+// Start an upload of an image of 'length' bytes with CRC-32 'crc' to partition
+// 'id' (replaces any session). The slot should be erased; the record stops
+// describing it. Without CONFIG_BOOT_RECORD this does nothing and returns 0.
+int boot_record_session_begin( uint32_t id, uint32_t length, uint32_t crc );
+
+// Copy the session; 'committed' is the current count (which may be ahead of
+// the last checkpoint). Returns (-1) if there's no session.
+int boot_record_session_get( boot_record_session_t * session );
+
+// Page 'page' of partition 'id' was written; only advances the session if it's
+// the next page in order
+int boot_record_session_commit( uint32_t id, uint32_t page );
+
+// End the session if it's for partition 'id' (the slot was erased / replaced)
+int boot_record_session_end( uint32_t id );
+
+#endif // BOOT_RECORD_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,75 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include "config.h"
+#include "common.h"
+
+#include <stdint.h>
+
+// Clock tree
+//
+// Out of reset the core and the peripherals run from the internal RC
+// oscillator (12 MHz V71, ~4 MHz RH71). With CONFIG_CLOCK_PLL clock_init()
+// starts the main crystal, locks PLLA to CONFIG_SYS_CLOCK_HZ
+// (CONFIG_CLOCK_XTAL_HZ * CONFIG_CLOCK_PLL_MUL / CONFIG_CLOCK_PLL_DIV) and
+// switches the core to it, with the peripheral clock (MCK) divided down by
+// CONFIG_CLOCK_MCK_DIV. The flash wait states are raised first.
+//
+// Everything clocked from MCK / MAINCK (USART baud divisors, the RH71 flash
+// write clock, the DWT timebase) goes by the clock_get_*() functions, which
+// follow the configuration once clock_init() has succeeded and the RC
+// oscillator otherwise (no PLL configured, or the crystal / PLL didn't start).
+// clock_deinit() puts the tree back the way it was out of reset before the
+// jump to the application.
+
+#if defined(CONFIG_SOC_SERIES_SAMV71)
+	#define CLOCK_RC_HZ		12000000
+	#define CLOCK_RC_USART_CD	20	// 38400 (tuned on the board)
+	#define CLOCK_RC_USART_BAUD	38400
+#elif defined(CONFIG_SOC_SERIES_SAMRH71)
+	// NOTE: The RC runs a little fast of ~4 MHz; 13 (the computed divisor)
+	// is off by too much
+	#define CLOCK_RC_HZ		4000000
+	#define CLOCK_RC_USART_CD	14	// 19200 (tuned on the board)
+	#define CLOCK_RC_USART_BAUD	19200
+#endif // CONFIG_SOC_SERIES_*
+
+// Configured clocks (what clock_init() sets up)
+#if defined(CONFIG_CLOCK_PLL)
+	#define CLOCK_MAINCK_HZ		CONFIG_CLOCK_XTAL_HZ
+	#define CLOCK_MCK_HZ		(CONFIG_SYS_CLOCK_HZ / CONFIG_CLOCK_MCK_DIV)
+#else
+	#define CLOCK_MAINCK_HZ		CONFIG_SYS_CLOCK_HZ
+	#define CLOCK_MCK_HZ		CONFIG_SYS_CLOCK_HZ
+#endif // defined(CONFIG_CLOCK_PLL)
+
+// USART baud rate generator clock divisor (16x oversampling), rounded
+#define CLOCK_USART_CD(baud)	((CLOCK_MCK_HZ + (8 * (baud))) / (16 * (baud)))
+
+// Bring up the configured clock tree; a no-op without CONFIG_CLOCK_PLL.
+// Returns 0, or (-1) if the crystal or the PLL didn't start (the core is left
+// on the RC oscillator, which the clock_get_*() functions then report).
+int clock_init();
+
+// The clocks as they run now: core (and DWT), MCK and MAINCK in Hz
+uint32_t clock_get_core_hz();
+uint32_t clock_get_mck_hz();
+uint32_t clock_get_mainck_hz();
+
+// USART baud rate generator divisor for 'baud' on the running MCK; on the RC
+// oscillator it's scaled from the tuned CLOCK_RC_USART_CD
+uint32_t clock_get_usart_cd( uint32_t baud );
+
+// Back to the reset clock tree (RC oscillator, no PLL, reset wait states)
+void clock_deinit();
+
+#endif // CLOCK_H
+
+#ifdef __cplusplus
+}
+#endif
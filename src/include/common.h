@@ -28,6 +28,18 @@ __attribute__( ( always_inline ) ) static inline void __set_MSP( uint32_t top_of
 
 #define MMIO32(addr)		(*(volatile uint32_t *)(addr))
 
+// Place a function in RAM; it's copied there with the initialized data by
+// reset_handler(). Needed for code that runs while the flash array can't be
+// read (e.g. with the user signature mapped). 'long_call' because flash and
+// SRAM are too far apart for a BL.
+#define __ramfunc	__attribute__((section(".ramfunc"), long_call, noinline))
+
+// Hot path code / data for the TCMs (see cache.h); copied / zeroed by
+// reset_handler(). Without CONFIG_TCM the linker script puts them back in
+// .text / .bss. __dtcm data is zero-initialized only.
+#define __itcm	__attribute__((section(".itcm"), long_call))
+#define __dtcm	__attribute__((section(".dtcm")))
+
 #endif // COMMON_H
 
 #ifdef __cplusplus
@@ -0,0 +1,65 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef COPY_H
+#define COPY_H
+
+#include <stdint.h>
+
+// On-device slot copy
+//
+// Copies the first 'length' bytes (rounded up to whole pages) of one partition
+// to another, reading the source straight from the memory-mapped flash. Runs a
+// step per copy_poll() so the server keeps answering:
+//
+// 1. Erase: one destination page is compared per step. Blocks of
+//    FLASH_ERASE_MIN_PAGES that hold a page that's neither erased nor already
+//    equal to the source are collected into runs, and each run is erased with
+//    flash_erase_pages() (the fewest erase commands for the run).
+// 2. Program: one page per step; pages already equal to the source (including
+//    erased source pages) are skipped.
+//
+// Nothing is persisted: the copy is resumed after an interruption by starting
+// it again, since pages that made it across are skipped and blocks that are
+// already right aren't erased. Copying an image onto an identical one costs
+// only the compares.
+
+typedef enum {
+	COPY_IDLE = 0,	// Nothing started
+	COPY_ERASE,		// Erasing what's in the way
+	COPY_PROGRAM,	// Programming pages
+	COPY_DONE,		// Finished, destination matches the source
+	COPY_ERROR		// Stopped; see copy_progress_t.error
+} copy_state_t;
+
+typedef struct {
+	copy_state_t state;
+	int32_t error;		// Flash error code / (-1) if a page didn't read back
+	uint32_t page;		// Next page (of the current phase)
+	uint32_t pages;		// Pages to copy
+	uint32_t erased;	// Pages erased
+	uint32_t programmed;	// Pages programmed
+	uint32_t skipped;	// Pages that already matched
+} copy_progress_t;
+
+// Returns 0 if started, (-1) on an invalid / identical partition or length
+int copy_start( uint32_t src, uint32_t dst, uint32_t length );
+
+// Called from the main loop; does nothing unless a copy is in progress
+void copy_poll();
+
+void copy_progress( copy_progress_t * progress );
+
+// True if the current / last copy was for these arguments
+int copy_is( uint32_t src, uint32_t dst, uint32_t length );
+
+// Stop / forget the current copy (the flash it covers is changing)
+void copy_cancel();
+
+#endif // COPY_H
+
+#ifdef __cplusplus
+}
+#endif
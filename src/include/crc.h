@@ -16,6 +16,18 @@ uint16_t crc_16ibm_update( uint16_t crc, uint8_t data );
 
 uint32_t crc_32_update( uint32_t crc, uint8_t data );
 uint32_t crc_32_finalize( uint32_t crc );
+
+// Word-at-a-time kernel (slicing-by-4 with CONFIG_CRC_SLICE_BY_4); 'data' must
+// be word-aligned. Use for memory-mapped flash / large buffers.
+uint32_t crc_32_update_words( uint32_t crc, const uint32_t * data, uint32_t n_words );
+
+// Any alignment / length; uses the word kernel for the aligned middle
+uint32_t crc_32_update_block( uint32_t crc, const uint8_t * data, uint32_t len );
+
+// Byte-wise, from the table in flash only: no RAM (the slicing tables) and never
+// in the TCM, so it can be called by the application (bl_api.h)
+uint32_t crc_32_update_bytes( uint32_t crc, const uint8_t * data, uint32_t len );
+
 uint32_t crc_32( uint8_t * data, uint32_t len );
 
 #endif // CRC_H
@@ -7,6 +7,7 @@
 #define FLASH_H
 
 #include "common.h"
+#include "config.h"
 #include <stdint.h>
 
 typedef struct {
@@ -20,13 +21,97 @@ int flash_init();
 
 int flash_get_partition( uint32_t id, flash_partition_t * partition );
 
-// NOTE: Page-level erase granularity *not* supported by V71; I could make the V71 version do the smallest sector erase that meets the requirements *or* return an error if the pages don't correspond to sectors
-// int flash_erase_range( uint16_t page_start, uint16_t page_end );
+// Smallest erase (in pages) available in the application partitions
+#if defined(CONFIG_SOC_SERIES_SAMV71)
+	#define FLASH_ERASE_MIN_PAGES	16 // EPA; 4 / 8 pages only in the small sectors
+#else
+	#define FLASH_ERASE_MIN_PAGES	1 // EP
+#endif // defined(CONFIG_SOC_SERIES_SAMV71)
+
+// Erase 'n_pages' pages of partition 'id' starting at 'page' (both multiples of
+// FLASH_ERASE_MIN_PAGES) with the fewest erase commands: the largest aligned
+// erase that fits is used at every step. Returns (-1) for an unknown
+// partition, (-2) for an invalid range or a flash error code.
+int flash_erase_pages( uint32_t id, uint16_t page, uint16_t n_pages );
 
 int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page );
 
+// Page latch
+//
+// The flash controller programs a page from its latch buffer, which is filled
+// by word writes anywhere in the flash array (only the offset within the page
+// counts). Every write goes through it, flash_write_page() and the user
+// signature included; whoever fills it claims it first, so a filler can tell
+// if someone else took it in the meantime (its generation changed).
+
+// Take the latch; returns the new generation (never 0)
+uint32_t flash_latch_claim();
+
+// Generation of the last claim
+uint32_t flash_latch_owner();
+
+// Write 'word' at byte 'offset' (multiple of 4) of the latch
+int flash_latch_write( uint32_t offset, uint32_t word );
+
+// Driver: program page 'page' of partition 'id' from the latch as it is.
+// Returns (-1) for an unknown partition, (-2) for an invalid page or a flash
+// error code.
+int flash_commit_latch( uint32_t id, uint16_t page );
+
 int flash_erase_partition( uint32_t id );
 
+// Driver: erase 'n_pages' pages (FLASH_ERASE_MIN_PAGES, 16 or 32) starting at
+// 'page', the page number within the flash array (aligned to 'n_pages')
+int flash_erase_block( uint32_t page, uint32_t n_pages );
+
+// User signature
+//
+// One page (CONFIG_PAGE_SIZE) of non-volatile storage outside the flash array
+// that survives erasing the partitions. 'offset' and 'len' are in bytes and
+// must be multiples of 4.
+//
+// Programming can only clear bits; words outside [offset, offset + len) are
+// left untouched (written as FF). Erasing sets the whole page back to FF.
+//
+// NOTE: The read runs from RAM (the flash array is unreadable while the user
+// signature is mapped); 'data' must be in RAM as well
+int flash_read_user_signature( uint32_t offset, uint32_t * data, uint32_t len );
+int flash_write_user_signature( uint32_t offset, const uint32_t * data, uint32_t len );
+int flash_erase_user_signature();
+
+// flash_write_user_signature() / flash_write_record() without claiming the
+// latch (a RAM counter), for the bootloader API (bl_api.h), which runs without
+// the bootloader's RAM
+int flash_program_user_signature( uint32_t offset, const uint32_t * data, uint32_t len );
+int flash_program_record( uint32_t offset, const uint32_t * data, uint32_t len );
+
+// Record block
+//
+// The boot record's second copy (boot_record.h). It's the smallest erase at
+// the top of the bootloader's flash, below the one holding the API table
+// (bl_api.h) when there is one; the linker script keeps the bootloader out of
+// both (keep them in sync). Only the first page is used, the same way as the
+// user signature: programmed a line at a time (only clearing bits) and erased
+// as a whole. It's in the flash array, so it's read in place.
+#if defined(CONFIG_SOC_SERIES_SAMV71)
+	#define FLASH_RECORD_ERASE_PAGES	4 // EPA; the bootloader is in the small sectors
+#else
+	#define FLASH_RECORD_ERASE_PAGES	1 // EP
+#endif // defined(CONFIG_SOC_SERIES_SAMV71)
+
+#define FLASH_RECORD_BLOCK_SIZE		(FLASH_RECORD_ERASE_PAGES * CONFIG_PAGE_SIZE)
+
+#if defined(CONFIG_BL_API)
+	#define FLASH_RECORD_ADDRESS	(CONFIG_FLASH_BASE_ADDRESS + (CONFIG_BOOTLOADER_SIZE * 1024) - (2 * FLASH_RECORD_BLOCK_SIZE))
+#else
+	#define FLASH_RECORD_ADDRESS	(CONFIG_FLASH_BASE_ADDRESS + (CONFIG_BOOTLOADER_SIZE * 1024) - FLASH_RECORD_BLOCK_SIZE)
+#endif // defined(CONFIG_BL_API)
+
+// Same arguments as the user signature; only with CONFIG_BOOT_RECORD (which
+// reserves the block)
+int flash_write_record( uint32_t offset, const uint32_t * data, uint32_t len );
+int flash_erase_record();
+
 #endif // FLASH_H
 
 #ifdef __cplusplus
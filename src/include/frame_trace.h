@@ -0,0 +1,91 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef FRAME_TRACE_H
+#define FRAME_TRACE_H
+
+#include "config.h"
+#include "sll.h"
+
+#include <stdint.h>
+
+// Frame trace
+//
+// The transport appends every frame it decodes, drops (CRC failure) or sends,
+// and every character error, to a ring in RAM with a trace_now() timestamp,
+// so the traffic leading up to a stall can be read out afterwards with the
+// debugger:
+//
+//   (gdb) dump binary value frames.mtrc frame_trace_g
+//
+// The ring is also the file format: a header followed by 'n_records' records,
+// the oldest at (head % n_records) once it has wrapped. blcli --frame-trace
+// writes the same format on the host (n_records 0: the file just grows), and
+// tools/host/blreplay replays either against a native build of the server.
+//
+// All fields are little-endian. Everything compiles to nothing when
+// CONFIG_FRAME_TRACE is unset.
+
+#define FRAME_TRACE_MAGIC		0x4352544D // "MTRC"
+#define FRAME_TRACE_VERSION		1
+
+#define FRAME_TRACE_DATA_LEN	SLL_MAX_PAYLOD_LEN
+
+typedef enum {
+	FRAME_TRACE_RX = 0,		// Frame decoded; the payload
+	FRAME_TRACE_RX_CRC,		// Frame dropped on a CRC failure; the payload as received
+	FRAME_TRACE_RX_ERROR,	// Character lost (USART overrun or framing error); no data
+	FRAME_TRACE_TX			// Frame sent; the payload (before SLL encoding)
+} frame_trace_kind_t;
+
+// Which end of the link recorded the trace (RX / TX are from its point of view)
+typedef enum {
+	FRAME_TRACE_ORIGIN_DEVICE = 0,
+	FRAME_TRACE_ORIGIN_HOST
+} frame_trace_origin_t;
+
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t record_size;	// sizeof(frame_trace_record_t)
+	uint32_t timebase_hz;	// Ticks per second of the record times
+	uint32_t n_records;		// Size of the ring; 0 for a file that just grows
+	uint32_t head;			// Records written
+	uint16_t page_size;		// CONFIG_PAGE_SIZE of the device (0: not known)
+	uint8_t origin;			// frame_trace_origin_t
+	uint8_t reserved;
+} frame_trace_header_t;
+
+typedef struct {
+	uint32_t time;			// trace_now(); wraps, take differences
+	uint8_t kind;			// frame_trace_kind_t
+	uint8_t reserved;
+	uint16_t len;
+	uint8_t data[FRAME_TRACE_DATA_LEN];
+} frame_trace_record_t;
+
+#if defined(CONFIG_FRAME_TRACE)
+	typedef struct {
+		frame_trace_header_t header;
+		frame_trace_record_t records[CONFIG_FRAME_TRACE_ENTRIES];
+	} frame_trace_t;
+
+	extern frame_trace_t frame_trace_g;
+
+	#define FRAME_TRACE(kind, data, len)	frame_trace_add( (kind), (data), (len) )
+#else
+	#define FRAME_TRACE(kind, data, len)	((void)0)
+#endif // defined(CONFIG_FRAME_TRACE)
+
+void frame_trace_init();
+
+// Append a record; 'len' is cut to FRAME_TRACE_DATA_LEN
+void frame_trace_add( frame_trace_kind_t kind, const uint8_t * data, uint32_t len );
+
+#endif // FRAME_TRACE_H
+
+#ifdef __cplusplus
+}
+#endif
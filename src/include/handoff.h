@@ -0,0 +1,74 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+// Bootloader to application handoff block
+//
+// Filled in just before the jump to the application, at a fixed address: the
+// first HANDOFF_SIZE bytes of SRAM. The bootloader's linker script keeps them
+// out of its own sections; the application's has to do the same (and must not
+// zero them) to read the block after it starts.
+//
+// The block describes the boot (slot, why it was picked, the image the boot
+// record says is in it) and what it cost (cycles from reset to the jump and
+// spent hashing images, link statistics). It's only valid if the magic,
+// version and CRC check out; the bootloader clears the magic as it starts, so a
+// stale block (e.g. the application started by a debugger) doesn't pass.
+//
+// NOTE: The cycle counts are DWT cycles at 'clock_hz'. With CONFIG_CLOCK_PLL
+// the cycles before clock_init() are RC oscillator cycles, which makes the
+// reset-to-jump figure slightly low.
+
+#define HANDOFF_ADDRESS		(CONFIG_SRAM_BASE_ADDRESS)
+#define HANDOFF_SIZE		64	// Reserved in atsamx71_bl.ld; keep in sync
+
+#define HANDOFF_MAGIC		0x464F4448 // "HDOF"
+#define HANDOFF_VERSION		1
+
+// Why the slot was booted
+#define HANDOFF_REASON_FAST_BOOT	1	// Fast boot of the active (or only) slot
+#define HANDOFF_REASON_FALLBACK		2	// Fast boot of the other slot; the active slot failed its check / ran out of attempts
+#define HANDOFF_REASON_HOST			3	// Requested by the host (bl_setBootAction / bl_boot)
+
+// NOTE: Fields are only ever appended; 'size' tells the application how much
+// of the block this bootloader filled in
+typedef struct {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t size;			// sizeof(handoff_t)
+	uint32_t reason;		// HANDOFF_REASON_*
+	uint32_t slot;			// Partition id booted
+	uint32_t image_length;	// From the boot record; FF if it doesn't describe the slot
+	uint32_t image_crc;
+	uint32_t attempts;		// Unconfirmed boots of the slot, including this one
+	uint32_t clock_hz;		// Core clock the cycle counts are in
+	uint32_t jump_cycles;	// Reset to jump
+	uint32_t verify_cycles;	// Spent hashing images since reset (boot record checks)
+	uint32_t rpc_requests;	// Requests served since reset (0 without CONFIG_STATS)
+	uint32_t link_errors;	// Frames / characters lost since reset (0 without CONFIG_STATS)
+	uint32_t crc;			// CRC-32 of everything above
+} handoff_t;
+
+// Invalidate the block left over from before the reset
+void handoff_init();
+
+// Account time spent hashing an image
+void handoff_add_verify_cycles( uint32_t cycles );
+
+// Fill in the block for a jump to partition 'id'; the last thing before the
+// clocks / caches are put back
+void handoff_fill( uint32_t id, uint32_t reason );
+
+#endif // HANDOFF_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,80 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+
+// Image header
+//
+// Produced by tools/imgpack.py and prepended to the application binary in the
+// image file (not in flash; the slot still starts with the vector table). The
+// host sends the header ahead of erasing a slot so the device can reject an
+// image built for a different slot, load address or page size, and the length
+// and CRC-32 travel with the image rather than being derived by the host.
+//
+// Layout (little-endian, IMAGE_HEADER_SIZE bytes):
+//
+//   0  u32 magic         IMAGE_MAGIC
+//   4  u8  version       IMAGE_VERSION
+//   5  u8  slot          Partition id the image was linked for (IMAGE_SLOT_ANY)
+//   6  u8  flags         IMAGE_FLAG_*
+//   7  u8  header_size   IMAGE_HEADER_SIZE
+//   8  u32 length        Image length in bytes (excluding header / page table)
+//  12  u32 crc           CRC-32 of the image
+//  16  u32 load_address  Address the image was linked to run from
+//  20  u16 page_size     Flash page size the page table was computed for
+//  22  u16 page_count    Number of entries in the page CRC table
+//  24  u32 reserved      Zero
+//  28  u32 header_crc    CRC-32 of bytes [0, 28)
+//
+// With IMAGE_FLAG_PAGE_CRCS the header is followed by 'page_count' u32 CRC-32s,
+// one per page (the last page padded with FF, as written to flash); the image
+// itself follows.
+
+#define IMAGE_MAGIC				0x49464C4F // "OLFI"
+#define IMAGE_VERSION			1
+#define IMAGE_HEADER_SIZE		32
+
+#define IMAGE_SLOT_ANY			0xFF
+
+#define IMAGE_FLAG_PAGE_CRCS	(1 << 0)
+
+// Error return values of image_header_check()
+#define IMAGE_E_HEADER			(-1)	// Bad magic / version / size / header CRC
+#define IMAGE_E_SLOT			(-2)	// Built for a different slot
+#define IMAGE_E_ADDRESS			(-3)	// Linked for a different load address
+#define IMAGE_E_PAGE_SIZE		(-4)	// Page size doesn't match the device
+#define IMAGE_E_LENGTH			(-5)	// Empty or larger than the slot
+
+typedef struct {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t slot;
+	uint8_t flags;
+	uint8_t header_size;
+	uint32_t length;
+	uint32_t crc;
+	uint32_t load_address;
+	uint16_t page_size;
+	uint16_t page_count;
+	uint32_t reserved;
+	uint32_t header_crc;
+} image_header_t;
+
+// Decode a header from its wire / file representation ('data' needn't be
+// aligned); returns IMAGE_E_HEADER if 'len' is too short or the header CRC
+// doesn't match
+int image_header_parse( const uint8_t * data, uint32_t len, image_header_t * header );
+
+// Check a header against partition 'id'; returns 0 or IMAGE_E_*
+int image_header_check( const image_header_t * header, uint32_t id );
+
+#endif // IMAGE_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -51,6 +51,7 @@ void moon_codec_write_header( uint8_t * buffer, moon_msg_hdr_t * header );
 void moon_codec_write_u8( uint8_t * buffer, uint8_t var, uint32_t offset );
 void moon_codec_write_u16( uint8_t * buffer, uint16_t var, uint32_t offset );
 void moon_codec_write_u32( uint8_t * buffer, uint32_t var, uint32_t offset );
+void moon_codec_write_u64( uint8_t * buffer, uint64_t var, uint32_t offset );
 
 void moon_codec_write_i8( uint8_t * buffer, int8_t var, uint32_t offset );
 void moon_codec_write_i16( uint8_t * buffer, int16_t var, uint32_t offset );
@@ -60,6 +61,7 @@ void moon_codec_write_i32( uint8_t * buffer, int32_t var, uint32_t offset );
 void moon_codec_read_u8( uint8_t * buffer, uint8_t * var, uint32_t offset );
 void moon_codec_read_u16( uint8_t * buffer, uint16_t * var, uint32_t offset );
 void moon_codec_read_u32( uint8_t * buffer, uint32_t * var, uint32_t offset );
+void moon_codec_read_u64( uint8_t * buffer, uint64_t * var, uint32_t offset );
 
 void moon_codec_read_i8( uint8_t * buffer, int8_t * var, uint32_t offset );
 void moon_codec_read_i16( uint8_t * buffer, int16_t * var, uint32_t offset );
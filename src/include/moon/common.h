@@ -28,9 +28,9 @@ typedef enum {
 
 typedef enum {
 	MSG_TYPE_SINGLE_NORMAL = 0,
-	MSG_TYPE_SINGLE_CONTROL = 1
+	MSG_TYPE_SINGLE_CONTROL = 1,
 	// MSG_TYPE_MULTI_FIXED = 2,
-	// MSG_TYPE_MULTI_STREAM = 3
+	MSG_TYPE_MULTI_STREAM = 3 // Server -> client only; see moon_server_stream_start()
 } msg_type_t;
 
 // TODO: (60) [feature] @poorly_defined Define enum for protocol
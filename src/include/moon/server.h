@@ -42,6 +42,42 @@ moon_ret_t moon_server_init();
 // Non-blocking server call
 moon_ret_t moon_server_poll();
 
+// -- Stream responses -- //
+//
+// A served function can follow its (single normal) response with a run of
+// MSG_TYPE_MULTI_STREAM frames, e.g. to return more data than fits in one
+// message. Stream frames use the full link-layer payload rather than
+// MOON_MAX_MESSAGE_LEN and are laid out as:
+//
+//   [0:2] header (type MULTI_STREAM; service / method / sequence of the request)
+//   [3]   flags (MOON_STREAM_FLAG_*)
+//   [4:]  data written by the fill function
+//
+// Flow control is by credit: the stream sends at most 'n_frames' frames and
+// then stops; the client asks for more with another request once it has
+// received them. The frames go out one per moon_server_poll() call while no
+// request is arriving (moon_transport_is_idle()), and any request that arrives
+// ends the stream, so the client can always take the link back.
+//
+// NOTE: The frames are built in the transport buffer (zero-copy, like the
+// responses); a request partway through arriving holds the stream off rather
+// than being overwritten
+
+#define MOON_STREAM_HDR_LEN		4
+
+#define MOON_STREAM_FLAG_LAST	0x01 // No more data (not just out of credit)
+
+// Write up to 'max_len' bytes of the next frame to 'data' and return the
+// number written; set '*last' on the final frame. A return ltz ends the stream
+// without sending anything.
+typedef int (*moon_stream_fill_t)( uint8_t * data, uint32_t max_len, uint8_t * last );
+
+// Only valid from within a served function (the stream takes the identity of
+// the request being served); replaces any stream in progress
+void moon_server_stream_start( moon_stream_fill_t fill, uint32_t n_frames );
+
+void moon_server_stream_stop();
+
 
 // This is the prototype for the function implemented in the generated file
 // "moon/generated/services.c" which handles the "service_id" component of the
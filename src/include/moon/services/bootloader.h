@@ -36,6 +36,108 @@ typedef enum AppId
     BOOTLOADER = 255
 } AppId;
 
+typedef enum TraceKind
+{
+    TRACE_STAGE = 0,
+    TRACE_METHOD = 1
+} TraceKind;
+
+typedef enum Feature
+{
+    FEATURE_BOOT_RECORD = 1,
+    FEATURE_FAST_BOOT = 2,
+    FEATURE_HANDOFF = 4,
+    FEATURE_BL_API = 8,
+    FEATURE_DIRECT_LATCH = 16,
+    FEATURE_STATS = 32,
+    FEATURE_TRACE = 64,
+    FEATURE_RAM_BUILD = 128
+} Feature;
+
+// Aliases data types declarations
+typedef struct Stats Stats;
+typedef struct TraceEntry TraceEntry;
+typedef struct BootRecord BootRecord;
+typedef struct CopyStatus CopyStatus;
+typedef struct UploadSession UploadSession;
+typedef struct DeviceInfo DeviceInfo;
+
+// Structures/unions data types declarations
+struct Stats
+{
+    uint32_t sll_frames;
+    uint32_t sll_crc_errors;
+    uint32_t sll_len_errors;
+    uint32_t usart_overruns;
+    uint32_t usart_frame_errors;
+    uint32_t transport_errors;
+    uint32_t server_requests;
+    uint32_t server_retries;
+    uint32_t server_no_service;
+    uint32_t server_no_method;
+    uint32_t server_syntax_errors;
+    uint32_t server_codec_errors;
+};
+
+struct TraceEntry
+{
+    TraceKind kind;
+    uint8_t id;
+    uint8_t method;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint32_t timebase_hz;
+    uint64_t sum;
+};
+
+struct BootRecord
+{
+    int8_t active;
+    uint8_t attempts;
+    uint8_t max_attempts;
+    uint8_t verified;
+    uint32_t app1_length;
+    uint32_t app1_crc;
+    uint32_t app2_length;
+    uint32_t app2_crc;
+};
+
+struct CopyStatus
+{
+    uint8_t state;
+    int8_t error;
+    uint16_t pages;
+    uint16_t page;
+    uint16_t erased;
+    uint16_t programmed;
+    uint16_t skipped;
+};
+
+struct UploadSession
+{
+    int8_t app_id;
+    uint8_t reserved;
+    uint16_t committed;
+    uint32_t length;
+    uint32_t crc;
+};
+
+struct DeviceInfo
+{
+    uint8_t info_version;
+    uint8_t codec_version;
+    uint16_t page_size;
+    uint16_t max_message_len;
+    uint16_t erase_pages;
+    uint32_t features;
+    uint32_t baud_rate;
+    uint32_t app1_start;
+    uint32_t app1_size;
+    uint32_t app2_start;
+    uint32_t app2_size;
+};
+
 #endif // ERPC_TYPE_DEFINITIONS
 
 /*! @brief Bootloader identifiers */
@@ -48,7 +150,23 @@ enum _Bootloader_ids
     kBootloader_bl_eraseApp_id = 4,
     kBootloader_bl_writePage_id = 5,
     kBootloader_bl_setBootAction_id = 8,
-    kBootloader_bl_boot_id = 9
+    kBootloader_bl_boot_id = 9,
+    kBootloader_bl_getStats_id = 10,
+    kBootloader_bl_getTrace_id = 11,
+    kBootloader_bl_resetTrace_id = 12,
+    kBootloader_bl_setActiveApp_id = 13,
+    kBootloader_bl_getBootRecord_id = 14,
+    kBootloader_bl_confirmBoot_id = 15,
+    kBootloader_bl_checkImage_id = 16,
+    kBootloader_bl_verifyApp_id = 17,
+    kBootloader_bl_readApp_id = 18,
+    kBootloader_bl_copyApp_id = 19,
+    kBootloader_bl_getCopyStatus_id = 20,
+    kBootloader_bl_beginUpload_id = 21,
+    kBootloader_bl_getUploadSession_id = 22,
+    kBootloader_bl_writeAddress_id = 23,
+    kBootloader_bl_flushWrites_id = 24,
+    kBootloader_bl_getInfo_id = 25
 };
 
 #if defined(__cplusplus)
@@ -64,6 +182,22 @@ int8_t bl_eraseApp(AppId app_id);
 int8_t bl_writePage(AppId app_id, uint16_t page_no, uint32_t crc);
 int8_t bl_setBootAction(BootAction action);
 int8_t bl_boot();
+int8_t bl_getStats(bool reset, Stats * stats);
+int8_t bl_getTrace(uint8_t index, TraceEntry * entry);
+void bl_resetTrace(void);
+int8_t bl_setActiveApp(AppId app_id, uint32_t length, uint32_t crc);
+int8_t bl_getBootRecord(BootRecord * record);
+int8_t bl_confirmBoot(void);
+int8_t bl_checkImage(AppId app_id, uint8_t header_len, const uint8_t * header);
+int8_t bl_verifyApp(AppId app_id, uint32_t length, uint32_t crc);
+int8_t bl_readApp(AppId app_id, uint32_t offset, uint32_t length, uint8_t frames);
+int8_t bl_copyApp(AppId src_id, AppId dst_id, uint32_t length);
+int8_t bl_getCopyStatus(CopyStatus * status);
+int8_t bl_beginUpload(AppId app_id, uint32_t length, uint32_t crc);
+int8_t bl_getUploadSession(UploadSession * session);
+int8_t bl_writeAddress(AppId app_id, uint32_t offset, uint8_t data_len, const uint8_t * data);
+int8_t bl_flushWrites(void);
+int8_t bl_getInfo(DeviceInfo * info);
 //@} 
 
 #if defined(__cplusplus)
@@ -10,6 +10,7 @@
 #include "moon/server.h"
 
 #include <stdint.h>
+#include <stdbool.h>
 
 // int32_t moon_transport_init( uint8_t * buffer, uint32_t buffer_size );
 
@@ -22,6 +23,9 @@ uint8_t * moon_transport_get_msg_buffer();
 // Return length of message associated with moon_transport_read() returning MOON_RET_MSG_READY
 uint32_t moon_transport_get_read_length();
 
+// Largest payload the transport can send in one frame (at least MOON_MAX_MESSAGE_LEN)
+uint32_t moon_transport_get_max_length();
+
 /**
  * @brief      Non-blocking read from the transport layer implementation
  *
@@ -29,6 +33,11 @@ uint32_t moon_transport_get_read_length();
  */
 moon_ret_t moon_transport_read();
 
+// True while no message is partway through arriving; moon_transport_read()
+// returns MOON_RET_MSG_NOT_READY both then and mid-message, and only the former
+// leaves the message buffer free to write from
+bool moon_transport_is_idle();
+
 moon_ret_t moon_transport_write( uint32_t len );
 
 #endif // MOON_TRANSPORT_H
@@ -0,0 +1,58 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef PAGE_CACHE_H
+#define PAGE_CACHE_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+// Write-by-address page cache
+//
+// Merges (offset, data) writes to a partition into a few page-sized buffers so
+// an image can be sent as sparse segments, in any order, without padding the
+// gaps. A page is committed with flash_write_page() once every byte of it has
+// been written, when its entry is evicted (least recently used) to make room
+// for another page, or on page_cache_flush().
+//
+// An entry starts out as a copy of the page in flash (FF for an erased page),
+// so bytes that were never written are programmed with what's already there.
+// Programming can only clear bits: writing a page that was committed earlier
+// works as long as the new bytes land on erased flash. Every commit is read
+// back; a page that doesn't match (e.g. it wasn't erased) fails the write.
+
+#if defined(CONFIG_PAGE_CACHE_ENTRIES)
+	#define PAGE_CACHE_ENTRIES	CONFIG_PAGE_CACHE_ENTRIES
+#else
+	#define PAGE_CACHE_ENTRIES	4
+#endif // defined(CONFIG_PAGE_CACHE_ENTRIES)
+
+#define PAGE_CACHE_ALL	0xFFFFFFFF
+
+// A committed page didn't read back (the flash under it wasn't erased)
+#define PAGE_CACHE_E_READBACK	(-2)
+
+// Write 'len' bytes at 'offset' into partition 'id'; may span pages. Returns 0,
+// (-1) on an invalid partition / range, or the error of a page committed on
+// the way (PAGE_CACHE_E_READBACK or a flash error code; the page is dropped).
+int page_cache_write( uint32_t id, uint32_t offset, const uint8_t * data, uint32_t len );
+
+// Commit every cached page of partition 'id' (PAGE_CACHE_ALL for all
+// partitions). Returns 0 or the first commit error; failed pages are dropped.
+int page_cache_flush( uint32_t id );
+
+// Drop cached page 'page' of partition 'id' without writing it
+// (PAGE_CACHE_ALL drops the whole partition)
+void page_cache_discard( uint32_t id, uint32_t page );
+
+// Number of pages cached
+uint32_t page_cache_pending();
+
+#endif // PAGE_CACHE_H
+
+#ifdef __cplusplus
+}
+#endif
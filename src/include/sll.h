@@ -82,6 +82,10 @@ uint32_t sll_get_decoded_len( sll_decode_frame_t * const frame );
  */
 int sll_decode( sll_decode_frame_t * frame, uint8_t c );
 
+// 1 if no frame is partway through decoding (nothing past the sync sequence
+// has been received), so the buffer is free to encode into; 0 otherwise
+int sll_decode_is_idle( sll_decode_frame_t * const frame );
+
 // no-copy prototype; the frame has the buffer references
 int sll_encode( sll_decode_frame_t * const frame, uint32_t data_len );
 // int sll_encode( uint8_t * out_buffer, uint8_t * data, uint8_t len );
@@ -0,0 +1,59 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+// Link-layer and server statistics
+//
+// The counters are maintained by the layers that observe the events (sll.c,
+// transport_usart.c, server.c) and are plain 32-bit increments so they can sit
+// on the per-byte / per-frame hot path; nothing here prints or blocks. The
+// counters are free-running and wrap at UINT32_MAX.
+//
+// NOTE: The order of the fields is the order they go out on the wire
+// (bl_getStats); add new counters to the end and keep the IDL in sync.
+typedef struct {
+	// -- Link layer (sll.c) -- //
+	uint32_t sll_frames;			// Frames decoded with a good CRC
+	uint32_t sll_crc_errors;		// Frames dropped on CRC failure
+	uint32_t sll_len_errors;		// Length byte exceeded SLL_MAX_PAYLOD_LEN
+
+	// -- Transport (transport_usart.c) -- //
+	uint32_t usart_overruns;		// Character lost (USART OVRE)
+	uint32_t usart_frame_errors;	// Stop bit missing (USART FRAME)
+	uint32_t transport_errors;		// MOON_RET_E_TRANSPORT results (read or write)
+
+	// -- Server (server.c) -- //
+	uint32_t server_requests;		// Messages passed to the services handler
+	uint32_t server_retries;		// Request repeated the previous service, method and sequence
+	uint32_t server_no_service;		// MOON_RET_E_NO_SERVICE replies
+	uint32_t server_no_method;		// MOON_RET_E_NO_METHOD replies
+	uint32_t server_syntax_errors;	// MOON_RET_E_SYNTAX replies
+	uint32_t server_codec_errors;	// Header failed to decode (e.g. codec version)
+} stats_t;
+
+#if defined(CONFIG_STATS)
+	extern stats_t stats_g;
+
+	#define STATS_INC(counter)	(stats_g.counter++)
+#else
+	#define STATS_INC(counter)	((void)0)
+#endif // defined(CONFIG_STATS)
+
+// Copy the current counters into 'stats' (all zero if CONFIG_STATS is unset)
+void stats_get( stats_t * stats );
+
+void stats_reset();
+
+#endif // STATS_H
+
+#ifdef __cplusplus
+}
+#endif
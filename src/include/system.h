@@ -10,11 +10,30 @@
 #include <stdbool.h>
 
 int sys_set_boot_action( uint32_t id );
+
+// Returns (-1) if no boot action is set, (-2) if the partition doesn't hold a
+// valid application (sys_check_app()) or (-3) if it doesn't match the boot record
+// or an upload to it is still open
 int sys_set_boot_enable();
 bool sys_get_boot_enable();
 
 void sys_boot_poll();
 
+// Returns 0 if partition 'id' holds what looks like a bootable application
+// (plausible initial stack pointer and a Thumb reset vector inside the
+// partition), (-1) if the partition doesn't exist or (-2) if the check fails
+int sys_check_app( uint32_t id );
+
+// Fast-boot path (CONFIG_FAST_BOOT), called before the server is brought up
+//
+// If the partition picked by the boot record (CONFIG_FAST_BOOT_PARTITION when
+// there's no record) passes sys_check_app() and (with CONFIG_BOOT_RECORD)
+// boot_record_check(), wait up to
+// CONFIG_FAST_BOOT_WINDOW_MS for a character from the host on the transport
+// USART and jump to the application if none arrives. Returns if there's no
+// valid application, the host caught the window or fast boot is disabled.
+void sys_fast_boot();
+
 #endif // SYSTEM_H
 
 #ifdef __cplusplus
@@ -0,0 +1,98 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "config.h"
+
+#include <stdint.h>
+
+// Latency instrumentation
+//
+// Stage boundaries are timestamped with a free-running 32-bit counter: the DWT
+// cycle counter on target and CLOCK_MONOTONIC (in ns) when compiled natively on
+// Linux. Each stage / method keeps a count, min, max and sum of the elapsed
+// ticks in RAM; TRACE_TIMEBASE_HZ converts ticks to time.
+//
+// Everything compiles to nothing when CONFIG_TRACE is unset.
+
+#if defined(__linux__)
+	#include <time.h>
+
+	#define TRACE_TIMEBASE_HZ	1000000000UL
+
+	static inline uint32_t trace_now( void )
+	{
+		struct timespec ts;
+		clock_gettime( CLOCK_MONOTONIC, &ts );
+		return (uint32_t)((ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+	}
+#else
+	#include "dwt.h"
+	#include "clock.h"
+
+	#define TRACE_TIMEBASE_HZ	clock_get_core_hz()
+
+	static inline uint32_t trace_now( void )
+	{
+		return dwt_get_cycles();
+	}
+#endif // defined(__linux__)
+
+// Stages of moon_server_poll() (once a frame has been received)
+typedef enum {
+	TRACE_STAGE_DECODE = 0,	// Message header decode
+	TRACE_STAGE_DISPATCH,	// Services handler (shim + served function)
+	TRACE_STAGE_ENCODE,		// Response header (error responses)
+	TRACE_STAGE_TRANSMIT,	// Link-layer encode and write
+	TRACE_N_STAGES
+} trace_stage_t;
+
+typedef enum {
+	TRACE_KIND_STAGE = 0,
+	TRACE_KIND_METHOD = 1
+} trace_kind_t;
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;
+	uint32_t max;
+	uint64_t sum;
+} trace_hist_t;
+
+// One row of the report; rows [0, TRACE_N_STAGES) are the server stages, the
+// rest are the service / method histograms in the order they were first seen
+typedef struct {
+	trace_kind_t kind;
+	uint8_t id; // Stage (TRACE_KIND_STAGE) or service id (TRACE_KIND_METHOD)
+	uint8_t method;
+	trace_hist_t hist;
+} trace_entry_t;
+
+#if defined(CONFIG_TRACE)
+	#define TRACE_NOW()						trace_now()
+	#define TRACE_STAGE(stage, start, end)	trace_stage( (stage), (start), (end) )
+	#define TRACE_METHOD(service, method, start, end)	trace_method( (service), (method), (start), (end) )
+#else
+	#define TRACE_NOW()						0
+	#define TRACE_STAGE(stage, start, end)	((void)(start), (void)(end))
+	#define TRACE_METHOD(service, method, start, end)	((void)(start), (void)(end))
+#endif // defined(CONFIG_TRACE)
+
+void trace_init();
+void trace_reset();
+
+void trace_stage( trace_stage_t stage, uint32_t start, uint32_t end );
+void trace_method( uint8_t service, uint8_t method, uint32_t start, uint32_t end );
+
+// Returns 0 and fills 'entry' if 'index' is a valid row, (-1) otherwise
+int trace_get( uint32_t index, trace_entry_t * entry );
+
+#endif // TRACE_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -13,13 +13,26 @@
 
 #define USART_FLAGS_NONBLOCK	0x1
 
+// Error return values
+#define USART_E_INVALID		(-1)	// Invalid USART number or data pointer
+#define USART_E_OVERRUN		(-2)	// A received character was lost (OVRE)
+#define USART_E_FRAMING		(-3)	// A character was received without a valid stop bit (FRAME)
+
 int usart_init();
 
 int usart_write( uint32_t usart_no, uint8_t * data, uint32_t length );
 
 // Reads a single character
+//
+// Returns 1 if a character was read, 0 if none was available (non-blocking), or
+// USART_E_* on failure. Receive errors are reported once and then cleared; the
+// character that is pending (if any) is returned by the next call.
 int usart_read( uint32_t usart_no, uint8_t * data, uint32_t flags );
 
+// Wait for everything written to have left the shift register (e.g. before the
+// clocks change)
+int usart_flush( uint32_t usart_no );
+
 #endif // USART_H
 
 #ifdef __cplusplus
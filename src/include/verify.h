@@ -0,0 +1,43 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stdint.h>
+
+// Incremental slot verification
+//
+// Computes the CRC-32 of the first 'length' bytes of a partition straight from
+// the memory-mapped flash, CONFIG_VERIFY_CHUNK_SIZE bytes per verify_poll() so
+// the server keeps answering while a whole slot is hashed. One verification
+// runs at a time; starting a new one abandons the previous.
+
+typedef enum {
+	VERIFY_IDLE = 0,	// Nothing started
+	VERIFY_BUSY,		// In progress
+	VERIFY_MATCH,		// Done, CRC matched
+	VERIFY_MISMATCH		// Done, CRC didn't match
+} verify_status_t;
+
+// Returns 0 if started, (-1) on an invalid partition / length
+int verify_start( uint32_t id, uint32_t length, uint32_t crc );
+
+// Called from the main loop; does nothing unless a verification is in progress
+void verify_poll();
+
+verify_status_t verify_status();
+
+// True if the current / last verification was for these arguments
+int verify_is( uint32_t id, uint32_t length, uint32_t crc );
+
+// Forget the current / last verification (the flash it covers is changing)
+void verify_cancel();
+
+#endif // VERIFY_H
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,6 +4,10 @@
 #include "common.h"
 #include "printf.h"
 #include "system.h"
+#include "boot_record.h"
+#include "handoff.h"
+#include "verify.h"
+#include "copy.h"
 #include "moon/server.h"
 
 // Architecture headers
@@ -13,17 +17,33 @@
 #include "usart.h"
 #include "flash.h"
 #include "watchdog.h"
+#include "clock.h"
 
 // Standard / system headers
 #include <stdint.h>
+#include <stdbool.h>
 
 int main()
 {
 	// Disable watchdog (WDT0); WDT_MR can only be written once after reset
 	// TODO: (90) @eventually Remove this - the application will configure the WDT; the bootloader will just have to deal with this for now (16s timeout)
 	watchdog_disable();
+	handoff_init();
+
+	// Before anything derived from the clocks (USART baud, flash write clock).
+	// If the crystal or the PLL doesn't start the bootloader carries on from
+	// the RC oscillator (slower, same baud rate); say so once the console is up.
+	bool clock_ok = (clock_init() == 0);
 	usart_init();
+	if ( ! clock_ok ) {
+		printf( "WARNING: crystal / PLL didn't start, running from the RC oscillator\n\r" );
+	}
 	flash_init();
+	boot_record_init();
+
+	// Go straight to the application unless the host catches the sync window
+	// (returns if fast boot is disabled or there's no valid application)
+	sys_fast_boot();
 
 	printf("-- OLF Bootloader --\n\r");
 
@@ -32,6 +52,11 @@ int main()
 	while (1) {
 		moon_server_poll();
 
+		// Background work started by RPCs (one chunk per iteration so the
+		// server stays responsive)
+		verify_poll();
+		copy_poll();
+
 		// A function call inside of server_poll (through the RPC API) will set
 		// some state variable that causes the bootloader to jump to application
 		// code; that happens here:
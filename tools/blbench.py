@@ -0,0 +1,398 @@
+"""End-to-end benchmark of the bootloader over its serial link.
+
+Measures, on a board or a simulated device (blsim.py, on a pty in this
+process):
+
+- round trips of single requests (bl_ping, bl_writePageBuffer at each
+  payload size, bl_writePage, bl_eraseApp), median and spread in ms
+- sustained upload rate (the pipelined upload blcli.py uses), data bytes/s
+- time to boot: from the last page written to bl_boot being acknowledged
+  (bl_verifyApp, bl_setActiveApp, bl_setBootAction, bl_boot), plus until
+  --boot-banner shows up on the port if one is given
+
+The results are written as JSON (-o, or stdout). --baseline compares them
+with an earlier run and exits 1 if anything got worse by more than
+--threshold percent; --compare does the same for two saved files without a
+device.
+
+NOTE: The slot given with -a (APP_2 by default) is erased and written with
+pseudo-random data, and the device is only booted into it with a real image
+(-w) or on the simulator.
+
+    $ python3 blbench.py --sim -o base.json
+    $ python3 blbench.py -d /dev/ttyACM0 -w blink.bin --baseline base.json
+    $ python3 blbench.py --compare base.json new.json
+"""
+
+import argparse
+import asyncio
+import datetime
+import json
+import random
+import struct
+import sys
+import time
+import zlib
+
+import serial
+
+import bootloader
+from bootloader.uploader import (MESSAGE_LEN_MAX, WRITE_PAGE_BUFFER_OVERHEAD, Link, call, get_info,
+    has_boot_record, probe_message_len, probe_page_size, upload)
+
+_IDS = bootloader.interface.IBootloader
+
+# Bumped when the meaning of a metric changes; files of another format aren't compared
+FORMAT = 1
+
+# Page sizes an older device (no bl_getInfo) is probed for (V71, RH71)
+PAGE_SIZES = [256, 512]
+
+# bl_verifyApp answers 1 while the device is still hashing the slot
+VERIFY_BUSY = 1
+VERIFY_POLL_S = 0.02
+
+# Latency changes smaller than this are jitter, whatever the percentage
+MIN_DELTA_MS = 0.1
+
+class BenchError(Exception):
+    pass
+
+def _percentile(values, fraction):
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(fraction * len(ordered)))]
+
+def _latency(samples, resent):
+    ms = [s * 1000.0 for s in samples]
+    return {
+        'unit': 'ms', 'better': 'lower',
+        'value': _percentile(ms, 0.5),
+        'min': min(ms), 'p90': _percentile(ms, 0.9), 'max': max(ms),
+        'samples': len(ms), 'resent': resent,
+    }
+
+async def _timed(link, method, args=b''):
+    start = time.monotonic()
+    r = await call(link, method, args)
+    return r, time.monotonic() - start
+
+async def _check(link, what, method, args=b''):
+    r = await call(link, method, args)
+    if r != 0:
+        raise BenchError('{0} failed ({1})'.format(what, r))
+
+async def bench_ping(link, n):
+    resent = link.resent
+    samples = [(await _timed(link, _IDS.BL_PING_ID))[1] for _ in range(n)]
+    return _latency(samples, link.resent - resent)
+
+async def bench_write_page_buffer(link, size, page_size, n):
+    """'n' writes of 'size' bytes, one after the other through the page
+    buffer (a direct-latch build takes each offset once); starting over on
+    a fresh buffer isn't timed"""
+    resent = link.resent
+    samples = []
+    offset = page_size
+    data = bytes(range(size))
+    for _ in range(n):
+        if offset + size > page_size:
+            await call(link, _IDS.BL_ERASEPAGEBUFFER_ID)
+            offset = 0
+        r, seconds = await _timed(link, _IDS.BL_WRITEPAGEBUFFER_ID, struct.pack('<BH', size, offset) + data)
+        if r != 0:
+            raise BenchError('bl_writePageBuffer of {0} bytes at {1} failed ({2})'.format(size, offset, r))
+        samples.append(seconds)
+        offset += size
+    return _latency(samples, link.resent - resent)
+
+async def bench_erase_app(link, app_id, n):
+    resent = link.resent
+    samples = []
+    for _ in range(n):
+        r, seconds = await _timed(link, _IDS.BL_ERASEAPP_ID, struct.pack('<B', app_id))
+        if r != 0:
+            raise BenchError('bl_eraseApp failed ({0})'.format(r))
+        samples.append(seconds)
+    return _latency(samples, link.resent - resent)
+
+async def bench_write_page(link, app_id, page_size, chunk, n):
+    """bl_writePage of pages 0 to n - 1 of the (erased) slot; filling the
+    page buffer isn't timed"""
+    resent = 0
+    samples = []
+    rng = random.Random(n)
+    for page_no in range(n):
+        page = bytes(rng.getrandbits(8) for _ in range(page_size))
+        await call(link, _IDS.BL_ERASEPAGEBUFFER_ID)
+        for offset in range(0, page_size, chunk):
+            data = page[offset:offset + chunk]
+            await _check(link, 'bl_writePageBuffer', _IDS.BL_WRITEPAGEBUFFER_ID,
+                struct.pack('<BH', len(data), offset) + data)
+
+        before = link.resent
+        r, seconds = await _timed(link, _IDS.BL_WRITEPAGE_ID, struct.pack('<BIH', app_id, zlib.crc32(page), page_no))
+        if r != 0:
+            raise BenchError('bl_writePage of page {0} failed ({1})'.format(page_no, r))
+        resent += link.resent - before
+        samples.append(seconds)
+    return _latency(samples, resent)
+
+async def bench_upload(link, app_id, binf, header, page_size, chunk):
+    """bl_beginUpload (not timed) and the upload of every page of binf
+    holding data; the rate is of data bytes sent"""
+    slot_args = struct.pack('<BII', app_id, len(binf), zlib.crc32(binf))
+    if header is not None:
+        await _check(link, 'bl_checkImage', _IDS.BL_CHECKIMAGE_ID, struct.pack('<BBxxx', app_id, len(header)) + header)
+    await _check(link, 'bl_beginUpload', _IDS.BL_BEGINUPLOAD_ID, slot_args)
+
+    pages = bootloader.segments.data_pages(binf, page_size)
+    data_bytes = sum(len(binf[p * page_size:(p + 1) * page_size]) for p in pages)
+    resent = link.resent
+    start = time.monotonic()
+    tuner = await upload(link, app_id, binf, pages, page_size, chunk)
+    seconds = time.monotonic() - start
+
+    return slot_args, {
+        'unit': 'B/s', 'better': 'higher',
+        'value': data_bytes / seconds,
+        'bytes': data_bytes, 'seconds': seconds, 'pages': len(pages),
+        'resent': link.resent - resent, 'smallest_chunk': tuner.smallest,
+    }
+
+async def bench_boot(link, app_id, slot_args, info):
+    """bl_verifyApp, bl_setActiveApp (with a boot record), bl_setBootAction
+    and bl_boot"""
+    while True:
+        r = await call(link, _IDS.BL_VERIFYAPP_ID, slot_args)
+        if r != VERIFY_BUSY:
+            break
+        await asyncio.sleep(VERIFY_POLL_S)
+    if r != 0:
+        raise BenchError('bl_verifyApp failed ({0})'.format(r))
+    if has_boot_record(info):
+        await _check(link, 'bl_setActiveApp', _IDS.BL_SETACTIVEAPP_ID, slot_args)
+    # BootAction is the slot number (BOOT_APP_1 = 1), AppId the index
+    await _check(link, 'bl_setBootAction', _IDS.BL_SETBOOTACTION_ID, struct.pack('<B', app_id + 1))
+    await _check(link, 'bl_boot', _IDS.BL_BOOT_ID)
+
+def _wait_banner(port, banner, timeout):
+    """Read 'port' until 'banner' shows up; False if it doesn't within 'timeout'"""
+    seen = b''
+    deadline = time.monotonic() + timeout
+    port.timeout = 0.01
+    while time.monotonic() < deadline:
+        seen = (seen + port.read(256))[-4096:]
+        if banner in seen:
+            return True
+    return False
+
+def _payload_sizes(largest):
+    sizes = [1]
+    while sizes[-1] * 2 < largest:
+        sizes.append(sizes[-1] * 2)
+    return sizes + [largest]
+
+async def run(args, port, loop):
+    results = {}
+    link = Link(port, loop, retries=args.retries)
+    try:
+        info = await get_info(link)
+        if info is not None:
+            page_size, message_len = info.page_size, min(info.max_message_len, MESSAGE_LEN_MAX)
+        else:
+            page_size = args.page_size or await probe_page_size(link, PAGE_SIZES)
+            if page_size is None:
+                raise BenchError('page size not recognised; give it with -ps')
+            message_len = await probe_message_len(link)
+        chunk = message_len - WRITE_PAGE_BUFFER_OVERHEAD
+        log('{0} byte pages, {1} byte requests'.format(page_size, message_len))
+
+        results['rtt.bl_ping'] = await bench_ping(link, args.samples)
+        for size in _payload_sizes(min(chunk, page_size)):
+            results['rtt.bl_writePageBuffer.{0}'.format(size)] = \
+                await bench_write_page_buffer(link, size, page_size, args.samples)
+        log('Request round trips done')
+
+        results['rtt.bl_eraseApp'] = await bench_erase_app(link, args.app_id, args.erase_samples)
+        results['rtt.bl_writePage'] = await bench_write_page(link, args.app_id, page_size, chunk, args.page_samples)
+        log('Flash round trips done')
+
+        if args.write:
+            with open(args.write, 'rb') as f:
+                header, _, binf = bootloader.image.unpack_image(f.read())
+            header = header.pack() if header is not None else None
+        else:
+            rng = random.Random(0)
+            binf, header = bytes(rng.getrandbits(8) for _ in range(args.upload_size)), None
+        slot_args, results['upload.bytes_per_s'] = await bench_upload(link, args.app_id, binf, header, page_size, chunk)
+        log('Upload: {0:.0f} B/s'.format(results['upload.bytes_per_s']['value']))
+
+        if args.boot and (args.write or args.sim):
+            start = time.monotonic()
+            await bench_boot(link, args.app_id, slot_args, info)
+            link.close()
+            link = None
+            if args.boot_banner and not _wait_banner(port, args.boot_banner.encode(), args.boot_timeout):
+                raise BenchError('the application didn\'t print {0!r} within {1} s'.format(args.boot_banner, args.boot_timeout))
+            results['boot.time_to_boot'] = {'unit': 'ms', 'better': 'lower',
+                'value': (time.monotonic() - start) * 1000.0, 'banner': args.boot_banner}
+    finally:
+        if link is not None:
+            link.close()
+
+    return page_size, message_len, info, results
+
+def log(message):
+    print(message, file=sys.stderr)
+
+def compare(baseline, current, threshold):
+    """(rows, regressions): a row per metric in either run and the names of
+    those more than 'threshold' percent worse than the baseline"""
+    if baseline.get('format') != current.get('format'):
+        raise BenchError('results are of different formats ({0}, {1})'.format(baseline.get('format'), current.get('format')))
+
+    rows = []
+    regressions = []
+    names = list(current['metrics']) + [n for n in baseline['metrics'] if n not in current['metrics']]
+    for name in names:
+        old = baseline['metrics'].get(name)
+        new = current['metrics'].get(name)
+        if old is None or new is None:
+            rows.append((name, old and old['value'], new and new['value'], None, 'new' if old is None else 'missing'))
+            continue
+
+        change = (new['value'] - old['value']) / old['value'] * 100.0 if old['value'] else 0.0
+        worse = change if new['better'] == 'lower' else -change
+        if new['unit'] == 'ms' and abs(new['value'] - old['value']) < MIN_DELTA_MS:
+            worse = 0.0
+
+        if worse > threshold:
+            note = 'REGRESSION'
+            regressions.append(name)
+        elif worse < -threshold:
+            note = 'improved'
+        else:
+            note = ''
+        rows.append((name, old['value'], new['value'], change, note))
+
+    return rows, regressions
+
+def setup_changes(baseline, current):
+    """What the two runs were measured on that isn't the same"""
+    return ['{0} {1} -> {2}'.format(key, baseline.get(key), current.get(key))
+            for key in ('device', 'baud_rate', 'page_size', 'message_len') if baseline.get(key) != current.get(key)]
+
+def print_comparison(rows, out=print):
+    width = max([len('metric')] + [len(r[0]) for r in rows])
+    out('{0:<{w}}  {1:>12}  {2:>12}  {3:>8}'.format('metric', 'baseline', 'current', 'change', w=width))
+    for name, old, new, change, note in rows:
+        out('{0:<{w}}  {1:>12}  {2:>12}  {3:>8}  {4}'.format(name,
+            '-' if old is None else '{0:.3f}'.format(old), '-' if new is None else '{0:.3f}'.format(new),
+            '' if change is None else '{0:+.1f}%'.format(change), note, w=width).rstrip())
+
+def _load(path):
+    with open(path) as f:
+        return json.load(f)
+
+def main():
+    parser = argparse.ArgumentParser(description='Bootloader latency / throughput benchmark')
+    parser.add_argument('-d', '--device', dest='device',
+                        help='Serial port of the board')
+    parser.add_argument('--sim', dest='sim', action='store_true',
+                        help='Run against a simulated device (blsim.py) instead of a board')
+    parser.add_argument('-br', '--baud', dest='baud_rate', type=int, default=38400,
+                        help='Baud rate (default 38400, the V71\'s; RH71 is 19200)')
+    parser.add_argument('-ps', '--page-size', dest='page_size', type=int,
+                        help='Page size for a device without bl_getInfo (probed otherwise); the simulator\'s (default 512)')
+    parser.add_argument('-a', '--app', dest='app', type=int, default=2, choices=[1, 2],
+                        help='Slot to erase and write (default 2)')
+    parser.add_argument('-w', '--write', dest='write',
+                        help='Image to upload (raw binary or imgpack.py image) instead of random data; needed to boot a board')
+    parser.add_argument('-n', '--samples', dest='samples', type=int, default=50,
+                        help='Round trips per RAM-only request (default 50)')
+    parser.add_argument('--erase-samples', dest='erase_samples', type=int, default=3,
+                        help='bl_eraseApp round trips (default 3)')
+    parser.add_argument('--page-samples', dest='page_samples', type=int, default=16,
+                        help='bl_writePage round trips (default 16)')
+    parser.add_argument('--upload-size', dest='upload_size', type=int, default=16384,
+                        help='Bytes of random data to upload without -w (default 16384)')
+    parser.add_argument('--no-boot', dest='boot', action='store_false',
+                        help='Don\'t measure the time to boot')
+    parser.add_argument('--boot-banner', dest='boot_banner',
+                        help='Text the application prints when it\'s up; time to boot runs until it\'s seen')
+    parser.add_argument('--boot-timeout', dest='boot_timeout', type=float, default=10.0,
+                        help='Seconds to wait for --boot-banner (default 10)')
+    parser.add_argument('-r', '--retries', dest='retries', type=int, default=5,
+                        help='Resends of a lost request before giving up (default 5)')
+    parser.add_argument('-o', '--output', dest='output',
+                        help='Write the results here (JSON) instead of to stdout')
+    parser.add_argument('--baseline', dest='baseline', metavar='FILE',
+                        help='Compare the results with an earlier run; exit 1 on a regression')
+    parser.add_argument('--compare', dest='compare', nargs=2, metavar=('BASELINE', 'CURRENT'),
+                        help='Compare two saved runs and exit; nothing is measured')
+    parser.add_argument('--threshold', dest='threshold', type=float, default=10.0,
+                        help='Percent a metric may get worse before it\'s flagged (default 10)')
+    args = parser.parse_args()
+    args.app_id = args.app - 1
+
+    if args.compare:
+        baseline, current = _load(args.compare[0]), _load(args.compare[1])
+        rows, regressions = compare(baseline, current, args.threshold)
+        for change in setup_changes(baseline, current):
+            print('NOTE: {0}'.format(change))
+        print_comparison(rows)
+        exit(1 if regressions else 0)
+
+    if not args.sim and not args.device:
+        parser.error('give a device (-d) or --sim')
+
+    loop = asyncio.new_event_loop()
+    sim = None
+    if args.sim:
+        # Served from this process's event loop, over a pty like a USB serial port
+        import blsim
+        sim = blsim.SimDevice(loop, args.page_size or 512, args.baud_rate)
+        device = sim.path
+    else:
+        device = args.device
+
+    port = serial.Serial(device, args.baud_rate, timeout=0)
+    try:
+        page_size, message_len, info, metrics = loop.run_until_complete(run(args, port, loop))
+    except (BenchError, bootloader.uploader.UploadError, asyncio.TimeoutError) as e:
+        log('Benchmark failed: {0}'.format(e))
+        exit(2)
+    finally:
+        port.close()
+        if sim is not None:
+            sim.close()
+        loop.close()
+
+    results = {
+        'format': FORMAT,
+        'date': datetime.datetime.now(datetime.timezone.utc).isoformat(timespec='seconds'),
+        'device': 'sim' if args.sim else args.device,
+        'baud_rate': args.baud_rate,
+        'page_size': page_size,
+        'message_len': message_len,
+        'info': vars(info) if info is not None else None,
+        'metrics': metrics,
+    }
+
+    text = json.dumps(results, indent=2)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+
+    if args.baseline:
+        baseline = _load(args.baseline)
+        rows, regressions = compare(baseline, results, args.threshold)
+        for change in setup_changes(baseline, results):
+            log('NOTE: {0}'.format(change))
+        print_comparison(rows, out=log)
+        exit(1 if regressions else 0)
+
+if __name__ == "__main__":
+    main()
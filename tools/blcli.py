@@ -3,8 +3,8 @@ import bootloader
 import argparse
 import zlib
 import math
-import hexdump as hd
 import time
+import atexit
 
 appId_mapping = {
     1: bootloader.common.AppId.APP_1,
@@ -29,11 +29,14 @@ board_configs = {
     }
 }
 
-def open_device(device, baud_rate, timeout, **kwargs):
+def open_device(device, baud_rate, timeout, frame_trace=None, **kwargs):
     print("Do a open device: " + str(device))
     # transport = bootloader.moon_transport.SerialTransport('loop://',38400,timeout=1)
     try:
         transport = bootloader.moon_transport.SerialTransport(device, baud_rate, timeout=timeout)
+        if frame_trace:
+            transport.trace = bootloader.frame_trace.FrameTrace(frame_trace)
+            atexit.register(transport.trace.close)
         clientManager = erpc.client.ClientManager(transport, bootloader.moon_codec.MoonCodec)
         bl_client = bootloader.client.BootloaderClient(clientManager)
     except:
@@ -42,132 +45,488 @@ def open_device(device, baud_rate, timeout, **kwargs):
 
     return bl_client
 
-def send_page(client, page, page_num, payload_size, **kwargs):
-    # Use declared frame decoder and serial objects; use global page size
-    PAYLOAD_SIZE = payload_size
+# Any character keeps a fast-booting device in the bootloader; 0x55 is used
+# because it's never mistaken for the start of a frame (0x5A 0x7E)
+CATCH_SYNC_CHAR = b'\x55'
 
-    r = range(0,len(page),PAYLOAD_SIZE)
-    for addr in r:
-        # Get chunk of page
-        start = addr
-        end = addr + PAYLOAD_SIZE
-        if end >= len(page):
-            end = len(page)
+def catch_device(client, seconds):
+    """Keep a fast-booting device in the bootloader.
 
-        chunk = page[start:end]
+    Sends sync characters back-to-back while the board is reset (reset it
+    during the wait) and returns once the bootloader answers a ping.
+    """
+    transport = client._clientManager.transport
+    port = transport._serial
 
-        # print()
-        # hd.hexdump(chunk)
-        # print()
-        # input('- Press enter to continue -')
-
-        # Attempt to send the packet until we get an ACK
-        err_cnt = 0
-        while True:
-            if err_cnt > 5:
-                print('Exceeded error count maximum (5)')
-                return (-1)
+    print('Catching device, reset the board now ({0} s)...'.format(seconds))
 
+    saved_timeout = port.timeout
+    port.timeout = 0.01
+    deadline = time.monotonic() + seconds
+    try:
+        while time.monotonic() < deadline:
+            # Fill the window with sync characters, then see if we're in
+            for _ in range(50):
+                port.write(CATCH_SYNC_CHAR * 8)
+            port.flush()
+            port.reset_input_buffer()
             try:
-                r = client.bl_writePageBuffer( addr, chunk )
-            except:
-                print('Error during transmission')
-                err_cnt = err_cnt + 1
-                time.sleep(0.1)
+                client.bl_ping()
+                print('Caught device')
+                return True
+            except Exception:
                 continue
+    finally:
+        port.timeout = saved_timeout
 
-            # Response should be [system,command,response]
-            # Just going to assume system and command match...
-            if (r != 0x00):
-                print('Error during page write')
-                err_cnt = err_cnt + 1
-                time.sleep(0.1)
-                continue
-            
-            print('Wrote {1} bytes to page_buffer @ {0:02x}'.format(addr, (end-start)))
-            break
-
-    return 0
+    print('Device was not caught')
+    return False
 
+def get_device_info(client):
+    """The device's DeviceInfo (bl_getInfo); None if its firmware predates
+    the method"""
+    info = erpc.Reference()
+    try:
+        r = client.bl_getInfo(info)
+    except erpc.client.RequestError:
+        return None
+    return info.value if r == 0 else None
+
+def print_device_info(info):
+    features = sorted((bit, name[len('FEATURE_'):]) for name, bit in vars(bootloader.common.Feature).items()
+                      if name.startswith('FEATURE_') and info.features & bit)
+    print('Info version {0}, codec version {1}'.format(info.info_version, info.codec_version))
+    print('Page size:  {0} bytes, erased {1} at a time'.format(info.page_size, info.erase_pages))
+    print('Requests:   up to {0} bytes'.format(info.max_message_len))
+    print('Baud rate:  {0}'.format(info.baud_rate))
+    print('APP_1:      {0:#010x}, {1:#x} bytes'.format(info.app1_start, info.app1_size))
+    print('APP_2:      {0:#010x}, {1:#x} bytes'.format(info.app2_start, info.app2_size))
+    print('Features:   {0}'.format(' '.join(name for bit, name in features) if features else '-'))
+
+def slot_layout(args, app_id):
+    """(address, size) of slot 'app_id': as the device reported it, else
+    from the board config"""
+    info = args.device_info
+    if info is not None:
+        if app_id == bootloader.common.AppId.APP_1:
+            return info.app1_start, info.app1_size
+        return info.app2_start, info.app2_size
+    return bootloader.image.slot_address(args.board, app_id), bootloader.image.APP_SIZE
+
+def probe_device(client, args, page_size=True):
+    """Longest request the device takes (bootloader.uploader.probe); sets
+    args.device_info. With page_size, also sets args.page_size (unless given
+    with -ps) to the device's; the board config's is the fallback for
+    firmware that can't say and doesn't probe as either board."""
+    manager = client._clientManager
+    if not page_size:
+        sizes = []
+    elif args.page_size:
+        sizes = [args.page_size]
+    else:
+        sizes = sorted(set(config['page_size'] for config in board_configs.values()))
+
+    manager._sequence, found, message_len, args.device_info = bootloader.uploader.probe(
+        manager.transport._serial, sizes, sequence=manager._sequence, trace=manager.transport.trace)
+
+    if args.device_info is None:
+        print('Device predates bl_getInfo; probed it')
+    elif page_size and args.page_size and args.page_size != found:
+        print('WARNING: the device has {0} byte pages; using {1} (-ps)'.format(found, args.page_size))
+        found = args.page_size
+
+    if page_size and found is None:
+        found = board_configs[args.board]['page_size']
+        print('Page size not recognised; using the {0} default of {1} bytes'.format(args.board, found))
+    if page_size:
+        args.page_size = found
+        if manager.transport.trace is not None:
+            manager.transport.trace.page_size = found
+
+    print('Device takes {0} byte requests{1}'.format(message_len,
+        '; {0} byte pages'.format(args.page_size) if page_size else ''))
+    return message_len
+
+def chunk_size(args, message_len, overhead):
+    """Largest chunk of data in a request of 'overhead' bytes of header and
+    arguments: what the device takes, capped by --payload-size"""
+    size = message_len - overhead
+    return min(size, args.payload_size) if args.payload_size else size
+
+def write_segments(client, app_id, segments, chunk_size):
+    """Write (offset, data) segments into a slot with bl_writeAddress (see
+    bootloader.uploader.write_address); the slot has to be erased under them"""
+    manager = client._clientManager
+    manager._sequence, link_stats = bootloader.uploader.write_segments(
+        manager.transport._serial, app_id, segments, chunk_size, sequence=manager._sequence,
+        trace=manager.transport.trace)
+    return link_stats
+
+
+def print_stats(client, reset=False):
+    stats = erpc.Reference()
+    r = client.bl_getStats(reset, stats)
+    if r != 0:
+        raise Exception('Failed to read statistics ({0})'.format(r))
+
+    print('Device statistics{0}:'.format(' (reset)' if reset else ''))
+    for name, value in vars(stats.value).items():
+        print('  {0:<22} {1}'.format(name, value))
+
+def verify_app(client, app_id, length, crc, timeout=30):
+    """Have the device CRC the slot; returns True if it matches."""
+    deadline = time.monotonic() + timeout
+    while time.monotonic() < deadline:
+        r = client.bl_verifyApp(app_id, length, crc)
+        if r != 1:
+            return r == 0
+        time.sleep(0.01)
+
+    raise Exception('Timed out waiting for the device to verify the slot')
+
+def print_boot_record(client):
+    record = erpc.Reference()
+    r = client.bl_getBootRecord(record)
+    rec = record.value
+    if r != 0:
+        print('No boot record on the device')
+        return
+
+    if rec.max_attempts:
+        print('Boot record: active APP_{0}, {1} of {2} unconfirmed boot attempts'.format(rec.active + 1, rec.attempts, rec.max_attempts))
+    else:
+        print('Boot record: active APP_{0}, boot attempts not counted'.format(rec.active + 1))
+    for n, (length, crc) in enumerate([(rec.app1_length, rec.app1_crc), (rec.app2_length, rec.app2_crc)]):
+        if length == 0xFFFFFFFF:
+            print('  APP_{0}: (not described)'.format(n + 1))
+        else:
+            print('  APP_{0}: {1} bytes crc {2:08X}{3}'.format(n + 1, length, crc, ' (verified)' if rec.verified & (1 << n) else ''))
 
-def main(args):
-    print("do main stuff with these args: " + str(args))
-    # do argument checking here
+# Slot size (flash.c PARTITION_APP_SIZE)
+APP_SLOT_SIZE = 0xE000
 
-    bl_client = open_device(**vars(args))
+def dump_app(client, app_id, length, window=32, retries=5):
+    """Read the first length bytes of a slot with bl_readApp.
 
-    try:
-        print( bl_client.bl_ping() )
-    except:
-        print('Failed to ping, pre load')
-        raise
+    Each call streams up to 'window' frames; a lost frame just ends the window
+    early and the next call picks up from the first missing byte.
+    """
+    data = bytearray()
+    errors = 0
+    while len(data) < length:
+        try:
+            r, chunks = client.bl_readApp(app_id, len(data), length - len(data), window)
+        except Exception:
+            # The device only listens between windows; a request sent while it
+            # was still streaming is lost. The credit runs out, so try again.
+            r, chunks = 0, []
+
+        if r != 0:
+            raise Exception('Device rejected the readback ({0})'.format(r))
+
+        # Only keep data that continues where we are
+        progress = False
+        for offset, chunk in chunks:
+            if offset != len(data):
+                break
+            data += chunk
+            progress = True
+
+        if progress:
+            errors = 0
+        else:
+            errors += 1
+            if errors > retries:
+                raise Exception('Readback stalled at offset {0}'.format(len(data)))
+
+    return bytes(data[:length])
+
+copy_states = ['idle', 'erasing', 'programming', 'done', 'failed']
+
+def copy_app(client, src, dst, timeout=120):
+    """Copy the image described by the boot record in slot src to slot dst on
+    the device and make dst the active slot."""
+    record = erpc.Reference()
+    if client.bl_getBootRecord(record) != 0:
+        raise Exception('No boot record; the source image length and CRC are unknown')
+
+    rec = record.value
+    length, crc = [(rec.app1_length, rec.app1_crc), (rec.app2_length, rec.app2_crc)][src]
+    if length == 0xFFFFFFFF:
+        raise Exception('The boot record doesn\'t describe APP_{0}'.format(src + 1))
+
+    start = time.monotonic()
+    deadline = start + timeout
+    while True:
+        r = client.bl_copyApp(src, dst, length)
+        status = erpc.Reference()
+        client.bl_getCopyStatus(status)
+        s = status.value
+        print('Copy APP_{0} -> APP_{1}: {2} page {3}/{4} (erased {5}, programmed {6}, skipped {7})'.format(
+            src + 1, dst + 1, copy_states[s.state] if s.state < len(copy_states) else s.state,
+            s.page, s.pages, s.erased, s.programmed, s.skipped))
 
-    # -- Flash the blinky program -- #
+        if r == 0:
+            break
+        if r == -1:
+            raise Exception('Device rejected the copy')
+        if r == -2:
+            # Calling again resumes; give up only on the timeout
+            print('Copy failed (flash error {0}), resuming'.format(s.error))
+        if time.monotonic() > deadline:
+            raise Exception('Timed out waiting for the copy')
+        time.sleep(0.05)
+
+    print('Copied {0} bytes in {1:.1f} s'.format(length, time.monotonic() - start))
+
+    r = client.bl_setActiveApp(dst, length, crc)
+    if r != 0:
+        raise Exception('Failed to set the active slot ({0})'.format(r))
+    print('APP_{0} is now the active slot'.format(dst + 1))
+
+trace_stage_names = ['decode', 'dispatch', 'encode', 'transmit']
+
+def resume_page(client, app_id, length, crc):
+    """First page to write to resume an upload of this image to app_id, or
+    None if the device has no matching session"""
+    session = erpc.Reference()
+    if client.bl_getUploadSession(session) != 0:
+        return None
+
+    s = session.value
+    if s.app_id != app_id or s.length != length or s.crc != crc:
+        print('Upload session on the device is for another image: {0}'.format(s))
+        return None
+
+    return s.committed
+
+def print_trace(client, reset=False):
+    rows = []
+    index = 0
+    while True:
+        entry = erpc.Reference()
+        if client.bl_getTrace(index, entry) != 0:
+            break
+        rows.append(entry.value)
+        index += 1
+
+    if not rows:
+        print('No trace data (is CONFIG_TRACE enabled?)')
+        return
+
+    # Report in microseconds
+    print('{0:<24} {1:>8} {2:>10} {3:>10} {4:>10} {5:>12}'.format('stage / method', 'count', 'min us', 'avg us', 'max us', 'total us'))
+    for e in rows:
+        if e.kind == bootloader.common.TraceKind.TRACE_STAGE:
+            name = trace_stage_names[e.id] if e.id < len(trace_stage_names) else 'stage {0}'.format(e.id)
+        else:
+            name = 'service {0} method {1}'.format(e.id, e.method)
+
+        us = 1e6 / e.timebase_hz
+        avg = (e.sum / e.count) if e.count else 0
+        print('{0:<24} {1:>8} {2:>10.1f} {3:>10.1f} {4:>10.1f} {5:>12.1f}'.format(name, e.count, e.min * us, avg * us, e.max * us, e.sum * us))
+
+    if reset:
+        client.bl_resetTrace()
+        print('(trace reset)')
+
+def check_page_crcs(binf, pages, page_crcs, page_size):
+    for p in pages:
+        page = binf[p * page_size:(p + 1) * page_size]
+        if bootloader.moon_transport.crc_32(page + b'\xFF' * (page_size - len(page))) != page_crcs[p]:
+            raise Exception('Page {0} does not match the image page CRC table'.format(p))
+
+def load_image(args):
+    """The file given with -w as a slot image: (header, page_crcs, binf,
+    data_pages, image_crc); header / page_crcs are None unless it's a packed
+    image"""
     with open(args.write, 'rb') as f:
-        binf = f.read()
+        data = f.read()
+
+    # ELF / HEX files are flattened into the slot (gaps left erased); anything
+    # else is an image (imgpack.py) or a raw binary
+    segments = bootloader.segments.load(data)
+    if segments is not None:
+        header, page_crcs = None, None
+        slot_address, slot_size = slot_layout(args, appId_mapping[args.app])
+        binf = bootloader.segments.to_slot(segments, slot_address, slot_size)
+        print('{0} loadable segments'.format(len(segments)))
+    else:
+        header, page_crcs, binf = bootloader.image.unpack_image(data)
 
     # Calculate number of pages to write
     binf_size = len(binf)
     print('binf_size = ' + str(binf_size))
     page_cnt = math.ceil(binf_size / args.page_size)
 
-    # Erase APP_1
-    try:
-        bl_client.bl_eraseApp( appId_mapping[args.app] )
-        print('Flash erased successfully')
-    except:
-        print('Failed to erase flash')
-        raise
+    # Pages that are all FF are already right in the erased slot
+    data_pages = bootloader.segments.data_pages(binf, args.page_size)
+    print('{0} of {1} pages hold data'.format(len(data_pages), page_cnt))
+
+    image_crc = header.crc if header is not None else bootloader.moon_transport.crc_32(binf)
+
+    return header, page_crcs, binf, data_pages, image_crc
+
+def fleet_main(args):
+    """Flash the file given with -w to every device in --fleet at once"""
+    devices = bootloader.fleet.expand(args.fleet)
+    if not devices:
+        print('No devices match {0}'.format(' '.join(args.fleet)))
+        exit(1)
 
-    f = open(args.write, 'rb')
-    chunk = f.read(args.page_size)
+    # The image is split into pages once for all of them; each device's
+    # request length is probed and its chunk size tuned on its own
+    args.page_size = args.page_size or board_configs[args.board]['page_size']
 
-    # Write and commit pages one at a time
-    for p in range(0, page_cnt):
-        # Erase the page buffer
-        bl_client.bl_erasePageBuffer()
+    header, page_crcs, binf, data_pages, image_crc = load_image(args)
+    if page_crcs is not None:
+        check_page_crcs(binf, data_pages, page_crcs, args.page_size)
+
+    print('Flashing APP_{0} on {1} devices'.format(args.app, len(devices)))
+    results = bootloader.fleet.flash_all(devices, args.baud_rate, appId_mapping[args.app], binf, data_pages,
+        args.page_size, image_crc, header=header.pack() if header is not None else None,
+        chunk_size=args.payload_size, boot=args.do_boot,
+        on_done=lambda r: print('{0}: {1} in {2:.1f} s'.format(r.device, 'done' if r.ok else 'FAILED', r.seconds)))
+
+    print()
+    bootloader.fleet.print_summary(results)
+    exit(0 if all(r.ok for r in results) else 1)
+
+def main(args):
+    print("do main stuff with these args: " + str(args))
+    # do argument checking here
 
-        print('Writing page {0} ({2}) of {1}'.format((p + 1), page_cnt, p))
-        # Calculate start and end indices
-        start = p * args.page_size
-        end = start + args.page_size
-        if end >= binf_size:
-            end = binf_size
+    if args.fleet:
+        fleet_main(args)
 
-        # Slice the binary file into a page
-        page = binf[start:end]
+    bl_client = open_device(**vars(args))
 
-        # DEBUG: Print the page contents
-        print()
-        hd.hexdump(page)
-        print()
+    if args.catch and not catch_device(bl_client, args.catch):
+        exit(1)
 
-        # Send the page
-        r = send_page( bl_client, page, p, **vars(args) )
-        
-        # Ignoring return for now
-        print(r)
+    try:
+        print( bl_client.bl_ping() )
+    except:
+        print('Failed to ping, pre load')
+        raise
 
-        # Pad page out to args.page_size if necessary (for CRC calculation)
-        if len(page) < args.page_size:
-            page = page + b'\xFF' * (args.page_size - len(page))
+    if args.info:
+        info = get_device_info(bl_client)
+        if info is None:
+            print('The device\'s firmware predates bl_getInfo')
+            exit(1)
+        print_device_info(info)
+        exit(0)
+
+    if args.stats or args.reset_stats:
+        print_stats(bl_client, args.reset_stats)
+        exit(0)
+
+    if args.trace or args.reset_trace:
+        print_trace(bl_client, args.reset_trace)
+        exit(0)
+
+    if args.boot_record:
+        print_boot_record(bl_client)
+        exit(0)
+
+    if args.copy_from:
+        if args.copy_from == args.app:
+            raise Exception('--copy-from and -a name the same slot')
+        copy_app(bl_client, appId_mapping[args.copy_from], appId_mapping[args.app])
+        exit(0)
+
+    if args.dump:
+        start = time.monotonic()
+        data = dump_app(bl_client, appId_mapping[args.app], args.dump_length)
+        elapsed = time.monotonic() - start
+        with open(args.dump, 'wb') as f:
+            f.write(data)
+        print('Read {0} bytes of APP_{1} to {2} in {3:.1f} s ({4:.0f} B/s)'.format(len(data), args.app, args.dump, elapsed, len(data) / elapsed))
+        exit(0)
+
+    if args.write_at is not None:
+        with open(args.write, 'rb') as f:
+            data = f.read()
+        message_len = probe_device(bl_client, args, page_size=False)
+        link_stats = write_segments(bl_client, appId_mapping[args.app], [(args.write_at, data)],
+            chunk_size(args, message_len, bootloader.uploader.WRITE_ADDRESS_OVERHEAD))
+        print('Wrote {0} bytes to APP_{1} at {2:#x} ({3} frames, {4} resent; chunks down to {5} bytes)'.format(
+            len(data), args.app, args.write_at, link_stats['sent'], link_stats['resent'], link_stats['smallest_chunk']))
+        exit(0)
 
-        # Calculate page CRC
-        crc = bootloader.moon_transport.crc_32(page)
+    # -- Flash the blinky program -- #
+    message_len = probe_device(bl_client, args)
+    header, page_crcs, binf, data_pages, image_crc = load_image(args)
+    binf_size = len(binf)
+    page_cnt = math.ceil(binf_size / args.page_size)
 
-        # Write the page
+    if args.verify:
+        ok = verify_app(bl_client, appId_mapping[args.app], binf_size, image_crc)
+        print('APP_{0} {1} {2}'.format(args.app, 'matches' if ok else 'does NOT match', args.write))
+        exit(0 if ok else 1)
+
+    # Packed images (imgpack.py) are checked by the device before anything is
+    # erased; raw binaries are written as they are
+    if header is not None:
+        print(header)
+        r = bl_client.bl_checkImage( appId_mapping[args.app], header.pack() )
+        if r != 0:
+            raise Exception('Device rejected the image: {0}'.format(bootloader.image.IMAGE_ERRORS.get(r, r)))
+
+    # Pick up an interrupted upload of the same image where the device's
+    # checkpoint left off; otherwise erase the slot and start a new session
+    first_page = None
+    if not args.restart:
+        first_page = resume_page(bl_client, appId_mapping[args.app], binf_size, image_crc)
+
+    if first_page is not None:
+        print('Resuming upload at page {0} of {1}'.format(first_page, page_cnt))
+    else:
+        first_page = 0
         try:
-            print('Writing page {0} with crc {1:X}'.format(p, crc))
-            r = bl_client.bl_writePage( appId_mapping[args.app], p, crc )
-            print(r)
+            r = bl_client.bl_beginUpload( appId_mapping[args.app], binf_size, image_crc )
         except:
-            print('Comm failure while writing page')
+            print('Failed to erase flash')
             raise
+        if r != 0:
+            raise Exception('Failed to start the upload ({0})'.format(r))
+        print('Flash erased successfully')
+
+    pages = [p for p in data_pages if p >= first_page]
+
+    # Packed images carry a CRC per page; catch a mismatch before sending
+    if page_crcs is not None:
+        check_page_crcs(binf, pages, page_crcs, args.page_size)
+
+    # Requests for the next page are queued behind the current page's commit
+    manager = bl_client._clientManager
+    start = time.monotonic()
+    manager._sequence, link_stats = bootloader.uploader.upload_pages(
+        manager.transport._serial, appId_mapping[args.app], binf, pages, args.page_size,
+        chunk_size(args, message_len, bootloader.uploader.WRITE_PAGE_BUFFER_OVERHEAD), sequence=manager._sequence,
+        trace=manager.transport.trace)
+    elapsed = time.monotonic() - start
+    print('Wrote {0} pages in {1:.1f} s ({2:.1f} KB/s; {3} frames, {4} resent; chunks down to {5} bytes)'.format(
+        len(pages), elapsed, len(pages) * args.page_size / 1024 / max(elapsed, 1e-6),
+        link_stats['sent'], link_stats['resent'], link_stats['smallest_chunk']))
+
+    # One device-side CRC of the whole image instead of reading it back
+    if verify_app(bl_client, appId_mapping[args.app], binf_size, image_crc):
+        print('APP_{0} verified'.format(args.app))
+    elif first_page > 0:
+        raise Exception('APP_{0} does not match the image after resuming; run again with --restart'.format(args.app))
+    else:
+        raise Exception('APP_{0} does not match the image after writing'.format(args.app))
 
+    # Record the image in the boot record; the device boots this slot from now on.
+    # Without a record the boot slot is fixed by the device's configuration.
+    if bootloader.uploader.has_boot_record(args.device_info):
+        r = bl_client.bl_setActiveApp( appId_mapping[args.app], binf_size, image_crc )
         if r == 0:
-            print('Page written to flash successfully')
+            print('APP_{0} is now the active slot'.format(args.app))
         else:
-            raise Exception('Page write failure')
+            raise Exception('Failed to set the active slot ({0})'.format(r))
 
     if args.do_boot:
         try:
@@ -190,14 +549,44 @@ if __name__ == "__main__":
     parser = argparse.ArgumentParser(description='Does commandline interfacing for the bootloader')
     parser.add_argument('-d', '--device', dest='device', default='/dev/serial/by-id/usb-Atmel_Corp._EDBG_CMSIS-DAP_ATML2407131800003232-if01',
                         help='Which device to interface with, ex /dev/serial/by-id/...')
+    parser.add_argument('--fleet', dest='fleet', nargs='+', metavar='DEVICE',
+                        help='Flash the file given with -w to all of these devices at once (paths or globs, ex \'/dev/serial/by-id/*\') and print a summary')
     parser.add_argument('-w', '--write', dest='write', default='../bin/blink.bin',
-                        help='File to write, ex /path/to/rickroll.bin')
+                        help='File to write, ex /path/to/rickroll.bin (ELF, Intel HEX, an imgpack.py image or a raw binary; only pages holding data are sent)')
     parser.add_argument('-a', '--app', dest='app', type=int, default=1, choices=[1, 2],
                         help='Application id of what to boot, ex 1 = APP_1, 2 = APP_2, etc.')
-    parser.add_argument('-pls', '--payload-size', dest='payload_size', default=32, type=int,
-                        help='Size of payload/chunk to write pages by in bytes, 32 seems to be a magical number here')
+    parser.add_argument('-pls', '--payload-size', dest='payload_size', type=int,
+                        help='Largest chunk of data per write request in bytes (default: as much as the device takes in one request, probed); chunks are made smaller while the link loses frames and grow back once it\'s clean')
     parser.add_argument('--no-boot', dest='do_boot', action='store_false',
                         help='Don\'t boot the application after loading it')
+    parser.add_argument('--catch', dest='catch', type=float, default=0, metavar='SECONDS',
+                        help='Send sync characters for up to SECONDS while the board is reset so a fast-booting device stays in the bootloader')
+    parser.add_argument('--write-at', dest='write_at', type=lambda x: int(x, 0), metavar='OFFSET',
+                        help='Write the file given with -w as-is at OFFSET in the slot (bl_writeAddress; the slot must be erased there) and exit')
+    parser.add_argument('--restart', dest='restart', action='store_true',
+                        help='Erase the slot and start the upload over instead of resuming an interrupted one')
+    parser.add_argument('--verify', dest='verify', action='store_true',
+                        help='Check that the slot holds the file given with -w (device-side CRC) and exit; nothing is written')
+    parser.add_argument('--copy-from', dest='copy_from', type=int, choices=[1, 2],
+                        help='Copy the image in this slot (as described by the boot record) to the slot given with -a on the device, make it active and exit')
+    parser.add_argument('--dump', dest='dump', metavar='FILE',
+                        help='Read the slot given with -a back into FILE and exit; nothing is written')
+    parser.add_argument('--dump-length', dest='dump_length', type=lambda x: int(x, 0), default=APP_SLOT_SIZE,
+                        help='Number of bytes to read with --dump (default: the whole slot, {0:#x})'.format(APP_SLOT_SIZE))
+    parser.add_argument('--boot-record', dest='boot_record', action='store_true',
+                        help='Print the persistent boot record (active slot, image CRCs, boot attempts) and exit')
+    parser.add_argument('--info', dest='info', action='store_true',
+                        help='Print what the device reports about itself (page size, slots, request length, build options) and exit')
+    parser.add_argument('--stats', dest='stats', action='store_true',
+                        help='Print the device link-layer / server statistics and exit (nothing is written)')
+    parser.add_argument('--reset-stats', dest='reset_stats', action='store_true',
+                        help='Same as --stats but also clears the counters on the device')
+    parser.add_argument('--trace', dest='trace', action='store_true',
+                        help='Print the per-stage / per-method latency report and exit (requires CONFIG_TRACE)')
+    parser.add_argument('--reset-trace', dest='reset_trace', action='store_true',
+                        help='Same as --trace but also clears the histograms on the device')
+    parser.add_argument('--frame-trace', dest='frame_trace', metavar='FILE',
+                        help='Record every frame sent and received to FILE (replay it with tools/host/blreplay)')
 
     bc = parser.add_argument_group('board configs', 'choose board config from the following. defaults to v71.').add_mutually_exclusive_group()
     bc.add_argument('-v71', '--v71', action='store_const', dest='board', const='v71')
@@ -206,7 +595,8 @@ if __name__ == "__main__":
     bco = parser.add_argument_group('board config overrides')
     bco.add_argument('-ps', '--page-size', dest='page_size', type=int,
                         help='''Size of page in bytes. 
-                        NOTE: defaults for V71 is {0} bytes, RH71 is {1} bytes.'''\
+                        NOTE: probed from the device when writing; the fallback (and
+                        the --fleet page size) for V71 is {0} bytes, RH71 is {1} bytes.'''\
                         .format(board_configs['v71']['page_size'], 
                             board_configs['rh71']['page_size']))
     bco.add_argument('-br', '--baud', dest='baud_rate', type=int,
@@ -227,7 +617,8 @@ if __name__ == "__main__":
     args.board = args.board or 'v71'
 
     # always use board overrides if supplied
-    args.page_size = args.page_size or (board_configs[args.board]['page_size']) 
+    # The page size and slot layout come from the device (see probe_device)
+    args.device_info = None
     args.baud_rate = args.baud_rate or (board_configs[args.board]['baud_rate'])
     args.timeout = args.timeout or (board_configs[args.board]['timeout'])
 
@@ -0,0 +1,355 @@
+"""Simulated bootloaders on local ptys, for trying blcli.py (fleet mode in
+particular) without boards.
+
+Each simulated device serves the upload path of the bootloader service
+(ping, bl_getInfo, the page buffer, bl_writePage, bl_writeAddress,
+bl_eraseApp, bl_beginUpload, bl_checkImage, bl_verifyApp, bl_setActiveApp,
+bl_setBootAction, bl_boot) from a RAM copy of one slot; anything else is
+answered NO_METHOD. Like the real one it handles a frame at a time and
+loses what arrives while it's busy.
+
+Between the pty and the device sits a simulated serial link (a Wire each
+way): bytes arrive when they'd have made it over the wire at the baud rate
+(or --bandwidth), plus --latency, and on the way they can be hit by bit
+errors, dropped bytes and bursts of garbage (a two-state Gilbert-Elliott
+model: --burst-rate bursts start per byte, --burst-len bytes long on
+average). linksim.py runs uploads through it and measures what gets through.
+
+    $ python3 blsim.py -n 4
+    /dev/pts/5
+    ...
+    $ python3 blcli.py --fleet /dev/pts/5 /dev/pts/6 ... -w blink.bin
+"""
+
+import argparse
+import asyncio
+import os
+import pty
+import random
+import struct
+import sys
+import tty
+import zlib
+
+import bootloader
+from bootloader.moon_transport import FRAME_MAX_PAYLOD_LEN, FrameDecoder, InvalidFrame, encode_frame
+
+_IDS = bootloader.interface.IBootloader
+
+SLOT_SIZE = 0x40000
+
+# Response protocol field (header bits 20-23)
+PROTOCOL_NO_METHOD = 2
+
+# _handle(): the method isn't served
+NO_METHOD = object()
+
+class LinkParams(object):
+    """Faults and limits of the simulated link, the same both ways. 'ber' is
+    per bit, 'byte_drop' per byte; 'bandwidth' (bytes/s) caps what the baud
+    rate allows."""
+
+    def __init__(self, ber=0.0, byte_drop=0.0, burst_rate=0.0, burst_len=8.0, latency=0.0, bandwidth=None):
+        self.ber = ber
+        self.byte_drop = byte_drop
+        self.burst_rate = burst_rate
+        self.burst_len = burst_len
+        self.latency = latency
+        self.bandwidth = bandwidth
+
+class Wire(object):
+    """One direction of the link. send() hands bytes to 'deliver' once the
+    last of them is through: after the ones ahead of them, their own time on
+    the wire and the latency. Faults are decided as the bytes go in."""
+
+    def __init__(self, loop, deliver, byte_time, params, rng):
+        self.loop = loop
+        self.deliver = deliver
+        self.byte_time = byte_time
+        self.params = params
+        self.rng = rng
+        # When the last byte sent so far has left the sender
+        self.free_at = 0.0
+        self.dead_until = 0.0
+        self._burst = False
+        # P(a byte has at least one bit flipped)
+        self._byte_error = 1.0 - (1.0 - params.ber) ** 8
+
+        self.bytes = 0
+        self.flipped = 0
+        self.dropped = 0
+        self.garbled = 0
+
+    def cut(self, seconds):
+        """Nothing gets through for 'seconds' from now"""
+        self.dead_until = self.loop.time() + seconds
+
+    def send(self, data):
+        start = max(self.loop.time(), self.free_at)
+        self.free_at = start + len(data) * self.byte_time
+        self.bytes += len(data)
+        if start < self.dead_until:
+            self.dropped += len(data)
+            return
+        self.loop.call_at(self.free_at + self.params.latency, self.deliver, self._faults(data))
+
+    def _faults(self, data):
+        params = self.params
+        if not (params.ber or params.byte_drop or params.burst_rate):
+            return data
+
+        rng = self.rng
+        out = bytearray()
+        for byte in data:
+            # Gilbert-Elliott: a burst starts with burst_rate per byte and
+            # ends with 1 / burst_len; bytes in one are garbage
+            if self._burst:
+                self._burst = rng.random() >= 1.0 / params.burst_len
+            elif params.burst_rate:
+                self._burst = rng.random() < params.burst_rate
+
+            if self._burst:
+                byte = rng.getrandbits(8)
+                self.garbled += 1
+            elif params.ber and rng.random() < self._byte_error:
+                byte ^= 1 << rng.randrange(8)
+                self.flipped += 1
+
+            if params.byte_drop and rng.random() < params.byte_drop:
+                self.dropped += 1
+                continue
+            out.append(byte)
+        return bytes(out)
+
+class SimDevice(object):
+    def __init__(self, loop, page_size, baud_rate, drop=0.0, mute=False, seed=0,
+                 max_message=FRAME_MAX_PAYLOD_LEN, info=True, link=None):
+        self.loop = loop
+        self.page_size = page_size
+        self.drop = drop
+        self.max_message = max_message
+        self.mute = mute
+        self.info = info
+        self.baud_rate = baud_rate
+        self.rng = random.Random(seed)
+
+        self.master, self._slave = pty.openpty()
+        tty.setraw(self.master)
+        tty.setraw(self._slave)
+        os.set_blocking(self.master, False)
+        self.path = os.ttyname(self._slave)
+
+        self.slot = bytearray(b'\xFF' * SLOT_SIZE)
+        self.page_buffer = bytearray(b'\xFF' * page_size)
+        self.active = None
+        self.boot_action = 0
+        self.booted = False
+
+        self.requests = 0
+        self.dropped = 0
+
+        link = link or LinkParams()
+        byte_time = 10.0 / baud_rate # 8N1
+        if link.bandwidth:
+            byte_time = max(byte_time, 1.0 / link.bandwidth)
+        self.rx = Wire(loop, self._on_received, byte_time, link, random.Random((seed << 1) | 1))
+        self.tx = Wire(loop, self._write, byte_time, link, random.Random(seed << 1))
+
+        self._decoder = FrameDecoder()
+        self._busy_until = 0.0
+        loop.add_reader(self.master, self._on_readable)
+
+    def cut(self, seconds):
+        """Take the link down both ways for 'seconds'"""
+        self.rx.cut(seconds)
+        self.tx.cut(seconds)
+
+    def close(self):
+        self.loop.remove_reader(self.master)
+        os.close(self.master)
+        os.close(self._slave)
+
+    def _on_readable(self):
+        try:
+            data = os.read(self.master, 4096)
+        except OSError:
+            return
+        self.rx.send(data)
+
+    def _on_received(self, data):
+        # Received while handling a request: overrun, the frame is lost
+        if self.loop.time() < self._busy_until:
+            self._decoder = FrameDecoder()
+            self.dropped += 1
+            return
+
+        self._decoder.feed(data)
+        while True:
+            try:
+                payload = self._decoder.decode()
+            except InvalidFrame:
+                continue
+            if payload is None:
+                return
+            self._on_request(bytes(payload))
+
+    def _on_request(self, request):
+        if self.mute:
+            return
+        # Longer than the receive buffer: dropped unanswered
+        if len(request) > self.max_message:
+            return
+        if self.rng.random() < self.drop:
+            self.dropped += 1
+            return
+
+        self.requests += 1
+        header = request[0] | (request[1] << 8) | (request[2] << 16)
+        result = self._handle((header >> 7) & 0x3F, request)
+
+        if result is NO_METHOD:
+            response = request[:2] + bytes([request[2] | (PROTOCOL_NO_METHOD << 4)])
+        elif isinstance(result, bytes):
+            response = request[:3] + result
+        else:
+            response = request[:3] + (b'' if result is None else struct.pack('<b', result))
+
+        # Busy until the response has gone out
+        self.tx.send(bytes(encode_frame(response)))
+        self._busy_until = self.tx.free_at
+
+    def _write(self, frame):
+        try:
+            os.write(self.master, frame)
+        except OSError:
+            pass
+
+    def _device_info(self):
+        board = 'v71' if self.page_size == 512 else 'rh71'
+        start = bootloader.image.slot_address(board, 0)
+        return struct.pack('<bBBHHHIIIIII', 0, 1, 0, self.page_size, self.max_message,
+            16 if board == 'v71' else 1, bootloader.common.Feature.FEATURE_BOOT_RECORD,
+            self.baud_rate, start, SLOT_SIZE, start + SLOT_SIZE, SLOT_SIZE)
+
+    def _handle(self, method, request):
+        """The int8_t result, None for methods without one, the bytes after
+        the header for ones returning a struct or NO_METHOD"""
+        if method == _IDS.BL_PING_ID:
+            return None
+        if method == _IDS.BL_GETINFO_ID and self.info:
+            return self._device_info()
+        if method == _IDS.BL_ERASEPAGEBUFFER_ID:
+            self.page_buffer[:] = b'\xFF' * self.page_size
+            return None
+        if method == _IDS.BL_WRITEPAGEBUFFER_ID:
+            length, offset = struct.unpack_from('<BH', request, 3)
+            if offset + length > self.page_size:
+                return -2
+            self.page_buffer[offset:offset + length] = request[6:6 + length]
+            return 0
+        if method == _IDS.BL_WRITEPAGE_ID:
+            app_id, crc, page_no = struct.unpack_from('<BIH', request, 3)
+            if zlib.crc32(self.page_buffer) != crc:
+                return -2
+            start = page_no * self.page_size
+            if start + self.page_size > SLOT_SIZE:
+                return -1
+            self.slot[start:start + self.page_size] = self.page_buffer
+            return 0
+        if method == _IDS.BL_BEGINUPLOAD_ID:
+            app_id, length, crc = struct.unpack_from('<BII', request, 3)
+            if length > SLOT_SIZE:
+                return -1
+            self.slot[:] = b'\xFF' * SLOT_SIZE
+            return 0
+        if method == _IDS.BL_ERASEAPP_ID:
+            self.slot[:] = b'\xFF' * SLOT_SIZE
+            return 0
+        if method == _IDS.BL_CHECKIMAGE_ID:
+            return 0
+        if method == _IDS.BL_GETUPLOADSESSION_ID:
+            return -1 # No session
+        if method in (_IDS.BL_VERIFYAPP_ID, _IDS.BL_SETACTIVEAPP_ID):
+            app_id, length, crc = struct.unpack_from('<BII', request, 3)
+            if length > SLOT_SIZE or zlib.crc32(self.slot[:length]) != crc:
+                return -2
+            if method == _IDS.BL_SETACTIVEAPP_ID:
+                self.active = app_id
+            return 0
+        if method == _IDS.BL_WRITEADDRESS_ID:
+            app_id, length, offset = struct.unpack_from('<BII', request, 3)
+            if offset + length > SLOT_SIZE:
+                return -2
+            self.slot[offset:offset + length] = request[12:12 + length]
+            return 0
+        if method == _IDS.BL_FLUSHWRITES_ID:
+            return 0
+        if method == _IDS.BL_SETBOOTACTION_ID:
+            self.boot_action = request[3]
+            return 0
+        if method == _IDS.BL_BOOT_ID:
+            self.booted = self.boot_action != 0
+            return 0 if self.booted else -1
+        return NO_METHOD
+
+def add_link_arguments(parser):
+    group = parser.add_argument_group('link', 'faults and limits of the simulated link, both ways')
+    group.add_argument('--ber', type=float, default=0.0,
+                       help='Bit error rate (the CRC catches them; longer frames are hit more often)')
+    group.add_argument('--byte-drop', dest='byte_drop', type=float, default=0.0,
+                       help='Fraction of bytes lost outright')
+    group.add_argument('--burst-rate', dest='burst_rate', type=float, default=0.0,
+                       help='Bursts of garbage starting per byte')
+    group.add_argument('--burst-len', dest='burst_len', type=float, default=8.0,
+                       help='Average burst length in bytes (default 8)')
+    group.add_argument('--latency', type=float, default=0.0,
+                       help='One-way latency in seconds, on top of the time on the wire')
+    group.add_argument('--bandwidth', type=float,
+                       help='Bytes/s the link carries, if less than the baud rate allows')
+
+def link_params(args):
+    return LinkParams(ber=args.ber, byte_drop=args.byte_drop, burst_rate=args.burst_rate,
+                      burst_len=args.burst_len, latency=args.latency, bandwidth=args.bandwidth)
+
+def main():
+    parser = argparse.ArgumentParser(description='Simulated bootloaders on ptys')
+    parser.add_argument('-n', '--count', type=int, default=1,
+                        help='Number of devices')
+    parser.add_argument('-ps', '--page-size', dest='page_size', type=int, default=512,
+                        help='Flash page size (512 V71, 256 RH71)')
+    parser.add_argument('-br', '--baud', dest='baud_rate', type=int, default=38400,
+                        help='Baud rate the requests and responses are paced at')
+    parser.add_argument('--drop', type=float, default=0.0,
+                        help='Fraction of requests lost on the way in')
+    add_link_arguments(parser)
+    parser.add_argument('--max-message', dest='max_message', type=int, default=FRAME_MAX_PAYLOD_LEN,
+                        help='Longest request answered (64 for a device that only takes MOON_MAX_MESSAGE_LEN)')
+    parser.add_argument('--no-info', dest='info', action='store_false',
+                        help='Answer bl_getInfo NO_METHOD, like firmware from before it')
+    parser.add_argument('--mute', type=int, nargs='*', default=[], metavar='INDEX',
+                        help='Devices (0-based) that never answer')
+    args = parser.parse_args()
+
+    loop = asyncio.new_event_loop()
+    devices = [SimDevice(loop, args.page_size, args.baud_rate, args.drop, i in args.mute, seed=i,
+                         max_message=args.max_message, info=args.info, link=link_params(args))
+               for i in range(args.count)]
+    for device in devices:
+        print(device.path)
+    sys.stdout.flush()
+
+    try:
+        loop.run_forever()
+    except KeyboardInterrupt:
+        pass
+    finally:
+        for device in devices:
+            print('{0}: {1} requests, {2} lost, active {3}, booted {4}; bytes in {5} ({6} flipped, {7} garbled, {8} dropped), out {9} ({10} flipped, {11} garbled, {12} dropped)'.format(
+                device.path, device.requests, device.dropped, device.active, device.booted,
+                device.rx.bytes, device.rx.flipped, device.rx.garbled, device.rx.dropped,
+                device.tx.bytes, device.tx.flipped, device.tx.garbled, device.tx.dropped), file=sys.stderr)
+            device.close()
+        loop.close()
+
+if __name__ == "__main__":
+    main()
@@ -19,3 +19,8 @@ from . import server
 from . import interface
 from . import moon_codec
 from . import moon_transport
+from . import frame_trace
+from . import image
+from . import segments
+from . import uploader
+from . import fleet
@@ -0,0 +1,118 @@
+"""ctypes bindings for the host client library (tools/host, libblhost.so).
+
+Optional: the library has to be built first (see tools/host/meson.build) and
+is looked for in BLHOST_LIB, then on the regular library path. available()
+tells whether it was found; nothing else in tools/bootloader depends on it.
+"""
+
+import ctypes
+import ctypes.util
+import os
+
+# blhost.h
+E_ARG = -200
+E_IO = -201
+E_TIMEOUT = -202
+E_PROTOCOL = -203
+E_VERIFY = -204
+
+ERRORS = {
+    E_ARG: 'invalid argument',
+    E_IO: 'serial port error',
+    E_TIMEOUT: 'no response',
+    E_PROTOCOL: 'protocol error',
+    E_VERIFY: 'slot does not match the image',
+}
+
+CHUNK_MAX = 64 - 6
+
+_PROGRESS = ctypes.CFUNCTYPE(None, ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32)
+
+class _UploadOpts(ctypes.Structure):
+    _fields_ = [
+        ('page_size', ctypes.c_uint32),
+        ('chunk_size', ctypes.c_uint32),
+        ('activate', ctypes.c_bool),
+        ('progress', _PROGRESS),
+        ('progress_arg', ctypes.c_void_p),
+    ]
+
+def _load():
+    path = os.environ.get('BLHOST_LIB') or ctypes.util.find_library('blhost')
+    if path is None:
+        return None
+    try:
+        lib = ctypes.CDLL(path, use_errno=True)
+    except OSError:
+        return None
+
+    lib.blhost_open.restype = ctypes.c_void_p
+    lib.blhost_open.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+    lib.blhost_close.argtypes = [ctypes.c_void_p]
+    lib.blhost_set_timeout.argtypes = [ctypes.c_void_p, ctypes.c_uint32, ctypes.c_uint32]
+    lib.blhost_ping.argtypes = [ctypes.c_void_p]
+    lib.blhost_verify_app.argtypes = [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_uint32, ctypes.c_uint32]
+    lib.blhost_set_boot_action.argtypes = [ctypes.c_void_p, ctypes.c_uint8]
+    lib.blhost_boot.argtypes = [ctypes.c_void_p]
+    lib.blhost_crc_32.restype = ctypes.c_uint32
+    lib.blhost_crc_32.argtypes = [ctypes.c_char_p, ctypes.c_uint32]
+    lib.blhost_upload.argtypes = [ctypes.c_void_p, ctypes.c_uint8, ctypes.c_char_p, ctypes.c_uint32,
+        ctypes.POINTER(_UploadOpts)]
+    return lib
+
+_lib = _load()
+
+def available():
+    return _lib is not None
+
+class BlHostError(Exception):
+    def __init__(self, what, code):
+        super(BlHostError, self).__init__('{0} failed: {1}'.format(what, ERRORS.get(code, code)))
+        self.code = code
+
+class BlHost(object):
+    """One bootloader on a serial port; the methods raise BlHostError on
+    a transport error or a non-zero device result."""
+
+    def __init__(self, device, baud_rate, timeout_ms=1000, retries=5):
+        if _lib is None:
+            raise RuntimeError('libblhost not found (build tools/host or set BLHOST_LIB)')
+        self._host = _lib.blhost_open(device.encode(), baud_rate)
+        if not self._host:
+            err = ctypes.get_errno()
+            raise OSError(err, 'Failed to open {0}'.format(device))
+        _lib.blhost_set_timeout(self._host, timeout_ms, retries)
+
+    def close(self):
+        if self._host:
+            _lib.blhost_close(self._host)
+            self._host = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, *exc):
+        self.close()
+
+    def _check(self, what, r):
+        if r != 0:
+            raise BlHostError(what, r)
+
+    def ping(self):
+        self._check('bl_ping', _lib.blhost_ping(self._host))
+
+    def upload(self, app_id, image, page_size, chunk_size=0, activate=True, progress=None):
+        """Write a raw binary to app_id (0 = APP_1, 1 = APP_2) and have the
+        device verify it; progress(page, n_pages) is called per page."""
+        cb = _PROGRESS(lambda arg, page, n: progress(page, n)) if progress else _PROGRESS()
+        opts = _UploadOpts(page_size, chunk_size, activate, cb, None)
+        self._check('upload', _lib.blhost_upload(self._host, app_id, bytes(image), len(image), ctypes.byref(opts)))
+
+    def boot(self, app_id):
+        # BootAction is the slot number (BOOT_APP_1 = 1), AppId the index
+        self._check('bl_setBootAction', _lib.blhost_set_boot_action(self._host, app_id + 1))
+        self._check('bl_boot', _lib.blhost_boot(self._host))
+
+    @staticmethod
+    def crc_32(data):
+        return _lib.blhost_crc_32(bytes(data), len(data))
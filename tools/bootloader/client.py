@@ -161,3 +161,406 @@ class BootloaderClient(interface.IBootloader):
         _result = codec.read_int8()
         return _result
 
+    def bl_getStats(self, reset, stats):
+        assert type(stats) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETSTATS_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if reset is None:
+            raise ValueError("reset is None")
+        codec.write_bool(reset)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        stats.value = common.Stats()._read(codec)
+        return _result
+
+    def bl_getTrace(self, index, entry):
+        assert type(entry) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETTRACE_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if index is None:
+            raise ValueError("index is None")
+        codec.write_uint8(index)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        entry.value = common.TraceEntry()._read(codec)
+        return _result
+
+    def bl_resetTrace(self):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_RESETTRACE_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+
+    def bl_setActiveApp(self, app_id, length, crc):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_SETACTIVEAPP_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        # LOGAN: app_id fills the padding byte; the u32 arguments are aligned
+        codec.write_uint8(app_id)
+        if length is None:
+            raise ValueError("length is None")
+        codec.write_uint32(length)
+        if crc is None:
+            raise ValueError("crc is None")
+        codec.write_uint32(crc)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_getBootRecord(self, record):
+        assert type(record) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETBOOTRECORD_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        record.value = common.BootRecord()._read(codec)
+        return _result
+
+    def bl_confirmBoot(self):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_CONFIRMBOOT_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_checkImage(self, app_id, header):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_CHECKIMAGE_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        codec.write_uint8(app_id)
+
+        if header is None:
+            raise ValueError("header is None")
+        codec.write_uint8(len(header))
+
+        # LOGAN: Insert padding so the list starts on a word boundary (index 8)
+        for _ in range(3):
+            codec.write_uint8(0x00)
+
+        # Write list
+        for _i0 in header:
+            codec.write_uint8(_i0)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_verifyApp(self, app_id, length, crc):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_VERIFYAPP_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        # LOGAN: app_id fills the padding byte; the u32 arguments are aligned
+        codec.write_uint8(app_id)
+        if length is None:
+            raise ValueError("length is None")
+        codec.write_uint32(length)
+        if crc is None:
+            raise ValueError("crc is None")
+        codec.write_uint32(crc)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    STREAM_FLAG_LAST = 0x01
+
+    # LOGAN: Hand-written; the response is followed by stream frames. Returns
+    # the result and a list of (offset, data) chunks in the order received.
+    # The list stops short if a frame is lost (timeout / bad CRC); ask again
+    # from the offset after the last chunk.
+    def bl_readApp(self, app_id, offset, length, frames):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_READAPP_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        codec.write_uint8(app_id)
+        if offset is None:
+            raise ValueError("offset is None")
+        codec.write_uint32(offset)
+        if length is None:
+            raise ValueError("length is None")
+        codec.write_uint32(length)
+        if frames is None:
+            raise ValueError("frames is None")
+        codec.write_uint8(frames)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+
+        chunks = []
+        if _result != 0:
+            return _result, chunks
+
+        transport = self._clientManager.transport
+        for _ in range(frames):
+            msg = transport.receive()
+            if msg is None:
+                break
+
+            frame = self._clientManager.codec_class()
+            frame.buffer = msg
+            info = frame.start_read_message()
+            if info.type != erpc.codec.MessageType.kMultipleStream or info.sequence != request.sequence:
+                break
+
+            flags = frame.read_uint8()
+            chunk_offset = frame.read_uint32()
+            chunks.append((chunk_offset, bytes(msg[8:])))
+
+            if flags & self.STREAM_FLAG_LAST:
+                break
+
+        return _result, chunks
+
+    def bl_copyApp(self, src_id, dst_id, length):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_COPYAPP_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if src_id is None:
+            raise ValueError("src_id is None")
+        codec.write_uint8(src_id)
+        if dst_id is None:
+            raise ValueError("dst_id is None")
+        codec.write_uint8(dst_id)
+
+        # LOGAN: Insert padding so length starts on a word boundary (index 8)
+        for _ in range(3):
+            codec.write_uint8(0x00)
+
+        if length is None:
+            raise ValueError("length is None")
+        codec.write_uint32(length)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_getCopyStatus(self, status):
+        assert type(status) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETCOPYSTATUS_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        status.value = common.CopyStatus()._read(codec)
+        return _result
+
+    def bl_beginUpload(self, app_id, length, crc):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_BEGINUPLOAD_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        # LOGAN: app_id fills the padding byte; the u32 arguments are aligned
+        codec.write_uint8(app_id)
+        if length is None:
+            raise ValueError("length is None")
+        codec.write_uint32(length)
+        if crc is None:
+            raise ValueError("crc is None")
+        codec.write_uint32(crc)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_getUploadSession(self, session):
+        assert type(session) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETUPLOADSESSION_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        session.value = common.UploadSession()._read(codec)
+        return _result
+
+    def bl_writeAddress(self, app_id, offset, data):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_WRITEADDRESS_ID,
+                sequence=request.sequence,
+                protocol=0))
+        if app_id is None:
+            raise ValueError("app_id is None")
+        codec.write_uint8(app_id)
+
+        if data is None:
+            raise ValueError("data is None")
+        codec.write_uint8(len(data))
+
+        # LOGAN: Insert padding so offset starts on a word boundary (index 8)
+        for _ in range(3):
+            codec.write_uint8(0x00)
+
+        if offset is None:
+            raise ValueError("offset is None")
+        codec.write_uint32(offset)
+
+        # Write list
+        for _i0 in data:
+            codec.write_uint8(_i0)
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_flushWrites(self):
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_FLUSHWRITES_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        _result = codec.read_int8()
+        return _result
+
+    def bl_getInfo(self, info):
+        assert type(info) is erpc.Reference, "out parameter must be a Reference object"
+
+        # Build remote function invocation message.
+        request = self._clientManager.create_request()
+        codec = request.codec
+        codec.start_write_message(erpc.codec.MessageInfo(
+                type=erpc.codec.MessageType.kSingleNormal,
+                service=self.SERVICE_ID,
+                request=self.BL_GETINFO_ID,
+                sequence=request.sequence,
+                protocol=0))
+
+        # Send request and process reply.
+        self._clientManager.perform_request(request)
+        # LOGAN: The result is read first; it fills the alignment padding ahead of the struct
+        _result = codec.read_int8()
+        info.value = common.DeviceInfo()._read(codec)
+        return _result
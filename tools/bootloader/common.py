@@ -18,5 +18,258 @@ class AppId:
     APP_2 = 1
     BOOTLOADER = 255
 
+class TraceKind:
+    TRACE_STAGE = 0
+    TRACE_METHOD = 1
 
+class Feature:
+    FEATURE_BOOT_RECORD = 1
+    FEATURE_FAST_BOOT = 2
+    FEATURE_HANDOFF = 4
+    FEATURE_BL_API = 8
+    FEATURE_DIRECT_LATCH = 16
+    FEATURE_STATS = 32
+    FEATURE_TRACE = 64
+    FEATURE_RAM_BUILD = 128
 
+
+# Structures data types declarations
+class Stats(object):
+    def __init__(self, sll_frames=None, sll_crc_errors=None, sll_len_errors=None, usart_overruns=None, usart_frame_errors=None, transport_errors=None, server_requests=None, server_retries=None, server_no_service=None, server_no_method=None, server_syntax_errors=None, server_codec_errors=None):
+        self.sll_frames = sll_frames # uint32
+        self.sll_crc_errors = sll_crc_errors # uint32
+        self.sll_len_errors = sll_len_errors # uint32
+        self.usart_overruns = usart_overruns # uint32
+        self.usart_frame_errors = usart_frame_errors # uint32
+        self.transport_errors = transport_errors # uint32
+        self.server_requests = server_requests # uint32
+        self.server_retries = server_retries # uint32
+        self.server_no_service = server_no_service # uint32
+        self.server_no_method = server_no_method # uint32
+        self.server_syntax_errors = server_syntax_errors # uint32
+        self.server_codec_errors = server_codec_errors # uint32
+
+    def _read(self, codec):
+        self.sll_frames = codec.read_uint32()
+        self.sll_crc_errors = codec.read_uint32()
+        self.sll_len_errors = codec.read_uint32()
+        self.usart_overruns = codec.read_uint32()
+        self.usart_frame_errors = codec.read_uint32()
+        self.transport_errors = codec.read_uint32()
+        self.server_requests = codec.read_uint32()
+        self.server_retries = codec.read_uint32()
+        self.server_no_service = codec.read_uint32()
+        self.server_no_method = codec.read_uint32()
+        self.server_syntax_errors = codec.read_uint32()
+        self.server_codec_errors = codec.read_uint32()
+        return self
+
+    def _write(self, codec):
+        codec.write_uint32(self.sll_frames)
+        codec.write_uint32(self.sll_crc_errors)
+        codec.write_uint32(self.sll_len_errors)
+        codec.write_uint32(self.usart_overruns)
+        codec.write_uint32(self.usart_frame_errors)
+        codec.write_uint32(self.transport_errors)
+        codec.write_uint32(self.server_requests)
+        codec.write_uint32(self.server_retries)
+        codec.write_uint32(self.server_no_service)
+        codec.write_uint32(self.server_no_method)
+        codec.write_uint32(self.server_syntax_errors)
+        codec.write_uint32(self.server_codec_errors)
+
+    def __str__(self):
+        return "<%s@%x sll_frames=%s sll_crc_errors=%s sll_len_errors=%s usart_overruns=%s usart_frame_errors=%s transport_errors=%s server_requests=%s server_retries=%s server_no_service=%s server_no_method=%s server_syntax_errors=%s server_codec_errors=%s>" % (self.__class__.__name__, id(self), self.sll_frames, self.sll_crc_errors, self.sll_len_errors, self.usart_overruns, self.usart_frame_errors, self.transport_errors, self.server_requests, self.server_retries, self.server_no_service, self.server_no_method, self.server_syntax_errors, self.server_codec_errors)
+
+    def __repr__(self):
+        return self.__str__()
+
+class TraceEntry(object):
+    def __init__(self, kind=None, id=None, method=None, count=None, min=None, max=None, timebase_hz=None, sum=None):
+        self.kind = kind # TraceKind
+        self.id = id # uint8
+        self.method = method # uint8
+        self.count = count # uint32
+        self.min = min # uint32
+        self.max = max # uint32
+        self.timebase_hz = timebase_hz # uint32
+        self.sum = sum # uint64
+
+    def _read(self, codec):
+        # LOGAN: Enum resized to u8; the u8 members are followed by a padding byte
+        self.kind = codec.read_uint8()
+        self.id = codec.read_uint8()
+        self.method = codec.read_uint8()
+        codec.read_uint8()
+        self.count = codec.read_uint32()
+        self.min = codec.read_uint32()
+        self.max = codec.read_uint32()
+        self.timebase_hz = codec.read_uint32()
+        self.sum = codec.read_uint64()
+        return self
+
+    def _write(self, codec):
+        codec.write_uint8(self.kind)
+        codec.write_uint8(self.id)
+        codec.write_uint8(self.method)
+        codec.write_uint8(0)
+        codec.write_uint32(self.count)
+        codec.write_uint32(self.min)
+        codec.write_uint32(self.max)
+        codec.write_uint32(self.timebase_hz)
+        codec.write_uint64(self.sum)
+
+    def __str__(self):
+        return "<%s@%x kind=%s id=%s method=%s count=%s min=%s max=%s timebase_hz=%s sum=%s>" % (self.__class__.__name__, id(self), self.kind, self.id, self.method, self.count, self.min, self.max, self.timebase_hz, self.sum)
+
+    def __repr__(self):
+        return self.__str__()
+
+class BootRecord(object):
+    def __init__(self, active=None, attempts=None, max_attempts=None, verified=None, app1_length=None, app1_crc=None, app2_length=None, app2_crc=None):
+        self.active = active # int8
+        self.attempts = attempts # uint8
+        self.max_attempts = max_attempts # uint8
+        self.verified = verified # uint8
+        self.app1_length = app1_length # uint32
+        self.app1_crc = app1_crc # uint32
+        self.app2_length = app2_length # uint32
+        self.app2_crc = app2_crc # uint32
+
+    def _read(self, codec):
+        self.active = codec.read_int8()
+        self.attempts = codec.read_uint8()
+        self.max_attempts = codec.read_uint8()
+        self.verified = codec.read_uint8()
+        self.app1_length = codec.read_uint32()
+        self.app1_crc = codec.read_uint32()
+        self.app2_length = codec.read_uint32()
+        self.app2_crc = codec.read_uint32()
+        return self
+
+    def _write(self, codec):
+        codec.write_int8(self.active)
+        codec.write_uint8(self.attempts)
+        codec.write_uint8(self.max_attempts)
+        codec.write_uint8(self.verified)
+        codec.write_uint32(self.app1_length)
+        codec.write_uint32(self.app1_crc)
+        codec.write_uint32(self.app2_length)
+        codec.write_uint32(self.app2_crc)
+
+    def __str__(self):
+        return "<%s@%x active=%s attempts=%s max_attempts=%s verified=%s app1_length=%s app1_crc=%s app2_length=%s app2_crc=%s>" % (self.__class__.__name__, id(self), self.active, self.attempts, self.max_attempts, self.verified, self.app1_length, self.app1_crc, self.app2_length, self.app2_crc)
+
+    def __repr__(self):
+        return self.__str__()
+
+class CopyStatus(object):
+    def __init__(self, state=None, error=None, pages=None, page=None, erased=None, programmed=None, skipped=None):
+        self.state = state # uint8
+        self.error = error # int8
+        self.pages = pages # uint16
+        self.page = page # uint16
+        self.erased = erased # uint16
+        self.programmed = programmed # uint16
+        self.skipped = skipped # uint16
+
+    def _read(self, codec):
+        self.state = codec.read_uint8()
+        self.error = codec.read_int8()
+        self.pages = codec.read_uint16()
+        self.page = codec.read_uint16()
+        self.erased = codec.read_uint16()
+        self.programmed = codec.read_uint16()
+        self.skipped = codec.read_uint16()
+        return self
+
+    def _write(self, codec):
+        codec.write_uint8(self.state)
+        codec.write_int8(self.error)
+        codec.write_uint16(self.pages)
+        codec.write_uint16(self.page)
+        codec.write_uint16(self.erased)
+        codec.write_uint16(self.programmed)
+        codec.write_uint16(self.skipped)
+
+    def __str__(self):
+        return "<%s@%x state=%s error=%s pages=%s page=%s erased=%s programmed=%s skipped=%s>" % (self.__class__.__name__, id(self), self.state, self.error, self.pages, self.page, self.erased, self.programmed, self.skipped)
+
+    def __repr__(self):
+        return self.__str__()
+
+class UploadSession(object):
+    def __init__(self, app_id=None, reserved=None, committed=None, length=None, crc=None):
+        self.app_id = app_id # int8
+        self.reserved = reserved # uint8
+        self.committed = committed # uint16
+        self.length = length # uint32
+        self.crc = crc # uint32
+
+    def _read(self, codec):
+        self.app_id = codec.read_int8()
+        self.reserved = codec.read_uint8()
+        self.committed = codec.read_uint16()
+        self.length = codec.read_uint32()
+        self.crc = codec.read_uint32()
+        return self
+
+    def _write(self, codec):
+        codec.write_int8(self.app_id)
+        codec.write_uint8(self.reserved)
+        codec.write_uint16(self.committed)
+        codec.write_uint32(self.length)
+        codec.write_uint32(self.crc)
+
+    def __str__(self):
+        return "<%s@%x app_id=%s committed=%s length=%s crc=%s>" % (self.__class__.__name__, id(self), self.app_id, self.committed, self.length, self.crc)
+
+    def __repr__(self):
+        return self.__str__()
+
+class DeviceInfo(object):
+    def __init__(self, info_version=None, codec_version=None, page_size=None, max_message_len=None, erase_pages=None, features=None, baud_rate=None, app1_start=None, app1_size=None, app2_start=None, app2_size=None):
+        self.info_version = info_version # uint8
+        self.codec_version = codec_version # uint8
+        self.page_size = page_size # uint16
+        self.max_message_len = max_message_len # uint16
+        self.erase_pages = erase_pages # uint16
+        self.features = features # uint32
+        self.baud_rate = baud_rate # uint32
+        self.app1_start = app1_start # uint32
+        self.app1_size = app1_size # uint32
+        self.app2_start = app2_start # uint32
+        self.app2_size = app2_size # uint32
+
+    def _read(self, codec):
+        self.info_version = codec.read_uint8()
+        self.codec_version = codec.read_uint8()
+        self.page_size = codec.read_uint16()
+        self.max_message_len = codec.read_uint16()
+        self.erase_pages = codec.read_uint16()
+        self.features = codec.read_uint32()
+        self.baud_rate = codec.read_uint32()
+        self.app1_start = codec.read_uint32()
+        self.app1_size = codec.read_uint32()
+        self.app2_start = codec.read_uint32()
+        self.app2_size = codec.read_uint32()
+        return self
+
+    def _write(self, codec):
+        codec.write_uint8(self.info_version)
+        codec.write_uint8(self.codec_version)
+        codec.write_uint16(self.page_size)
+        codec.write_uint16(self.max_message_len)
+        codec.write_uint16(self.erase_pages)
+        codec.write_uint32(self.features)
+        codec.write_uint32(self.baud_rate)
+        codec.write_uint32(self.app1_start)
+        codec.write_uint32(self.app1_size)
+        codec.write_uint32(self.app2_start)
+        codec.write_uint32(self.app2_size)
+
+    def __str__(self):
+        return "<%s@%x info_version=%s page_size=%s max_message_len=%s features=%s>" % (self.__class__.__name__, id(self), self.info_version, self.page_size, self.max_message_len, self.features)
+
+    def __repr__(self):
+        return self.__str__()
@@ -0,0 +1,156 @@
+"""Flash many devices at once.
+
+Each device gets its own serial port, Link (see uploader.py) and flashing
+sequence (checkImage, beginUpload, the pages, verifyApp, setActiveApp if the
+device keeps a boot record and optionally the boot); one event loop drives all of them, so a slow or
+failing board doesn't hold up the others. What happened on each is
+collected in a DeviceResult for the summary.
+"""
+
+import asyncio
+import glob
+import struct
+import time
+
+import serial
+
+from . import interface
+from .uploader import MESSAGE_LEN_MAX, WRITE_PAGE_BUFFER_OVERHEAD, Link, call, get_info, has_boot_record, probe_message_len, upload
+
+_IDS = interface.IBootloader
+
+# bl_verifyApp answers 1 while the device is still hashing the slot
+VERIFY_BUSY = 1
+VERIFY_POLL_S = 0.02
+
+class DeviceResult(object):
+    def __init__(self, device):
+        self.device = device
+        self.ok = False
+        self.step = None
+        self.error = None
+        self.seconds = 0.0
+        self.pages = 0
+        self.sent = 0
+        self.resent = 0
+        self.bad_frames = 0
+        # Smallest bl_writePageBuffer chunk the link was tuned down to
+        self.chunk_size = None
+
+def expand(patterns):
+    """Device paths from a list of paths and globs (e.g.
+    '/dev/serial/by-id/*'); duplicates are dropped, the order is kept"""
+    devices = []
+    for pattern in patterns:
+        matches = sorted(glob.glob(pattern)) if glob.has_magic(pattern) else [pattern]
+        for device in matches:
+            if device not in devices:
+                devices.append(device)
+    return devices
+
+async def _checked(result, step, coro):
+    result.step = step
+    r = await coro
+    if r != 0:
+        raise RuntimeError('{0} failed ({1})'.format(step, r))
+
+async def _verify(link, args):
+    while True:
+        r = await call(link, _IDS.BL_VERIFYAPP_ID, args)
+        if r != VERIFY_BUSY:
+            return r
+        await asyncio.sleep(VERIFY_POLL_S)
+
+async def flash_device(device, baud_rate, app_id, binf, pages, page_size, image_crc,
+                       header=None, chunk_size=None, boot=True, retries=5):
+    loop = asyncio.get_running_loop()
+    result = DeviceResult(device)
+    start = time.monotonic()
+    port = None
+    link = None
+
+    try:
+        result.step = 'open'
+        port = serial.Serial(device, baud_rate, timeout=0)
+        link = Link(port, loop, retries=retries)
+
+        # The longest request this device takes (probed on older firmware);
+        # chunk_size caps it. Every device has to have the page size given.
+        result.step = 'probe'
+        info = await get_info(link)
+        if info is not None and info.page_size != page_size:
+            raise RuntimeError('device has {0} byte pages, not {1}'.format(info.page_size, page_size))
+        message_len = min(info.max_message_len, MESSAGE_LEN_MAX) if info is not None else await probe_message_len(link)
+        chunk = message_len - WRITE_PAGE_BUFFER_OVERHEAD
+        if chunk_size is not None:
+            chunk = min(chunk, chunk_size)
+
+        slot_args = struct.pack('<BII', app_id, len(binf), image_crc)
+
+        if header is not None:
+            await _checked(result, 'bl_checkImage',
+                call(link, _IDS.BL_CHECKIMAGE_ID, struct.pack('<BBxxx', app_id, len(header)) + header))
+
+        await _checked(result, 'bl_beginUpload', call(link, _IDS.BL_BEGINUPLOAD_ID, slot_args))
+
+        result.step = 'pages'
+        tuner = await upload(link, app_id, binf, pages, page_size, chunk, retries=retries)
+        result.pages = len(pages)
+        result.chunk_size = tuner.smallest
+
+        await _checked(result, 'bl_verifyApp', _verify(link, slot_args))
+        if has_boot_record(info):
+            await _checked(result, 'bl_setActiveApp', call(link, _IDS.BL_SETACTIVEAPP_ID, slot_args))
+
+        if boot:
+            # BootAction is the slot number (BOOT_APP_1 = 1), AppId the index
+            await _checked(result, 'bl_setBootAction', call(link, _IDS.BL_SETBOOTACTION_ID, struct.pack('<B', app_id + 1)))
+            await _checked(result, 'bl_boot', call(link, _IDS.BL_BOOT_ID))
+
+        result.step = None
+        result.ok = True
+    except Exception as e:
+        result.error = '{0}: {1}'.format(type(e).__name__, e) if str(e) else type(e).__name__
+    finally:
+        if link is not None:
+            result.sent = link.sent
+            result.resent = link.resent
+            result.bad_frames = link.bad_frames
+            link.close()
+        if port is not None:
+            port.close()
+        result.seconds = time.monotonic() - start
+
+    return result
+
+def flash_all(devices, baud_rate, app_id, binf, pages, page_size, image_crc, on_done=None, **kwargs):
+    """Flash every device concurrently; a DeviceResult per device, in order.
+    on_done(result) is called as each one finishes."""
+
+    async def one(device):
+        result = await flash_device(device, baud_rate, app_id, binf, pages, page_size, image_crc, **kwargs)
+        if on_done is not None:
+            on_done(result)
+        return result
+
+    async def run():
+        return await asyncio.gather(*[one(device) for device in devices])
+
+    loop = asyncio.new_event_loop()
+    try:
+        return loop.run_until_complete(run())
+    finally:
+        loop.close()
+
+def print_summary(results, out=print):
+    width = max([len('device')] + [len(r.device) for r in results])
+    out('{0:<{w}}  {1:<6}  {2:>7}  {3:>5}  {4:>6}  {5:>7}  {6:>4}  {7:>5}  {8}'.format(
+        'device', 'result', 'time', 'pages', 'frames', 'resent', 'bad', 'chunk', 'error', w=width))
+    for r in results:
+        out('{0:<{w}}  {1:<6}  {2:>6.1f}s  {3:>5}  {4:>6}  {5:>7}  {6:>4}  {7:>5}  {8}'.format(
+            r.device, 'ok' if r.ok else 'FAILED', r.seconds, r.pages, r.sent, r.resent, r.bad_frames,
+            '-' if r.chunk_size is None else r.chunk_size,
+            '' if r.ok else '{0} ({1})'.format(r.error, r.step), w=width))
+    failed = len([r for r in results if not r.ok])
+    out('{0} of {1} devices flashed{2}'.format(len(results) - failed, len(results),
+        '' if not failed else ', {0} failed'.format(failed)))
@@ -0,0 +1,74 @@
+"""Frame traces (src/include/frame_trace.h).
+
+A trace is a header and a run of fixed-size records, one per frame received
+(RX), dropped on a bad CRC (RX_CRC), lost to a character error (RX_ERROR) or
+sent (TX), from the point of view of whoever recorded it. The device keeps
+one in a RAM ring (CONFIG_FRAME_TRACE, dumped with the debugger); on the host
+a FrameTrace attached to the transport (MoonTransport.trace, Link(trace=...))
+writes one to a file. tools/host/blreplay prints and replays either.
+
+The file is written through, a record at a time, so a trace of a session
+that hung and had to be killed is complete up to the hang.
+"""
+
+import struct
+import time
+
+MAGIC = 0x4352544D # "MTRC"
+VERSION = 1
+
+DATA_LEN = 128 # SLL_MAX_PAYLOD_LEN
+
+RX = 0
+RX_CRC = 1
+RX_ERROR = 2
+TX = 3
+
+ORIGIN_DEVICE = 0
+ORIGIN_HOST = 1
+
+# Host timestamps are in microseconds; the 32-bit time wraps every 71 minutes
+HOST_TIMEBASE_HZ = 1000000
+
+_HEADER = struct.Struct('<IHHIIIHBx')
+_RECORD = struct.Struct('<IBxH')
+RECORD_SIZE = _RECORD.size + DATA_LEN
+
+class FrameTrace(object):
+    """Writes a host trace to 'path'"""
+
+    def __init__(self, path, page_size=0):
+        self._file = open(path, 'wb')
+        self._page_size = page_size
+        self.count = 0
+        self._write_header()
+
+    def _write_header(self):
+        self._file.seek(0)
+        self._file.write(_HEADER.pack(MAGIC, VERSION, RECORD_SIZE, HOST_TIMEBASE_HZ,
+            0, self.count, self._page_size, ORIGIN_HOST))
+        self._file.seek(0, 2)
+
+    @property
+    def page_size(self):
+        return self._page_size
+
+    @page_size.setter
+    def page_size(self, page_size):
+        """Page size of the device (it's usually known only after a probe)"""
+        self._page_size = page_size or 0
+        self._write_header()
+        self._file.flush()
+
+    def record(self, kind, data=b''):
+        data = bytes(data[:DATA_LEN])
+        now = (time.monotonic_ns() // 1000) & 0xFFFFFFFF
+        self._file.write(_RECORD.pack(now, kind, len(data)) + data.ljust(DATA_LEN, b'\0'))
+        self._file.flush()
+        self.count += 1
+
+    def close(self):
+        if self._file.closed:
+            return
+        self._write_header()
+        self._file.close()
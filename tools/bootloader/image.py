@@ -0,0 +1,126 @@
+# Image header format (see src/include/image.h)
+#
+# The header is prepended to the application binary in the image file; it's
+# sent to the device (bl_checkImage) before a slot is erased and the length /
+# CRC it carries are what the boot record is set from (bl_setActiveApp).
+
+import struct
+
+from .moon_transport import crc_32
+
+IMAGE_MAGIC = 0x49464C4F # "OLFI"
+IMAGE_VERSION = 1
+IMAGE_HEADER_SIZE = 32
+
+IMAGE_SLOT_ANY = 0xFF
+
+IMAGE_FLAG_PAGE_CRCS = (1 << 0)
+
+# magic, version, slot, flags, header_size, length, crc, load_address,
+# page_size, page_count, reserved (header_crc follows)
+_HEADER_FMT = '<IBBBBIIIHHI'
+
+# bl_checkImage return values
+IMAGE_ERRORS = {
+    -1: 'bad header',
+    -2: 'image is for a different slot',
+    -3: 'image is linked for a different load address',
+    -4: 'image page size does not match the device',
+    -5: 'image is empty or larger than the slot',
+}
+
+# Flash layout (src/drivers/flash.c); the application slots follow the
+# bootloader and are 56 KB each
+BOOTLOADER_SIZE = 16 * 1024
+APP_SIZE = 0xE000
+
+FLASH_BASE = {
+    'v71': 0x00400000,
+    'rh71': 0x10000000,
+}
+
+def slot_address(board, slot):
+    """Load address of application slot 'slot' (0 = APP_1, 1 = APP_2)."""
+    return FLASH_BASE[board] + BOOTLOADER_SIZE + (slot * APP_SIZE)
+
+def page_crcs(binary, page_size):
+    """CRC-32 of each page, the last one padded with FF as written to flash."""
+    crcs = []
+    for start in range(0, len(binary), page_size):
+        page = binary[start:start + page_size]
+        page = page + b'\xFF' * (page_size - len(page))
+        crcs.append(crc_32(page))
+    return crcs
+
+class ImageHeader(object):
+    def __init__(self, slot=IMAGE_SLOT_ANY, flags=0, length=0, crc=0, load_address=0, page_size=0, page_count=0):
+        self.magic = IMAGE_MAGIC
+        self.version = IMAGE_VERSION
+        self.slot = slot
+        self.flags = flags
+        self.header_size = IMAGE_HEADER_SIZE
+        self.length = length
+        self.crc = crc
+        self.load_address = load_address
+        self.page_size = page_size
+        self.page_count = page_count
+        self.reserved = 0
+
+    def pack(self):
+        data = struct.pack(_HEADER_FMT, self.magic, self.version, self.slot,
+            self.flags, self.header_size, self.length, self.crc,
+            self.load_address, self.page_size, self.page_count, self.reserved)
+        return data + struct.pack('<I', crc_32(data))
+
+    @classmethod
+    def unpack(cls, data):
+        """Returns the header or None if 'data' doesn't start with a valid one."""
+        if len(data) < IMAGE_HEADER_SIZE:
+            return None
+
+        fields = struct.unpack_from(_HEADER_FMT, data)
+        header_crc, = struct.unpack_from('<I', data, IMAGE_HEADER_SIZE - 4)
+        if fields[0] != IMAGE_MAGIC or crc_32(data[:IMAGE_HEADER_SIZE - 4]) != header_crc:
+            return None
+
+        h = cls()
+        (h.magic, h.version, h.slot, h.flags, h.header_size, h.length, h.crc,
+            h.load_address, h.page_size, h.page_count, h.reserved) = fields
+        return h
+
+    def __str__(self):
+        slot = 'any' if self.slot == IMAGE_SLOT_ANY else 'APP_{0}'.format(self.slot + 1)
+        return 'image v{0} for {1}: {2} bytes crc {3:08X} @ {4:08X}, {5} byte pages{6}'.format(
+            self.version, slot, self.length, self.crc, self.load_address, self.page_size,
+            ' ({0} page CRCs)'.format(self.page_count) if self.flags & IMAGE_FLAG_PAGE_CRCS else '')
+
+def pack_image(binary, load_address, page_size, slot=IMAGE_SLOT_ANY, with_page_crcs=False):
+    """Build an image file: header, optional page CRC table, then the binary."""
+    crcs = page_crcs(binary, page_size) if with_page_crcs else []
+    header = ImageHeader(slot=slot,
+        flags=(IMAGE_FLAG_PAGE_CRCS if with_page_crcs else 0),
+        length=len(binary), crc=crc_32(binary), load_address=load_address,
+        page_size=page_size, page_count=len(crcs))
+
+    return header.pack() + b''.join(struct.pack('<I', c) for c in crcs) + binary
+
+def unpack_image(data):
+    """Split an image file into (header, page CRCs or None, binary).
+
+    A file without a header is taken as a raw binary: (None, None, data).
+    """
+    header = ImageHeader.unpack(data)
+    if header is None:
+        return (None, None, data)
+
+    offset = header.header_size
+    crcs = None
+    if header.flags & IMAGE_FLAG_PAGE_CRCS:
+        crcs = list(struct.unpack_from('<{0}I'.format(header.page_count), data, offset))
+        offset += 4 * header.page_count
+
+    binary = data[offset:offset + header.length]
+    if len(binary) != header.length or crc_32(binary) != header.crc:
+        raise ValueError('Image is truncated or corrupt')
+
+    return (header, crcs, binary)
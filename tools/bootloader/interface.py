@@ -16,6 +16,22 @@ class IBootloader(object):
     BL_WRITEPAGE_ID = 5
     BL_SETBOOTACTION_ID = 8
     BL_BOOT_ID = 9
+    BL_GETSTATS_ID = 10
+    BL_GETTRACE_ID = 11
+    BL_RESETTRACE_ID = 12
+    BL_SETACTIVEAPP_ID = 13
+    BL_GETBOOTRECORD_ID = 14
+    BL_CONFIRMBOOT_ID = 15
+    BL_CHECKIMAGE_ID = 16
+    BL_VERIFYAPP_ID = 17
+    BL_READAPP_ID = 18
+    BL_COPYAPP_ID = 19
+    BL_GETCOPYSTATUS_ID = 20
+    BL_BEGINUPLOAD_ID = 21
+    BL_GETUPLOADSESSION_ID = 22
+    BL_WRITEADDRESS_ID = 23
+    BL_FLUSHWRITES_ID = 24
+    BL_GETINFO_ID = 25
 
     def bl_ping(self):
         raise NotImplementedError()
@@ -38,4 +54,51 @@ class IBootloader(object):
     def bl_boot(self):
         raise NotImplementedError()
 
+    def bl_getStats(self, reset, stats):
+        raise NotImplementedError()
+
+    def bl_getTrace(self, index, entry):
+        raise NotImplementedError()
+
+    def bl_resetTrace(self):
+        raise NotImplementedError()
+
+    def bl_setActiveApp(self, app_id, length, crc):
+        raise NotImplementedError()
+
+    def bl_getBootRecord(self, record):
+        raise NotImplementedError()
+
+    def bl_confirmBoot(self):
+        raise NotImplementedError()
+
+    def bl_checkImage(self, app_id, header):
+        raise NotImplementedError()
+
+    def bl_verifyApp(self, app_id, length, crc):
+        raise NotImplementedError()
+
+    def bl_readApp(self, app_id, offset, length, frames):
+        raise NotImplementedError()
+
+    def bl_copyApp(self, src_id, dst_id, length):
+        raise NotImplementedError()
+
+    def bl_getCopyStatus(self, status):
+        raise NotImplementedError()
+
+    def bl_beginUpload(self, app_id, length, crc):
+        raise NotImplementedError()
+
+    def bl_getUploadSession(self, session):
+        raise NotImplementedError()
+
+    def bl_writeAddress(self, app_id, offset, data):
+        raise NotImplementedError()
+
+    def bl_flushWrites(self):
+        raise NotImplementedError()
+
+    def bl_getInfo(self, info):
+        raise NotImplementedError()
 
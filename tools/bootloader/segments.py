@@ -0,0 +1,105 @@
+# Loadable segments of ELF / Intel HEX files
+#
+# A segment is an (address, data) pair. load() returns the segments of an
+# ELF (PT_LOAD program headers, at their physical / load address) or Intel HEX
+# file, or None for anything else (taken as a raw binary). to_slot() maps the
+# segments into a slot and flattens them into the binary as it ends up in
+# flash: the gaps are FF, i.e. left erased.
+
+import struct
+
+ELF_MAGIC = b'\x7fELF'
+
+PT_LOAD = 1
+
+def load_elf(data):
+    """PT_LOAD segments of a 32-bit little-endian ELF file (bytes in the file
+    only; .bss and the like take no flash)."""
+    if data[:4] != ELF_MAGIC:
+        raise ValueError('Not an ELF file')
+    if data[4] != 1 or data[5] != 1:
+        raise ValueError('Only 32-bit little-endian ELF files are supported')
+
+    e_phoff, = struct.unpack_from('<I', data, 0x1C)
+    e_phentsize, e_phnum = struct.unpack_from('<HH', data, 0x2A)
+
+    segments = []
+    for i in range(e_phnum):
+        p_type, p_offset, p_vaddr, p_paddr, p_filesz = struct.unpack_from('<IIIII', data, e_phoff + (i * e_phentsize))
+        if p_type != PT_LOAD or p_filesz == 0:
+            continue
+        segments.append((p_paddr, data[p_offset:p_offset + p_filesz]))
+
+    return segments
+
+def load_hex(text):
+    """Data records of an Intel HEX file, merged into contiguous segments."""
+    segments = []
+    base = 0
+    for n, line in enumerate(text.splitlines(), 1):
+        line = line.strip()
+        if not line:
+            continue
+        if not line.startswith(':'):
+            raise ValueError('Line {0}: not a HEX record'.format(n))
+
+        record = bytes.fromhex(line[1:])
+        if len(record) < 5 or len(record) != record[0] + 5 or (sum(record) & 0xFF) != 0:
+            raise ValueError('Line {0}: bad record length / checksum'.format(n))
+
+        length, address, kind = record[0], (record[1] << 8) | record[2], record[3]
+        payload = record[4:4 + length]
+
+        if kind == 0x00:
+            address += base
+            if segments and segments[-1][0] + len(segments[-1][1]) == address:
+                segments[-1] = (segments[-1][0], segments[-1][1] + payload)
+            else:
+                segments.append((address, payload))
+        elif kind == 0x01:
+            break
+        elif kind == 0x02:
+            base = int.from_bytes(payload, 'big') << 4
+        elif kind == 0x04:
+            base = int.from_bytes(payload, 'big') << 16
+        # 0x03 / 0x05 (start address) don't affect the flash contents
+
+    return segments
+
+def load(data):
+    """Segments of an ELF or Intel HEX file, or None if 'data' is neither."""
+    if data[:4] == ELF_MAGIC:
+        return load_elf(data)
+    if data[:1] == b':':
+        return load_hex(data.decode('ascii'))
+    return None
+
+def to_slot(segments, slot_address, slot_size):
+    """Flatten segments linked for the slot at 'slot_address' into the slot's
+    binary, from the start of the slot to the end of the last segment."""
+    if not segments:
+        raise ValueError('No loadable segments')
+
+    end = 0
+    for address, data in segments:
+        offset = address - slot_address
+        if offset < 0 or offset + len(data) > slot_size:
+            raise ValueError('Segment {0:#010x}..{1:#010x} is outside the slot at {2:#010x}; is the image linked for this slot?'
+                .format(address, address + len(data), slot_address))
+        end = max(end, offset + len(data))
+
+    binary = bytearray(b'\xFF' * end)
+    for address, data in segments:
+        offset = address - slot_address
+        binary[offset:offset + len(data)] = data
+
+    return bytes(binary)
+
+def data_pages(binary, page_size):
+    """Pages of 'binary' holding anything but FF; the rest can be left erased."""
+    pages = []
+    for start in range(0, len(binary), page_size):
+        page = binary[start:start + page_size]
+        if page.count(0xFF) != len(page):
+            pages.append(start // page_size)
+    return pages
@@ -0,0 +1,612 @@
+"""Pipelined page upload over asyncio.
+
+The requests of an upload (bl_erasePageBuffer, bl_writePageBuffer for each
+chunk that isn't all FF, bl_writePage) are built ahead of time, a page or
+more in front of the one being confirmed, and handed to a Link. The Link
+sends the next frame the moment a response comes in (from the reader
+callback, not a round trip through the caller), so the next page's chunks go
+out right behind the current page's commit instead of after its result has
+been looked at and the next page sliced, CRC'd and encoded.
+
+NOTE: One frame is on the wire at a time. The bootloader polls its USART
+into a single frame buffer and doesn't read while it handles a request, so a
+second frame sent ahead of a response would be lost in an overrun; the
+pipelining is all on the host side.
+
+Timeouts are adaptive (RFC 6298 style, per method, on top of the frame's
+own time on the wire): a lost frame is resent after a few round trips rather
+than after a fixed timeout and sleep, and only the resends of that frame
+back off.
+
+The chunk size isn't fixed either. probe() asks the device for its page
+size and the longest request it takes (bl_getInfo; older firmware is probed
+for both), and a ChunkTuner shortens the chunks while the
+link is losing frames to noise and lengthens them again once it's clean.
+"""
+
+import asyncio
+import collections
+import math
+import struct
+import sys
+import time
+import zlib
+
+from . import common, frame_trace, interface
+from .moon_codec import MoonCodec
+from .moon_transport import FRAME_MAX_PAYLOD_LEN, FRAME_OVERHEAD_LEN, BadCrc, FrameDecoder, InvalidFrame, encode_frame
+
+_IDS = interface.IBootloader
+
+# bl_writePage: the latch was taken by another flash write (direct-latch builds)
+WRITE_PAGE_E_LATCH = -4
+
+# Request length (header and arguments) every device takes
+# (MOON_MAX_MESSAGE_LEN) and the most a frame can carry; the server answers
+# anything its transport receives, so a frame's worth usually works
+MESSAGE_LEN_MIN = 64
+MESSAGE_LEN_MAX = FRAME_MAX_PAYLOD_LEN
+
+# Header and arguments in front of the data
+WRITE_PAGE_BUFFER_OVERHEAD = 6
+WRITE_ADDRESS_OVERHEAD = 12
+
+# Framing of a request and its response (an int8_t result after the header)
+EXCHANGE_OVERHEAD = 2 * FRAME_OVERHEAD_LEN + 4
+
+CHUNK_MIN = 8
+
+# DeviceInfo (bl_getInfo) as of info_version 1; later versions only append
+DEVICE_INFO_LEN = 32
+
+# Sent ahead of the second and later resends of a request. A corrupt length
+# byte leaves the device's frame decoder counting out a frame that isn't
+# coming, and a resend on its own would only go to fill it up; 0x55 can't
+# be mistaken for the start of a frame (0x5A 0x7E).
+RESYNC = b'\x55' * (FRAME_MAX_PAYLOD_LEN + FRAME_OVERHEAD_LEN)
+
+class UploadError(Exception):
+    pass
+
+# Requests that only touch RAM (the page buffer) take about as long as each
+# other once their transmit time is left out, so they share one estimator;
+# the first bl_writePageBuffer isn't left waiting out the initial timeout
+_RAM_METHODS = frozenset([_IDS.BL_PING_ID, _IDS.BL_ERASEPAGEBUFFER_ID, _IDS.BL_WRITEPAGEBUFFER_ID])
+
+class _Rto(object):
+    """Retransmission timeout from smoothed round trip times (RFC 6298)"""
+
+    def __init__(self, initial, minimum, maximum):
+        self.srtt = None
+        self.rttvar = None
+        self.rto = initial
+        self.minimum = minimum
+        self.maximum = maximum
+
+    def sample(self, rtt):
+        if self.srtt is None:
+            self.srtt = rtt
+            self.rttvar = rtt / 2
+        else:
+            self.rttvar = 0.75 * self.rttvar + 0.25 * abs(self.srtt - rtt)
+            self.srtt = 0.875 * self.srtt + 0.125 * rtt
+        self.rto = min(self.maximum, max(self.minimum, self.srtt + 4 * self.rttvar))
+
+    def timeout(self, attempt):
+        """Timeout for the given attempt (1 for the first send), doubled for
+        each resend. The doubling stays with the request: on a noisy line
+        the next request's first send shouldn't wait out this one's losses."""
+        return min(self.maximum, self.rto * (1 << min(attempt - 1, 8)))
+
+class _Request(object):
+    __slots__ = ('method', 'sequence', 'frame', 'future', 'retries', 'tx_time', 'first_sent_at', 'sent_at', 'attempts')
+
+    def __init__(self, method, sequence, frame, future, retries):
+        self.method = method
+        self.sequence = sequence
+        self.frame = frame
+        self.future = future
+        self.retries = retries
+        self.tx_time = 0.0
+        self.first_sent_at = None
+        self.sent_at = None
+        self.attempts = 0
+
+class Link(object):
+    """Bootloader requests over a pyserial port driven by the event loop.
+
+    submit() queues a request and returns a future for its response payload
+    (the bytes after the header). Requests go out in order, one at a time;
+    one that isn't answered within the timeout is resent as is (same
+    sequence number) up to 'retries' times before its future fails.
+
+    The timeouts leave out the time the request takes to send at the port's
+    baud rate; a longer chunk doesn't need a longer RTO.
+
+    'trace' (a frame_trace.FrameTrace) records the frames either way."""
+
+    def __init__(self, port, loop, sequence=0, retries=5,
+                 initial_timeout=1.0, min_timeout=0.02, max_timeout=5.0, trace=None):
+        self._port = port
+        self._trace = trace
+        self._loop = loop
+        self._sequence = sequence
+        self._retries = retries
+        baud_rate = getattr(port, 'baudrate', None)
+        self._byte_time = 10.0 / baud_rate if baud_rate else 0.0 # 8N1
+        self._rto_args = (initial_timeout, min_timeout, max_timeout)
+        self._rto = {}
+        self._decoder = FrameDecoder()
+        self._queue = collections.deque()
+        self._current = None
+        self._timer = None
+
+        self.sent = 0
+        self.resent = 0
+        self.bad_frames = 0
+        self.bytes_sent = 0
+        self.bytes_received = 0
+        # Seconds spent waiting out timeouts
+        self.waited = 0.0
+        # (first send, response) times (time.monotonic()) of the requests
+        # that had to be resent
+        self.recovered = []
+
+        self._saved_timeout = port.timeout
+        port.timeout = 0
+        port.reset_input_buffer()
+        loop.add_reader(port.fileno(), self._on_readable)
+
+    def close(self):
+        self._loop.remove_reader(self._port.fileno())
+        self._port.timeout = self._saved_timeout
+        self.flush()
+        if self._current is not None and not self._current.future.done():
+            self._current.future.cancel()
+        self._cancel_timer()
+
+    @property
+    def sequence(self):
+        return self._sequence
+
+    @property
+    def wire_bytes(self):
+        """Bytes of frames sent and received so far (resync filler left out)"""
+        return self.bytes_sent + self.bytes_received
+
+    @property
+    def byte_time(self):
+        """Seconds per byte at the port's baud rate (0 if it has none)"""
+        return self._byte_time
+
+    def turnaround(self, method):
+        """Smoothed round trip of 'method' past its request's transmit time,
+        in byte-times (0 before the first sample)"""
+        rto = self._rto.get(self._rto_key(method))
+        if rto is None or rto.srtt is None or not self._byte_time:
+            return 0.0
+        return rto.srtt / self._byte_time
+
+    def submit(self, method, args=b'', retries=None):
+        self._sequence = (self._sequence + 1) & 0x1F
+        header = (MoonCodec.MOON_CODEC_VERSION & 0x3) \
+            | ((_IDS.SERVICE_ID & 0x1F) << 2) \
+            | ((method & 0x3F) << 7) \
+            | ((self._sequence & 0x1F) << 13)
+        frame = bytes(encode_frame(struct.pack('<I', header)[:3] + args))
+
+        request = _Request(method, self._sequence, frame, self._loop.create_future(),
+            self._retries if retries is None else retries)
+        self._queue.append(request)
+        if self._current is None:
+            self._send_next()
+        return request.future
+
+    def flush(self):
+        """Drop the requests that haven't been sent (their futures are
+        cancelled); the one on the wire is still waited for"""
+        while self._queue:
+            self._queue.popleft().future.cancel()
+
+    @staticmethod
+    def _rto_key(method):
+        return 'ram' if method in _RAM_METHODS else method
+
+    def _rto_for(self, method):
+        key = self._rto_key(method)
+        if key not in self._rto:
+            self._rto[key] = _Rto(*self._rto_args)
+        return self._rto[key]
+
+    def _cancel_timer(self):
+        if self._timer is not None:
+            self._timer.cancel()
+            self._timer = None
+
+    def _transmit(self, request, resync=False):
+        frame = RESYNC + request.frame if resync else request.frame
+        request.attempts += 1
+        request.tx_time = len(frame) * self._byte_time
+        request.sent_at = time.monotonic()
+        if request.attempts == 1:
+            request.first_sent_at = request.sent_at
+        self._port.write(frame)
+        if self._trace is not None:
+            self._trace.record(frame_trace.TX, request.frame[3:-2])
+        self.sent += 1
+        self.bytes_sent += len(request.frame)
+        timeout = request.tx_time + self._rto_for(request.method).timeout(request.attempts)
+        self._timer = self._loop.call_later(timeout, self._on_timeout)
+
+    def _send_next(self):
+        self._current = self._queue.popleft() if self._queue else None
+        if self._current is not None:
+            self._transmit(self._current)
+
+    def _on_timeout(self):
+        self._timer = None
+        request = self._current
+        self.waited += time.monotonic() - request.sent_at
+
+        # A dropped request isn't resent; the timeout only made sure the device
+        # is done with it before the next one goes out
+        if request.attempts > request.retries or request.future.cancelled():
+            if not request.future.done():
+                request.future.set_exception(asyncio.TimeoutError(
+                    'no response to method {0} after {1} attempts'.format(request.method, request.attempts)))
+            self._send_next()
+            return
+
+        self.resent += 1
+        self._transmit(request, resync=request.attempts > 1)
+
+    def _on_readable(self):
+        data = self._port.read(self._port.in_waiting or 1)
+        if not data:
+            return
+        self.bytes_received += len(data)
+        self._decoder.feed(data)
+
+        while True:
+            try:
+                payload = self._decoder.decode()
+            except InvalidFrame as e:
+                self.bad_frames += 1
+                if self._trace is not None and isinstance(e, BadCrc):
+                    self._trace.record(frame_trace.RX_CRC, e.payload)
+                continue
+            if payload is None:
+                return
+            if self._trace is not None:
+                self._trace.record(frame_trace.RX, payload)
+            self._on_response(payload)
+
+    def _on_response(self, payload):
+        request = self._current
+        if request is None or len(payload) < 3:
+            return
+
+        header = payload[0] | (payload[1] << 8) | (payload[2] << 16)
+        method = (header >> 7) & 0x3F
+        sequence = (header >> 13) & 0x1F
+        protocol = (header >> 20) & 0xF
+        # Late responses to resent requests and the like
+        if method != request.method or sequence != request.sequence:
+            return
+
+        self._cancel_timer()
+        if request.attempts > 1:
+            self.recovered.append((request.first_sent_at, time.monotonic()))
+        # Round trips of resent requests are ambiguous (Karn); without any
+        # sample yet, one from the last send (it can only be short) still
+        # beats waiting out the initial timeout again
+        rto = self._rto_for(method)
+        if request.attempts == 1 or rto.srtt is None:
+            rto.sample(max(0.0, time.monotonic() - request.sent_at - request.tx_time))
+
+        # Next frame out before anyone looks at this response
+        self._send_next()
+
+        if request.future.done():
+            return
+        if protocol != 0:
+            request.future.set_exception(UploadError('protocol error {0} for method {1}'.format(protocol, method)))
+        else:
+            request.future.set_result(bytes(payload[3:]))
+
+def _result(payload):
+    return struct.unpack_from('<b', payload)[0] if payload else 0
+
+class ChunkTuner(object):
+    """Data per request of 'method' (bl_writePageBuffer or bl_writeAddress)
+    on 'link', retuned by page_done() after each page or so.
+
+    Losses are counted per byte on the wire, over the last few pages, and the
+    chunk is the one that moves the most data per byte-time when every byte
+    is as likely to be hit: a request of c bytes of data plus 'overhead'
+    (framing, header, arguments and the response) gets through with
+    probability (1 - p)^(c + overhead), and each loss costs what the link
+    has been spending on one (timeouts, resyncs). A clean link, or one that
+    loses the odd frame whatever its length, gets the largest chunk; a noisy
+    one gets shorter frames, which grow back as the losses age out."""
+
+    def __init__(self, link, method, maximum, overhead, minimum=CHUNK_MIN, memory=0.8):
+        self.maximum = maximum
+        self.minimum = min(minimum, maximum)
+        self.overhead = overhead
+        self.size = maximum
+        self.smallest = maximum
+        self._link = link
+        self._method = method
+        self._memory = memory
+        self._seen = (link.resent, link.wire_bytes, link.waited)
+        self._lost = 0.0
+        self._bytes = 0.0
+        self._wait = 0.0
+
+    def page_done(self):
+        link = self._link
+        seen = (link.resent, link.wire_bytes, link.waited)
+        lost, wire_bytes, waited = [now - then for now, then in zip(seen, self._seen)]
+        self._seen = seen
+
+        self._lost = self._lost * self._memory + lost
+        self._bytes = self._bytes * self._memory + wire_bytes
+        self._wait = self._wait * self._memory + waited
+        if not self._lost or not self._bytes or not link.byte_time:
+            return
+
+        rate = -math.log1p(-min(0.5, self._lost / self._bytes))
+        penalty = self._wait / self._lost / link.byte_time
+        fixed = self.overhead + link.turnaround(self._method)
+
+        # Byte-times per byte of data: (attempt + penalty * P(lost)) / P(through) / c
+        def cost(c):
+            through = math.exp(-rate * (c + self.overhead))
+            return (c + fixed + penalty * (1 - through)) / (through * c)
+
+        self.size = min(range(self.minimum, self.maximum + 1), key=cost)
+        self.smallest = min(self.smallest, self.size)
+
+def _all_ff(data):
+    return data.count(0xFF) == len(data)
+
+class Progress(object):
+    """One status line: pages, throughput and time left"""
+
+    def __init__(self, n_pages, page_size, out=sys.stdout):
+        self.n_pages = n_pages
+        self.page_size = page_size
+        self.out = out
+        self.start = time.monotonic()
+        self.done = 0
+
+    def page_done(self):
+        self.done += 1
+        elapsed = time.monotonic() - self.start
+        rate = (self.done * self.page_size) / elapsed if elapsed > 0 else 0
+        left = (self.n_pages - self.done) * self.page_size / rate if rate > 0 else 0
+        self.out.write('\rPage {0}/{1}  {2:.1f} KB/s  ETA {3:d}:{4:02d}  '.format(
+            self.done, self.n_pages, rate / 1024, int(left) // 60, int(left) % 60))
+        self.out.flush()
+
+    def finish(self):
+        self.out.write('\n')
+        self.out.flush()
+
+def _page_requests(link, app_id, binf, page_no, page_size, chunk_size):
+    start = page_no * page_size
+    page = binf[start:start + page_size]
+
+    futures = [(_IDS.BL_ERASEPAGEBUFFER_ID, link.submit(_IDS.BL_ERASEPAGEBUFFER_ID))]
+
+    # The page buffer is FF after bl_erasePageBuffer
+    for offset in range(0, len(page), chunk_size):
+        chunk = page[offset:offset + chunk_size]
+        if _all_ff(chunk):
+            continue
+        args = struct.pack('<BH', len(chunk), offset) + chunk
+        futures.append((_IDS.BL_WRITEPAGEBUFFER_ID, link.submit(_IDS.BL_WRITEPAGEBUFFER_ID, args)))
+
+    # Pad page out to page_size (for CRC calculation)
+    crc = zlib.crc32(page + b'\xFF' * (page_size - len(page)))
+    args = struct.pack('<BIH', app_id, crc, page_no)
+    futures.append((_IDS.BL_WRITEPAGE_ID, link.submit(_IDS.BL_WRITEPAGE_ID, args)))
+
+    return futures
+
+async def call(link, method, args=b'', retries=None):
+    """One request through 'link'; the int8_t result (0 for methods without one)"""
+    return _result(await link.submit(method, args, retries))
+
+async def probe_page_size(link, sizes):
+    """The device's page size out of 'sizes', or None if it's none of them.
+    bl_writePageBuffer refuses (-2) a byte past the end of the page buffer;
+    one at size - 1 has to go in and one at size mustn't."""
+    for size in sorted(sizes, reverse=True):
+        await call(link, _IDS.BL_ERASEPAGEBUFFER_ID)
+        if await call(link, _IDS.BL_WRITEPAGEBUFFER_ID, struct.pack('<BH', 1, size - 1) + b'\xFF') != 0:
+            continue
+        r = await call(link, _IDS.BL_WRITEPAGEBUFFER_ID, struct.pack('<BH', 1, size) + b'\xFF')
+        return size if r != 0 else None
+    return None
+
+async def get_info(link):
+    """The device's DeviceInfo (bl_getInfo), or None if its firmware doesn't
+    have the method (it answers NO_METHOD)"""
+    try:
+        payload = await link.submit(_IDS.BL_GETINFO_ID)
+    except UploadError:
+        return None
+    if _result(payload) != 0 or len(payload) < 1 + DEVICE_INFO_LEN:
+        return None
+
+    codec = MoonCodec()
+    codec.buffer = bytearray(payload[1:])
+    return common.DeviceInfo()._read(codec)
+
+def has_boot_record(info):
+    """Whether the device keeps a boot record, i.e. bl_setActiveApp means
+    something (bl_getInfo's DeviceInfo; assumed for older firmware, info None)"""
+    return info is None or bool(info.features & common.Feature.FEATURE_BOOT_RECORD)
+
+async def probe_message_len(link):
+    """The longest request the device takes: MESSAGE_LEN_MAX if a
+    bl_writePageBuffer that long is answered, else MESSAGE_LEN_MIN. A device
+    drops a frame longer than its receive buffer without a word, so the probe
+    costs a timeout (one resend) there."""
+    size = MESSAGE_LEN_MAX - WRITE_PAGE_BUFFER_OVERHEAD
+    await call(link, _IDS.BL_ERASEPAGEBUFFER_ID)
+    try:
+        r = await call(link, _IDS.BL_WRITEPAGEBUFFER_ID, struct.pack('<BH', size, 0) + b'\xFF' * size, retries=1)
+    except asyncio.TimeoutError:
+        r = None
+    return MESSAGE_LEN_MAX if r == 0 else MESSAGE_LEN_MIN
+
+async def upload(link, app_id, binf, pages, page_size, chunk_size, depth=2, retries=5, progress=None):
+    """Write 'pages' (page numbers, ascending) of binf to an erased slot
+    through 'link', keeping 'depth' pages of requests queued. 'chunk_size'
+    is the largest chunk; returns the ChunkTuner the chunks came from."""
+    tuner = ChunkTuner(link, _IDS.BL_WRITEPAGEBUFFER_ID, min(chunk_size, page_size),
+        WRITE_PAGE_BUFFER_OVERHEAD + EXCHANGE_OVERHEAD)
+    queued = collections.deque()
+    latch_retries = 0
+    i = 0
+
+    while i < len(pages) or queued:
+        # Keep 'depth' pages of requests queued behind the one being confirmed
+        while i < len(pages) and len(queued) < depth:
+            queued.append((i, _page_requests(link, app_id, binf, pages[i], page_size, tuner.size)))
+            i += 1
+
+        index, futures = queued.popleft()
+        rewind = False
+        for method, future in futures:
+            r = _result(await future)
+
+            if method == _IDS.BL_WRITEPAGE_ID and r == WRITE_PAGE_E_LATCH:
+                # Direct-latch builds (CONFIG_FLASH_DIRECT_LATCH): another
+                # flash write went through the latch before the page was
+                # programmed; start over from this page
+                latch_retries += 1
+                if latch_retries > retries:
+                    raise UploadError('page {0}: page buffer kept being overwritten'.format(pages[index]))
+                rewind = True
+            elif r != 0:
+                raise UploadError('page {0}: method {1} failed ({2})'.format(pages[index], method, r))
+
+        if rewind:
+            link.flush()
+            for _, later in queued:
+                for _, future in later:
+                    future.cancel()
+            queued.clear()
+            i = index
+            continue
+
+        # Chunks of the pages queued from here on are sized for the losses so far
+        tuner.page_done()
+
+        if progress is not None:
+            progress.page_done()
+
+    return tuner
+
+async def write_address(link, app_id, segments, chunk_size, block=512):
+    """Write (offset, data) segments into an erased slot with
+    bl_writeAddress, in the order given, then flush the device's page cache.
+    A block's worth of chunks is queued at a time and the chunk size retuned
+    between blocks. Resending a chunk is harmless (same bytes, same page).
+    Returns the ChunkTuner."""
+    tuner = ChunkTuner(link, _IDS.BL_WRITEADDRESS_ID, chunk_size, WRITE_ADDRESS_OVERHEAD + EXCHANGE_OVERHEAD)
+
+    for offset, data in segments:
+        start = 0
+        while start < len(data):
+            futures = []
+            end = min(len(data), start + block)
+            while start < end:
+                chunk = data[start:start + tuner.size]
+                args = struct.pack('<BII', app_id, len(chunk), offset + start) + chunk
+                futures.append((offset + start, link.submit(_IDS.BL_WRITEADDRESS_ID, args)))
+                start += len(chunk)
+
+            for address, future in futures:
+                r = _result(await future)
+                if r != 0:
+                    link.flush()
+                    raise UploadError('write at {0:#x} failed ({1})'.format(address, r))
+
+            tuner.page_done()
+
+    r = await call(link, _IDS.BL_FLUSHWRITES_ID)
+    if r != 0:
+        raise UploadError('flushing the page cache failed ({0})'.format(r))
+
+    return tuner
+
+def _stats(link, tuner):
+    return {'sent': link.sent, 'resent': link.resent, 'bad_frames': link.bad_frames,
+            'chunk_size': tuner.size, 'smallest_chunk': tuner.smallest}
+
+def _run(port, sequence, retries, coro, trace=None):
+    """Run coro(link) on a Link of its own; (sequence, result)"""
+    loop = asyncio.new_event_loop()
+    link = Link(port, loop, sequence=sequence, retries=retries, trace=trace)
+    try:
+        result = loop.run_until_complete(coro(link))
+    finally:
+        link.close()
+        loop.close()
+    return link.sequence, result
+
+def probe(port, page_sizes, sequence=0, retries=5, trace=None):
+    """Page size and longest request of the device on 'port', as it reports
+    them (bl_getInfo). Older firmware is probed instead: its page size out of
+    'page_sizes' (None if it's none of them; a single size is taken as given
+    and none skips that probe).
+
+    Returns (sequence, page_size, message_len, info); info is the DeviceInfo,
+    None for older firmware."""
+
+    async def run(link):
+        info = await get_info(link)
+        if info is not None:
+            return info.page_size, min(info.max_message_len, MESSAGE_LEN_MAX), info
+        if len(page_sizes) < 2:
+            page_size = page_sizes[0] if page_sizes else None
+        else:
+            page_size = await probe_page_size(link, page_sizes)
+        return page_size, await probe_message_len(link), None
+
+    sequence, (page_size, message_len, info) = _run(port, sequence, retries, run, trace)
+    return sequence, page_size, message_len, info
+
+def upload_pages(port, app_id, binf, pages, page_size, chunk_size, depth=2,
+                 retries=5, sequence=0, progress=True, trace=None):
+    """Write 'pages' (page numbers, ascending) of binf to an erased slot
+    through 'port' (an open pyserial port; it must have a fileno()).
+
+    Returns (sequence, stats) where sequence is the last sequence number used
+    (to carry on with) and stats a dict of sent / resent / bad_frames and the
+    final and smallest chunk size."""
+    bar = Progress(len(pages), page_size) if progress else None
+
+    async def run(link):
+        tuner = await upload(link, app_id, binf, pages, page_size, chunk_size, depth, retries, bar)
+        return _stats(link, tuner)
+
+    try:
+        return _run(port, sequence, retries, run, trace)
+    finally:
+        if bar is not None:
+            bar.finish()
+
+def write_segments(port, app_id, segments, chunk_size, retries=5, sequence=0, trace=None):
+    """write_address() through 'port'; (sequence, stats) as upload_pages()"""
+
+    async def run(link):
+        tuner = await write_address(link, app_id, segments, chunk_size)
+        return _stats(link, tuner)
+
+    return _run(port, sequence, retries, run, trace)
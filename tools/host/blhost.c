@@ -0,0 +1,766 @@
+
+#include "blhost.h"
+
+#include "sll.h"
+#include "crc.h"
+#include "moon/codec.h"
+#include "moon/services/bootloader.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+_Static_assert( BLHOST_CHUNK_MAX == (MOON_MAX_MESSAGE_LEN - 6), "BLHOST_CHUNK_MAX is out of step with MOON_MAX_MESSAGE_LEN" );
+
+// 3 header bytes; arguments / results start right after
+#define MSG_ARGS_START	3
+
+// bl_writePage: the latch was taken by another flash write (direct-latch builds)
+#define WRITE_PAGE_E_LATCH	(-4)
+
+// bl_verifyApp: still hashing
+#define VERIFY_BUSY			1
+#define VERIFY_POLL_MS		20
+
+// A request on its way out, kept until its response is in so it can be resent
+// as is (same sequence number; the device counts it as a retry)
+typedef struct {
+	sll_decode_frame_t frame;
+	uint8_t buffer[SLL_MAX_MSG_LEN];
+	uint32_t len;		// Encoded frame length
+	uint8_t method;
+	uint8_t sequence;
+	uint16_t page_no;	// bl_writePage only (blhost_upload())
+} tx_slot_t;
+
+struct blhost {
+	int fd;
+	struct termios saved_tio;
+
+	uint32_t timeout_ms;
+	uint32_t retries;
+	uint8_t sequence;
+
+	// Two so the next request can be built while the current one is out
+	tx_slot_t tx[2];
+
+	sll_decode_frame_t rx_frame;
+	uint8_t rx_buffer[SLL_MAX_MSG_LEN];
+
+	// Read from the port but not decoded yet (what followed a response)
+	uint8_t rx_pending[256];
+	uint32_t rx_head;
+	uint32_t rx_tail;
+
+	uint32_t sent;
+	uint32_t resent;
+	uint32_t crc_errors;
+};
+
+// -- Serial port ----------------------------------------------------------- //
+
+static speed_t __baud_to_speed( uint32_t baud )
+{
+	switch ( baud ) {
+		case 9600:		return B9600;
+		case 19200:		return B19200;
+		case 38400:		return B38400;
+		case 57600:		return B57600;
+		case 115200:	return B115200;
+		case 230400:	return B230400;
+		case 460800:	return B460800;
+		case 921600:	return B921600;
+		default:		return B0;
+	}
+}
+
+static int64_t __now_ms()
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+
+	return ((int64_t)ts.tv_sec * 1000) + (ts.tv_nsec / 1000000);
+}
+
+blhost_t * blhost_open( const char * path, uint32_t baud )
+{
+	struct termios tio;
+	speed_t speed;
+	blhost_t * host;
+	int saved_errno;
+
+	speed = __baud_to_speed( baud );
+	if ( (! path) || (speed == B0) ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	host = calloc( 1, sizeof(blhost_t) );
+	if ( ! host ) {
+		return NULL;
+	}
+
+	host->fd = open( path, O_RDWR | O_NOCTTY | O_NONBLOCK );
+	if ( host->fd < 0 ) {
+		goto fail;
+	}
+
+	if ( tcgetattr( host->fd, &host->saved_tio ) < 0 ) {
+		goto fail_close;
+	}
+
+	// Raw 8N1; reads never block (poll() does the waiting)
+	tio = host->saved_tio;
+	cfmakeraw( &tio );
+	tio.c_cflag |= CLOCAL | CREAD;
+	tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+	tio.c_iflag &= ~(IXON | IXOFF | IXANY);
+	tio.c_cc[VMIN] = 0;
+	tio.c_cc[VTIME] = 0;
+	cfsetispeed( &tio, speed );
+	cfsetospeed( &tio, speed );
+
+	if ( tcsetattr( host->fd, TCSANOW, &tio ) < 0 ) {
+		goto fail_close;
+	}
+
+	tcflush( host->fd, TCIOFLUSH );
+
+	host->timeout_ms = BLHOST_DEFAULT_TIMEOUT_MS;
+	host->retries = BLHOST_DEFAULT_RETRIES;
+
+	sll_init( &host->tx[0].frame, host->tx[0].buffer, sizeof(host->tx[0].buffer) );
+	sll_init( &host->tx[1].frame, host->tx[1].buffer, sizeof(host->tx[1].buffer) );
+	sll_init( &host->rx_frame, host->rx_buffer, sizeof(host->rx_buffer) );
+
+	return host;
+
+fail_close:
+	saved_errno = errno;
+	close( host->fd );
+	errno = saved_errno;
+fail:
+	saved_errno = errno;
+	free( host );
+	errno = saved_errno;
+	return NULL;
+}
+
+void blhost_close( blhost_t * host )
+{
+	if ( ! host ) {
+		return;
+	}
+
+	tcsetattr( host->fd, TCSANOW, &host->saved_tio );
+	close( host->fd );
+	free( host );
+}
+
+void blhost_set_timeout( blhost_t * host, uint32_t timeout_ms, uint32_t retries )
+{
+	host->timeout_ms = timeout_ms;
+	host->retries = retries;
+}
+
+void blhost_get_counters( blhost_t * host, uint32_t * sent, uint32_t * resent, uint32_t * crc_errors )
+{
+	if ( sent ) {
+		*sent = host->sent;
+	}
+	if ( resent ) {
+		*resent = host->resent;
+	}
+	if ( crc_errors ) {
+		*crc_errors = host->crc_errors;
+	}
+}
+
+static int __write_all( blhost_t * host, const uint8_t * data, uint32_t len )
+{
+	struct pollfd pfd = { .fd = host->fd, .events = POLLOUT };
+	ssize_t n;
+
+	while ( len ) {
+		n = write( host->fd, data, len );
+		if ( n < 0 ) {
+			if ( (errno != EAGAIN) && (errno != EINTR) ) {
+				return BLHOST_E_IO;
+			}
+
+			// Output queue is full; the port drains it at the baud rate
+			if ( poll( &pfd, 1, host->timeout_ms ) <= 0 ) {
+				return BLHOST_E_IO;
+			}
+			continue;
+		}
+
+		data += n;
+		len -= n;
+	}
+
+	return 0;
+}
+
+// -- Requests -------------------------------------------------------------- //
+
+// Build request 'method' into tx slot 'slot' with the argument bytes of
+// 'msg' (everything after the header)
+static int __prepare( blhost_t * host, uint32_t slot, uint8_t method, const uint8_t * msg, uint32_t len )
+{
+	tx_slot_t * tx = &host->tx[slot];
+	uint8_t * data = sll_get_data_buffer( &tx->frame );
+	moon_msg_hdr_t header;
+	int ret;
+
+	if ( (len < MSG_ARGS_START) || (len > MOON_MAX_MESSAGE_LEN) ) {
+		return BLHOST_E_ARG;
+	}
+
+	header.type = MSG_TYPE_SINGLE_NORMAL;
+	header.service = kBootloader_service_id;
+	header.method = method;
+	header.sequence = host->sequence;
+	header.protocol = 0;
+
+	host->sequence = (host->sequence + 1) & 0x1F;
+
+	// NOTE: The header goes in first; it's written as a whole word
+	moon_codec_write_header( data, &header );
+	memcpy( &data[MSG_ARGS_START], &msg[MSG_ARGS_START], len - MSG_ARGS_START );
+
+	ret = sll_encode( &tx->frame, len );
+	if ( ret < 0 ) {
+		return BLHOST_E_ARG;
+	}
+
+	tx->len = ret;
+	tx->method = method;
+	tx->sequence = header.sequence;
+
+	return 0;
+}
+
+static int __send( blhost_t * host, uint32_t slot )
+{
+	host->sent++;
+
+	return __write_all( host, host->tx[slot].buffer, host->tx[slot].len );
+}
+
+// Wait for the response to the request in 'slot'. Anything else that decodes
+// (e.g. a late response to a request that was resent) is dropped.
+static int __await( blhost_t * host, uint32_t slot, uint32_t timeout_ms )
+{
+	struct pollfd pfd = { .fd = host->fd, .events = POLLIN };
+	tx_slot_t * tx = &host->tx[slot];
+	int64_t deadline = __now_ms() + timeout_ms;
+	int64_t remaining;
+	moon_msg_hdr_t header;
+	uint8_t * data;
+	ssize_t n;
+	int ret;
+
+	for ( ;; ) {
+		while ( host->rx_head != host->rx_tail ) {
+			ret = sll_decode( &host->rx_frame, host->rx_pending[host->rx_head++] );
+
+			if ( ret < 0 ) {
+				host->crc_errors++;
+				continue;
+			} else if ( ret == 0 ) {
+				continue;
+			}
+
+			data = sll_get_data_buffer( &host->rx_frame );
+			if ( (sll_get_decoded_len( &host->rx_frame ) < MSG_ARGS_START)
+				|| (moon_codec_read_header( data, &header ) < 0) ) {
+				continue;
+			}
+
+			if ( (header.type != MSG_TYPE_SINGLE_NORMAL)
+				|| (header.service != kBootloader_service_id)
+				|| (header.method != tx->method)
+				|| (header.sequence != tx->sequence) ) {
+				continue;
+			}
+
+			return (header.protocol == MOON_PROT_OK) ? 0 : BLHOST_E_PROTOCOL;
+		}
+
+		host->rx_head = 0;
+		host->rx_tail = 0;
+
+		remaining = deadline - __now_ms();
+		if ( remaining <= 0 ) {
+			return BLHOST_E_TIMEOUT;
+		}
+
+		ret = poll( &pfd, 1, (int)remaining );
+		if ( ret < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			return BLHOST_E_IO;
+		} else if ( ret == 0 ) {
+			return BLHOST_E_TIMEOUT;
+		}
+
+		n = read( host->fd, host->rx_pending, sizeof(host->rx_pending) );
+		if ( n < 0 ) {
+			if ( (errno == EAGAIN) || (errno == EINTR) ) {
+				continue;
+			}
+			return BLHOST_E_IO;
+		}
+
+		host->rx_tail = n;
+	}
+}
+
+// Wait for the response to 'slot', resending the request on a timeout
+static int __await_retry( blhost_t * host, uint32_t slot, uint32_t timeout_ms )
+{
+	uint32_t attempt;
+	int ret;
+
+	for ( attempt = 0; ; attempt++ ) {
+		ret = __await( host, slot, timeout_ms );
+		if ( (ret != BLHOST_E_TIMEOUT) || (attempt >= host->retries) ) {
+			return ret;
+		}
+
+		host->resent++;
+		ret = __send( host, slot );
+		if ( ret < 0 ) {
+			return ret;
+		}
+	}
+}
+
+// int8_t result of the last response (0 for methods without one)
+static int __result( blhost_t * host )
+{
+	int8_t result;
+
+	if ( sll_get_decoded_len( &host->rx_frame ) <= MSG_ARGS_START ) {
+		return 0;
+	}
+
+	moon_codec_read_i8( sll_get_data_buffer( &host->rx_frame ), &result, MSG_ARGS_START );
+
+	return result;
+}
+
+int blhost_call( blhost_t * host, uint8_t method, uint8_t * msg, uint32_t len,
+	uint32_t * resp_len, uint32_t timeout_ms )
+{
+	uint32_t n;
+	int ret;
+
+	if ( (! host) || (! msg) ) {
+		return BLHOST_E_ARG;
+	}
+
+	ret = __prepare( host, 0, method, msg, len );
+	if ( ret < 0 ) {
+		return ret;
+	}
+
+	ret = __send( host, 0 );
+	if ( ret < 0 ) {
+		return ret;
+	}
+
+	ret = __await_retry( host, 0, timeout_ms );
+	if ( ret < 0 ) {
+		return ret;
+	}
+
+	n = sll_get_decoded_len( &host->rx_frame );
+	if ( n > MOON_MAX_MESSAGE_LEN ) {
+		n = MOON_MAX_MESSAGE_LEN;
+	}
+
+	memcpy( msg, sll_get_data_buffer( &host->rx_frame ), n );
+
+	if ( resp_len ) {
+		*resp_len = n;
+	}
+
+	return 0;
+}
+
+// Call 'method' with the arguments in 'msg' and return its int8_t result
+static int __call_result( blhost_t * host, uint8_t method, uint8_t * msg, uint32_t len, uint32_t timeout_ms )
+{
+	int ret = blhost_call( host, method, msg, len, NULL, timeout_ms );
+
+	return (ret < 0) ? ret : __result( host );
+}
+
+// -- Bootloader service ---------------------------------------------------- //
+
+int blhost_ping( blhost_t * host )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	return __call_result( host, kBootloader_bl_ping_id, msg, MSG_ARGS_START, host->timeout_ms );
+}
+
+int blhost_erase_page_buffer( blhost_t * host )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	return __call_result( host, kBootloader_bl_erasePageBuffer_id, msg, MSG_ARGS_START, host->timeout_ms );
+}
+
+// length = [3,1], offset = [4,2], data = [6,length]
+static uint32_t __write_page_buffer_msg( uint8_t * msg, uint16_t offset, const uint8_t * data, uint8_t len )
+{
+	moon_codec_write_u8( msg, len, 3 );
+	moon_codec_write_u16( msg, offset, 4 );
+	memcpy( &msg[6], data, len );
+
+	return 6 + len;
+}
+
+int blhost_write_page_buffer( blhost_t * host, uint16_t offset, const uint8_t * data, uint8_t len )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	if ( (! data) || (len > BLHOST_CHUNK_MAX) ) {
+		return BLHOST_E_ARG;
+	}
+
+	return __call_result( host, kBootloader_bl_writePageBuffer_id, msg,
+		__write_page_buffer_msg( msg, offset, data, len ), host->timeout_ms );
+}
+
+// app_id = [3,1], crc = [4,4], page_no = [8,2]
+static uint32_t __write_page_msg( uint8_t * msg, uint8_t app_id, uint16_t page_no, uint32_t crc )
+{
+	moon_codec_write_u8( msg, app_id, 3 );
+	moon_codec_write_u32( msg, crc, 4 );
+	moon_codec_write_u16( msg, page_no, 8 );
+
+	return 10;
+}
+
+int blhost_write_page( blhost_t * host, uint8_t app_id, uint16_t page_no, uint32_t crc )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	return __call_result( host, kBootloader_bl_writePage_id, msg,
+		__write_page_msg( msg, app_id, page_no, crc ), host->timeout_ms );
+}
+
+int blhost_erase_app( blhost_t * host, uint8_t app_id )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	moon_codec_write_u8( msg, app_id, 3 );
+
+	return __call_result( host, kBootloader_bl_eraseApp_id, msg, 4, BLHOST_SLOW_TIMEOUT_MS );
+}
+
+// app_id = [3,1], length = [4,4], crc = [8,4]; bl_beginUpload,
+// bl_verifyApp and bl_setActiveApp
+static int __call_app_length_crc( blhost_t * host, uint8_t method, uint8_t app_id,
+	uint32_t length, uint32_t crc, uint32_t timeout_ms )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	moon_codec_write_u8( msg, app_id, 3 );
+	moon_codec_write_u32( msg, length, 4 );
+	moon_codec_write_u32( msg, crc, 8 );
+
+	return __call_result( host, method, msg, 12, timeout_ms );
+}
+
+int blhost_begin_upload( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc )
+{
+	return __call_app_length_crc( host, kBootloader_bl_beginUpload_id, app_id, length, crc, BLHOST_SLOW_TIMEOUT_MS );
+}
+
+// NOTE: The device hashes the slot in the background and answers 1 until it's
+// done; this polls until it has an answer (0 match, (-2) mismatch)
+int blhost_verify_app( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc )
+{
+	struct timespec pause = { .tv_sec = 0, .tv_nsec = VERIFY_POLL_MS * 1000000L };
+	int64_t deadline = __now_ms() + BLHOST_SLOW_TIMEOUT_MS;
+	int ret;
+
+	for ( ;; ) {
+		ret = __call_app_length_crc( host, kBootloader_bl_verifyApp_id, app_id, length, crc, host->timeout_ms );
+		if ( ret != VERIFY_BUSY ) {
+			return ret;
+		}
+
+		if ( __now_ms() > deadline ) {
+			return BLHOST_E_TIMEOUT;
+		}
+
+		nanosleep( &pause, NULL );
+	}
+}
+
+int blhost_set_active_app( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc )
+{
+	return __call_app_length_crc( host, kBootloader_bl_setActiveApp_id, app_id, length, crc, host->timeout_ms );
+}
+
+int blhost_set_boot_action( blhost_t * host, uint8_t action )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	moon_codec_write_u8( msg, action, 3 );
+
+	return __call_result( host, kBootloader_bl_setBootAction_id, msg, 4, host->timeout_ms );
+}
+
+int blhost_boot( blhost_t * host )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN];
+
+	return __call_result( host, kBootloader_bl_boot_id, msg, MSG_ARGS_START, host->timeout_ms );
+}
+
+uint32_t blhost_crc_32( const uint8_t * data, uint32_t len )
+{
+	return crc_32_finalize( crc_32_update_block( CRC_32_INIT_VALUE, data, len ) );
+}
+
+// -- Upload ---------------------------------------------------------------- //
+
+typedef enum {
+	UPLOAD_ERASE = 0,	// bl_erasePageBuffer
+	UPLOAD_CHUNKS,		// bl_writePageBuffer for each chunk that isn't all FF
+	UPLOAD_COMMIT		// bl_writePage
+} upload_phase_t;
+
+typedef struct {
+	const uint8_t * image;
+	uint32_t len;
+	uint32_t page_size;
+	uint32_t chunk_size;
+	uint8_t app_id;
+
+	uint32_t n_pages;
+	uint32_t page;
+	uint32_t offset;
+	upload_phase_t phase;
+} upload_t;
+
+static bool __all_ff( const uint8_t * data, uint32_t len )
+{
+	while ( len-- ) {
+		if ( *data++ != 0xFF ) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+// Bytes of the image in 'page' (the last page may be short)
+static uint32_t __page_len( const upload_t * up, uint32_t page )
+{
+	uint32_t start = page * up->page_size;
+
+	return ((up->len - start) < up->page_size) ? (up->len - start) : up->page_size;
+}
+
+// CRC-32 of 'page' as the device sees it: FF past the end of the image
+static uint32_t __page_crc( const upload_t * up, uint32_t page )
+{
+	uint32_t len = __page_len( up, page );
+	uint32_t crc = crc_32_update_block( CRC_32_INIT_VALUE, &up->image[page * up->page_size], len );
+
+	for ( ; len < up->page_size; len++ ) {
+		crc = crc_32_update( crc, 0xFF );
+	}
+
+	return crc_32_finalize( crc );
+}
+
+// Build the next request of the upload into 'slot'; 0 once there's nothing
+// left to send
+static int __upload_next( blhost_t * host, upload_t * up, uint32_t slot )
+{
+	uint8_t msg[MOON_MAX_MESSAGE_LEN] = { 0 };
+	const uint8_t * page;
+	uint32_t page_len;
+	uint32_t n;
+	int ret;
+
+	while ( up->page < up->n_pages ) {
+		page = &up->image[up->page * up->page_size];
+		page_len = __page_len( up, up->page );
+
+		switch ( up->phase ) {
+			case UPLOAD_ERASE:
+				// Erased pages are already right in the erased slot
+				if ( __all_ff( page, page_len ) ) {
+					up->page++;
+					continue;
+				}
+
+				up->phase = UPLOAD_CHUNKS;
+				up->offset = 0;
+				return (__prepare( host, slot, kBootloader_bl_erasePageBuffer_id, msg, MSG_ARGS_START ) < 0) ? (-1) : 1;
+
+			case UPLOAD_CHUNKS:
+				while ( up->offset < page_len ) {
+					n = ((page_len - up->offset) < up->chunk_size) ? (page_len - up->offset) : up->chunk_size;
+
+					// The page buffer is FF after bl_erasePageBuffer
+					if ( __all_ff( &page[up->offset], n ) ) {
+						up->offset += n;
+						continue;
+					}
+
+					ret = __prepare( host, slot, kBootloader_bl_writePageBuffer_id, msg,
+						__write_page_buffer_msg( msg, up->offset, &page[up->offset], n ) );
+					up->offset += n;
+					return (ret < 0) ? (-1) : 1;
+				}
+
+				up->phase = UPLOAD_COMMIT;
+				continue;
+
+			case UPLOAD_COMMIT:
+				host->tx[slot].page_no = up->page;
+				ret = __prepare( host, slot, kBootloader_bl_writePage_id, msg,
+					__write_page_msg( msg, up->app_id, up->page, __page_crc( up, up->page ) ) );
+				up->phase = UPLOAD_ERASE;
+				up->page++;
+				return (ret < 0) ? (-1) : 1;
+		}
+	}
+
+	return 0;
+}
+
+int blhost_upload( blhost_t * host, uint8_t app_id, const uint8_t * image, uint32_t len,
+	const blhost_upload_opts_t * opts )
+{
+	upload_t up;
+	uint32_t crc;
+	uint32_t data_pages;
+	uint32_t done;
+	uint32_t latch_retries = 0;
+	uint32_t cur = 0;
+	uint32_t p;
+	int more;
+	int ret;
+
+	if ( (! host) || (! image) || (! len) || (! opts) || (! opts->page_size)
+		|| (opts->chunk_size > BLHOST_CHUNK_MAX) ) {
+		return BLHOST_E_ARG;
+	}
+
+	up.image = image;
+	up.len = len;
+	up.page_size = opts->page_size;
+	up.chunk_size = opts->chunk_size ? opts->chunk_size : BLHOST_CHUNK_MAX;
+	up.app_id = app_id;
+	up.n_pages = (len + opts->page_size - 1) / opts->page_size;
+	up.page = 0;
+	up.offset = 0;
+	up.phase = UPLOAD_ERASE;
+
+	if ( up.n_pages > UINT16_MAX ) {
+		return BLHOST_E_ARG;
+	}
+
+	data_pages = 0;
+	for ( p = 0; p < up.n_pages; p++ ) {
+		data_pages += ! __all_ff( &image[p * up.page_size], __page_len( &up, p ) );
+	}
+
+	crc = blhost_crc_32( image, len );
+
+	// Erases the slot
+	ret = blhost_begin_upload( host, app_id, len, crc );
+	if ( ret != 0 ) {
+		return ret;
+	}
+
+	more = __upload_next( host, &up, cur );
+	if ( more < 0 ) {
+		return BLHOST_E_ARG;
+	}
+
+	if ( more ) {
+		ret = __send( host, cur );
+		if ( ret < 0 ) {
+			return ret;
+		}
+	}
+
+	done = 0;
+	while ( more ) {
+		// The next request is built while the device handles this one
+		more = __upload_next( host, &up, ! cur );
+		if ( more < 0 ) {
+			return BLHOST_E_ARG;
+		}
+
+		ret = __await_retry( host, cur, host->timeout_ms );
+		if ( ret < 0 ) {
+			return ret;
+		}
+
+		ret = __result( host );
+
+		if ( (host->tx[cur].method == kBootloader_bl_writePage_id) && (ret == WRITE_PAGE_E_LATCH) ) {
+			// Direct-latch builds (CONFIG_FLASH_DIRECT_LATCH): another flash
+			// write went through the latch before the page was programmed;
+			// drop what was built next and send the page again
+			if ( latch_retries++ >= host->retries ) {
+				return ret;
+			}
+
+			up.page = host->tx[cur].page_no;
+			up.phase = UPLOAD_ERASE;
+			more = __upload_next( host, &up, ! cur );
+			if ( more < 0 ) {
+				return BLHOST_E_ARG;
+			}
+		} else if ( ret != 0 ) {
+			return ret;
+		} else if ( host->tx[cur].method == kBootloader_bl_writePage_id ) {
+			done++;
+			if ( opts->progress ) {
+				opts->progress( opts->progress_arg, done, data_pages );
+			}
+		}
+
+		if ( more ) {
+			cur = ! cur;
+			ret = __send( host, cur );
+			if ( ret < 0 ) {
+				return ret;
+			}
+		}
+	}
+
+	// One device-side CRC of the whole slot instead of reading it back
+	ret = blhost_verify_app( host, app_id, len, crc );
+	if ( ret < 0 ) {
+		return (ret <= BLHOST_E_ARG) ? ret : BLHOST_E_VERIFY;
+	}
+
+	if ( opts->activate ) {
+		return blhost_set_active_app( host, app_id, len, crc );
+	}
+
+	return 0;
+}
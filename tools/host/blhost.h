@@ -0,0 +1,105 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef BLHOST_H
+#define BLHOST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Host-side bootloader client (Linux)
+//
+// Speaks the same framing as the device by building the firmware's own link
+// layer and codec (src/common/sll.c, crc.c, moon/codec.c) for the host; only
+// the serial port handling (a raw, non-blocking termios descriptor waited on
+// with poll()) and the request / response matching are new here.
+//
+// RPC wrappers return the device's result (an int8_t, so never below -128)
+// or one of the BLHOST_E_* codes below, which are out of that range.
+//
+// NOTE: One request is in flight at a time. The bootloader reads its USART a
+// character at a time into a single frame buffer while it isn't busy handling
+// a request, so a second frame sent before the first one's response would be
+// lost in an overrun. blhost_upload() pipelines the host side instead: the
+// next frame is built while the device works on the current one and goes out
+// as soon as the response is in.
+
+#define BLHOST_E_ARG		(-200)	// Invalid argument
+#define BLHOST_E_IO			(-201)	// Serial port read / write failed
+#define BLHOST_E_TIMEOUT	(-202)	// No response after the retries
+#define BLHOST_E_PROTOCOL	(-203)	// Response was a protocol error (no service / method, bad syntax)
+#define BLHOST_E_VERIFY		(-204)	// Slot didn't match the image after writing
+
+#define BLHOST_DEFAULT_TIMEOUT_MS	1000
+#define BLHOST_DEFAULT_RETRIES		5
+
+// Whole-slot erase (bl_beginUpload / bl_eraseApp) and hashing (bl_verifyApp)
+// take far longer than a regular request
+#define BLHOST_SLOW_TIMEOUT_MS		20000
+
+// Largest bl_writePageBuffer chunk that fits a message (3 byte header, length,
+// offset)
+#define BLHOST_CHUNK_MAX	(64 - 6)
+
+typedef struct blhost blhost_t;
+
+// Progress callback for blhost_upload(): 'page' of 'n_pages' pages holding
+// data has been programmed
+typedef void (*blhost_progress_t)( void * arg, uint32_t page, uint32_t n_pages );
+
+typedef struct {
+	uint32_t page_size;		// Device flash page size (512 V71, 256 RH71)
+	uint32_t chunk_size;	// bl_writePageBuffer payload; 0 for BLHOST_CHUNK_MAX
+	bool activate;			// bl_setActiveApp once the slot verifies
+	blhost_progress_t progress;
+	void * progress_arg;
+} blhost_upload_opts_t;
+
+// Open and configure 'path' (raw 8N1, no flow control) at 'baud'; NULL on
+// failure (errno is set)
+blhost_t * blhost_open( const char * path, uint32_t baud );
+
+void blhost_close( blhost_t * host );
+
+// Response timeout for regular requests and the number of times a request is
+// resent (same sequence number) before BLHOST_E_TIMEOUT
+void blhost_set_timeout( blhost_t * host, uint32_t timeout_ms, uint32_t retries );
+
+// Frames sent / resent and frames dropped on a bad CRC or length since open
+void blhost_get_counters( blhost_t * host, uint32_t * sent, uint32_t * resent, uint32_t * crc_errors );
+
+// Generic request: 'msg' holds 'len' bytes of which the first 3 (the header)
+// are filled in here; the response replaces it and its length is returned
+// through 'resp_len'. 'msg' has to have room for MOON_MAX_MESSAGE_LEN bytes.
+int blhost_call( blhost_t * host, uint8_t method, uint8_t * msg, uint32_t len,
+	uint32_t * resp_len, uint32_t timeout_ms );
+
+// -- Bootloader service -- //
+int blhost_ping( blhost_t * host );
+int blhost_erase_page_buffer( blhost_t * host );
+int blhost_write_page_buffer( blhost_t * host, uint16_t offset, const uint8_t * data, uint8_t len );
+int blhost_write_page( blhost_t * host, uint8_t app_id, uint16_t page_no, uint32_t crc );
+int blhost_erase_app( blhost_t * host, uint8_t app_id );
+int blhost_begin_upload( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc );
+int blhost_verify_app( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc );
+int blhost_set_active_app( blhost_t * host, uint8_t app_id, uint32_t length, uint32_t crc );
+int blhost_set_boot_action( blhost_t * host, uint8_t action );
+int blhost_boot( blhost_t * host );
+
+// CRC-32 (IEEE) of an image, as the device computes it
+uint32_t blhost_crc_32( const uint8_t * data, uint32_t len );
+
+// Write a raw binary image to slot 'app_id' (0 = APP_1, 1 = APP_2): start an
+// upload session (erases the slot), program the pages that hold data, have
+// the device check the whole slot and optionally make it the active one.
+// Returns 0, a device result from the step that failed or BLHOST_E_*.
+int blhost_upload( blhost_t * host, uint8_t app_id, const uint8_t * image, uint32_t len,
+	const blhost_upload_opts_t * opts );
+
+#endif // BLHOST_H
+
+#ifdef __cplusplus
+}
+#endif
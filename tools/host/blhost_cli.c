@@ -0,0 +1,255 @@
+
+// Command line front end for the host client library (blhost.h)
+//
+// Covers the common path of tools/blcli.py natively: ping, write a raw binary
+// to a slot (verified on the device, made active, booted) and boot a slot.
+// Packed images (imgpack.py), ELF / HEX files and the diagnostics stay in
+// blcli.py.
+
+#include "blhost.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Per board, as in blcli.py
+typedef struct {
+	const char * name;
+	uint32_t page_size;
+	uint32_t baud;
+} board_t;
+
+static const board_t boards_g[] = {
+	{ "v71",	512,	38400 },
+	{ "rh71",	256,	19200 },
+};
+
+static void __usage( const char * prog )
+{
+	fprintf( stderr,
+		"usage: %s -d DEVICE [options] COMMAND\n"
+		"\n"
+		"commands:\n"
+		"  ping             check the bootloader answers\n"
+		"  write FILE       write a raw binary to the slot, verify it and make it active\n"
+		"  boot             boot the slot\n"
+		"\n"
+		"options:\n"
+		"  -d DEVICE        serial port\n"
+		"  -B BOARD         v71 (default) or rh71; sets the page size and baud rate\n"
+		"  -b BAUD          baud rate override\n"
+		"  -p PAGE_SIZE     page size override\n"
+		"  -a APP           slot, 1 (default) or 2\n"
+		"  -c CHUNK         bl_writePageBuffer payload (1 to %u)\n"
+		"  -t TIMEOUT_MS    response timeout\n"
+		"  -r RETRIES       resends before giving up\n"
+		"  -n               don't boot after 'write'\n"
+		"  -s               don't make the slot active after 'write' (bootloaders\n"
+		"                   without a boot record boot a fixed slot)\n",
+		prog, BLHOST_CHUNK_MAX );
+}
+
+static uint8_t * __read_file( const char * path, uint32_t * len )
+{
+	FILE * f;
+	uint8_t * data;
+	long size;
+
+	f = fopen( path, "rb" );
+	if ( ! f ) {
+		return NULL;
+	}
+
+	if ( (fseek( f, 0, SEEK_END ) < 0) || ((size = ftell( f )) <= 0) || (fseek( f, 0, SEEK_SET ) < 0) ) {
+		fclose( f );
+		errno = EINVAL;
+		return NULL;
+	}
+
+	data = malloc( size );
+	if ( data && (fread( data, 1, size, f ) != (size_t)size) ) {
+		free( data );
+		data = NULL;
+	}
+
+	fclose( f );
+	*len = size;
+
+	return data;
+}
+
+static void __progress( void * arg, uint32_t page, uint32_t n_pages )
+{
+	(void)arg;
+
+	printf( "\rProgrammed %u of %u pages", page, n_pages );
+	fflush( stdout );
+}
+
+static int __boot( blhost_t * host, uint8_t app_id )
+{
+	int ret;
+
+	// BootAction is the slot number (BOOT_APP_1 = 1), AppId the index
+	ret = blhost_set_boot_action( host, app_id + 1 );
+	if ( ret != 0 ) {
+		fprintf( stderr, "Setting the boot action failed (%d)\n", ret );
+		return ret;
+	}
+
+	ret = blhost_boot( host );
+	if ( ret != 0 ) {
+		fprintf( stderr, "Boot refused (%d)\n", ret );
+	}
+
+	return ret;
+}
+
+static int __write( blhost_t * host, uint8_t app_id, const char * path, blhost_upload_opts_t * opts, int do_boot )
+{
+	struct timespec t0;
+	struct timespec t1;
+	uint8_t * image;
+	uint32_t len;
+	uint32_t sent;
+	uint32_t resent;
+	uint32_t crc_errors;
+	double seconds;
+	int ret;
+
+	image = __read_file( path, &len );
+	if ( ! image ) {
+		fprintf( stderr, "Can't read %s: %s\n", path, strerror( errno ) );
+		return (-1);
+	}
+
+	printf( "Writing %u bytes to APP_%u\n", len, app_id + 1 );
+
+	clock_gettime( CLOCK_MONOTONIC, &t0 );
+	ret = blhost_upload( host, app_id, image, len, opts );
+	clock_gettime( CLOCK_MONOTONIC, &t1 );
+	printf( "\n" );
+
+	free( image );
+
+	if ( ret != 0 ) {
+		fprintf( stderr, "Upload failed (%d)\n", ret );
+		return ret;
+	}
+
+	seconds = (t1.tv_sec - t0.tv_sec) + ((t1.tv_nsec - t0.tv_nsec) / 1e9);
+	blhost_get_counters( host, &sent, &resent, &crc_errors );
+	printf( "APP_%u written and verified in %.2f s (%.0f B/s; %u frames, %u resent, %u CRC errors)\n",
+		app_id + 1, seconds, len / seconds, sent, resent, crc_errors );
+
+	return do_boot ? __boot( host, app_id ) : 0;
+}
+
+int main( int argc, char * argv[] )
+{
+	const board_t * board = &boards_g[0];
+	blhost_upload_opts_t opts = { 0 };
+	const char * device = NULL;
+	const char * command;
+	blhost_t * host;
+	uint32_t baud = 0;
+	uint32_t timeout_ms = BLHOST_DEFAULT_TIMEOUT_MS;
+	uint32_t retries = BLHOST_DEFAULT_RETRIES;
+	uint32_t app = 1;
+	int do_boot = 1;
+	bool activate = true;
+	int ret;
+	int c;
+	size_t i;
+
+	while ( (c = getopt( argc, argv, "d:B:b:p:a:c:t:r:nsh" )) != -1 ) {
+		switch ( c ) {
+			case 'd':
+				device = optarg;
+				break;
+			case 'B':
+				board = NULL;
+				for ( i = 0; i < (sizeof(boards_g) / sizeof(boards_g[0])); i++ ) {
+					if ( ! strcmp( optarg, boards_g[i].name ) ) {
+						board = &boards_g[i];
+					}
+				}
+				if ( ! board ) {
+					fprintf( stderr, "Unknown board '%s'\n", optarg );
+					return 2;
+				}
+				break;
+			case 'b':
+				baud = strtoul( optarg, NULL, 0 );
+				break;
+			case 'p':
+				opts.page_size = strtoul( optarg, NULL, 0 );
+				break;
+			case 'a':
+				app = strtoul( optarg, NULL, 0 );
+				break;
+			case 'c':
+				opts.chunk_size = strtoul( optarg, NULL, 0 );
+				break;
+			case 't':
+				timeout_ms = strtoul( optarg, NULL, 0 );
+				break;
+			case 'r':
+				retries = strtoul( optarg, NULL, 0 );
+				break;
+			case 'n':
+				do_boot = 0;
+				break;
+			case 's':
+				activate = false;
+				break;
+			default:
+				__usage( argv[0] );
+				return 2;
+		}
+	}
+
+	if ( (! device) || (optind >= argc) || (app < 1) || (app > 2)
+		|| (opts.chunk_size > BLHOST_CHUNK_MAX) ) {
+		__usage( argv[0] );
+		return 2;
+	}
+
+	command = argv[optind];
+
+	if ( ! baud ) {
+		baud = board->baud;
+	}
+	if ( ! opts.page_size ) {
+		opts.page_size = board->page_size;
+	}
+	opts.activate = activate;
+	opts.progress = __progress;
+
+	host = blhost_open( device, baud );
+	if ( ! host ) {
+		fprintf( stderr, "Can't open %s at %u baud: %s\n", device, baud, strerror( errno ) );
+		return 1;
+	}
+
+	blhost_set_timeout( host, timeout_ms, retries );
+
+	if ( ! strcmp( command, "ping" ) ) {
+		ret = blhost_ping( host );
+		printf( "%s\n", (ret == 0) ? "OK" : "No response" );
+	} else if ( ! strcmp( command, "write" ) && ((optind + 1) < argc) ) {
+		ret = __write( host, app - 1, argv[optind + 1], &opts, do_boot );
+	} else if ( ! strcmp( command, "boot" ) ) {
+		ret = __boot( host, app - 1 );
+	} else {
+		__usage( argv[0] );
+		ret = (-1);
+	}
+
+	blhost_close( host );
+
+	return (ret == 0) ? 0 : 1;
+}
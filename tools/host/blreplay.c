@@ -0,0 +1,385 @@
+// Frame trace replay
+//
+// Feeds a frame trace (src/include/frame_trace.h; a device's ring dumped with
+// the debugger or blcli.py --frame-trace) into a native build of the server
+// and the bootloader service, and reports where the responses differ from the
+// recorded ones and how long each method took there and here. See
+// replay/replay.h for how the trace is replayed.
+//
+//   $ blreplay stall.mtrc
+//   $ blreplay -f flash.bin -p device.mtrc
+
+#include "replay.h"
+
+#include "config.h"
+#include "moon/server.h"
+#include "moon/services/bootloader.h"
+#include "flash.h"
+#include "boot_record.h"
+#include "verify.h"
+#include "copy.h"
+#include "system.h"
+#include "trace.h"
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_LOOP_RATE	10000
+#define DEFAULT_MAX_REPORT	10
+
+static const char * const methods_g[REPLAY_N_METHODS] = {
+	[kBootloader_bl_ping_id] = "bl_ping",
+	[kBootloader_bl_writePageBuffer_id] = "bl_writePageBuffer",
+	[kBootloader_bl_erasePageBuffer_id] = "bl_erasePageBuffer",
+	[kBootloader_bl_eraseApp_id] = "bl_eraseApp",
+	[kBootloader_bl_writePage_id] = "bl_writePage",
+	[kBootloader_bl_setBootAction_id] = "bl_setBootAction",
+	[kBootloader_bl_boot_id] = "bl_boot",
+	[kBootloader_bl_getStats_id] = "bl_getStats",
+	[kBootloader_bl_getTrace_id] = "bl_getTrace",
+	[kBootloader_bl_resetTrace_id] = "bl_resetTrace",
+	[kBootloader_bl_setActiveApp_id] = "bl_setActiveApp",
+	[kBootloader_bl_getBootRecord_id] = "bl_getBootRecord",
+	[kBootloader_bl_confirmBoot_id] = "bl_confirmBoot",
+	[kBootloader_bl_checkImage_id] = "bl_checkImage",
+	[kBootloader_bl_verifyApp_id] = "bl_verifyApp",
+	[kBootloader_bl_readApp_id] = "bl_readApp",
+	[kBootloader_bl_copyApp_id] = "bl_copyApp",
+	[kBootloader_bl_getCopyStatus_id] = "bl_getCopyStatus",
+	[kBootloader_bl_beginUpload_id] = "bl_beginUpload",
+	[kBootloader_bl_getUploadSession_id] = "bl_getUploadSession",
+	[kBootloader_bl_writeAddress_id] = "bl_writeAddress",
+	[kBootloader_bl_flushWrites_id] = "bl_flushWrites",
+	[kBootloader_bl_getInfo_id] = "bl_getInfo",
+};
+
+// The device reports on itself in these; they're not expected to match
+static const uint64_t ignore_default_g = (1ULL << kBootloader_bl_getStats_id)
+	| (1ULL << kBootloader_bl_getTrace_id) | (1ULL << kBootloader_bl_getInfo_id);
+
+static const char * const kinds_g[] = { "rx", "rx-crc", "rx-error", "tx" };
+
+static const char * const stages_g[TRACE_N_STAGES] = { "decode", "dispatch", "encode", "transmit" };
+
+const char * replay_method_name( uint8_t method )
+{
+	if ( (method < REPLAY_N_METHODS) && methods_g[method] ) {
+		return methods_g[method];
+	}
+
+	return "?";
+}
+
+static int __method_id( const char * arg )
+{
+	char * end;
+	unsigned long id;
+	int i;
+
+	for ( i = 0; i < REPLAY_N_METHODS; i++ ) {
+		if ( methods_g[i] && (! strcmp( arg, methods_g[i] ) || ! strcmp( arg, methods_g[i] + 3 )) ) {
+			return i;
+		}
+	}
+
+	id = strtoul( arg, &end, 0 );
+	if ( (*end != '\0') || (id >= REPLAY_N_METHODS) ) {
+		return (-1);
+	}
+
+	return (int)id;
+}
+
+static void __usage( const char * prog )
+{
+	fprintf( stderr,
+		"usage: %s [options] TRACE\n"
+		"\n"
+		"Replays a frame trace against the server and bootloader service built\n"
+		"for the host (%u byte pages) and reports differences and timing.\n"
+		"\n"
+		"options:\n"
+		"  -f FLASH         flash image to start from (from the flash base address);\n"
+		"                   erased otherwise\n"
+		"  -i METHOD        don't compare the responses of METHOD (name or id); repeatable\n"
+		"  -c               compare bl_getStats, bl_getTrace and bl_getInfo responses too\n"
+		"  -l RATE          device main loop iterations per second between requests\n"
+		"                   (default %u)\n"
+		"  -n COUNT         differences to print in full (default %u)\n"
+		"  -p               print the server's stage / method latency histograms\n"
+		"  -d               print the trace and exit\n"
+		"  -v               print every frame and the bootloader's console\n",
+		prog, CONFIG_PAGE_SIZE, DEFAULT_LOOP_RATE, DEFAULT_MAX_REPORT );
+}
+
+// Read a trace; a ring is unrolled, oldest record first
+static int __load( const char * path, replay_trace_t * trace )
+{
+	frame_trace_record_t * records;
+	FILE * f;
+	long size;
+	uint32_t count;
+	uint32_t first;
+	uint32_t i;
+
+	f = fopen( path, "rb" );
+	if ( ! f ) {
+		return (-1);
+	}
+
+	if ( (fread( &trace->header, sizeof(trace->header), 1, f ) != 1)
+		|| (trace->header.magic != FRAME_TRACE_MAGIC)
+		|| (trace->header.version != FRAME_TRACE_VERSION)
+		|| (trace->header.record_size != sizeof(frame_trace_record_t))
+		|| (trace->header.timebase_hz == 0) ) {
+		fclose( f );
+		errno = EINVAL;
+		return (-1);
+	}
+
+	if ( (fseek( f, 0, SEEK_END ) < 0) || ((size = ftell( f )) < 0) ) {
+		fclose( f );
+		return (-1);
+	}
+
+	count = (size - sizeof(frame_trace_header_t)) / sizeof(frame_trace_record_t);
+	first = 0;
+	trace->lost = 0;
+
+	if ( trace->header.n_records ) {
+		if ( count > trace->header.n_records ) {
+			count = trace->header.n_records;
+		}
+		if ( count > trace->header.head ) {
+			count = trace->header.head;
+		}
+		trace->lost = trace->header.head - count;
+		first = trace->header.head - count;
+	}
+
+	records = calloc( count ? count : 1, sizeof(frame_trace_record_t) );
+	if ( ! records ) {
+		fclose( f );
+		return (-1);
+	}
+
+	for ( i = 0; i < count; i++ ) {
+		uint32_t slot = trace->header.n_records ? ((first + i) % trace->header.n_records) : i;
+
+		if ( (fseek( f, sizeof(frame_trace_header_t) + (slot * sizeof(frame_trace_record_t)), SEEK_SET ) < 0)
+			|| (fread( &records[i], sizeof(frame_trace_record_t), 1, f ) != 1) ) {
+			free( records );
+			fclose( f );
+			errno = EINVAL;
+			return (-1);
+		}
+
+		if ( records[i].len > FRAME_TRACE_DATA_LEN ) {
+			records[i].len = FRAME_TRACE_DATA_LEN;
+		}
+	}
+
+	fclose( f );
+
+	trace->records = records;
+	trace->n_records = count;
+
+	return 0;
+}
+
+static double __us( uint64_t ticks, uint32_t hz )
+{
+	return ticks * 1e6 / hz;
+}
+
+static void __print_trace( const replay_trace_t * trace )
+{
+	const frame_trace_record_t * r;
+	uint32_t i;
+	uint32_t j;
+
+	for ( i = 0; i < trace->n_records; i++ ) {
+		r = &trace->records[i];
+		printf( "[%5u] %12.1f us  %-8s %3u ", i,
+			__us( (uint32_t)(r->time - trace->records[0].time), trace->header.timebase_hz ),
+			(r->kind < (sizeof(kinds_g) / sizeof(kinds_g[0]))) ? kinds_g[r->kind] : "?", r->len );
+		if ( (r->len >= 3) && (r->kind != FRAME_TRACE_RX_CRC) ) {
+			printf( " %-20s", replay_method_name( (r->data[0] >> 7) | ((r->data[1] & 0x1F) << 1) ) );
+		}
+		for ( j = 0; j < r->len; j++ ) {
+			printf( " %02X", r->data[j] );
+		}
+		printf( "\n" );
+	}
+}
+
+static void __print_timing( const replay_trace_t * trace, const replay_result_t * result )
+{
+	const replay_timing_t * t;
+	uint32_t hz = trace->header.timebase_hz;
+	int i;
+
+	printf( "\n%-20s  %6s  %25s  %25s\n", "method", "count",
+		(trace->header.origin == FRAME_TRACE_ORIGIN_HOST) ? "round trip mean/max (us)" : "device mean/max (us)",
+		"replayed mean/max (us)" );
+
+	for ( i = 0; i < REPLAY_N_METHODS; i++ ) {
+		t = &result->timing[i];
+		if ( ! t->count ) {
+			continue;
+		}
+
+		printf( "%-20s  %6u  %12.1f / %10.1f  %12.1f / %10.1f\n", replay_method_name( i ), t->count,
+			__us( t->recorded / t->count, hz ), __us( t->recorded_max, hz ),
+			__us( t->replayed / t->count, TRACE_TIMEBASE_HZ ), __us( t->replayed_max, TRACE_TIMEBASE_HZ ) );
+	}
+}
+
+static void __print_histograms()
+{
+	trace_entry_t entry;
+	uint32_t i;
+
+	printf( "\n%-20s  %6s  %10s  %10s  %10s  (us, replayed)\n", "stage / method", "count", "min", "mean", "max" );
+
+	for ( i = 0; trace_get( i, &entry ) == 0; i++ ) {
+		if ( ! entry.hist.count ) {
+			continue;
+		}
+
+		printf( "%-20s  %6u  %10.1f  %10.1f  %10.1f\n",
+			(entry.kind == TRACE_KIND_STAGE) ? stages_g[entry.id] : replay_method_name( entry.method ),
+			entry.hist.count, __us( entry.hist.min, TRACE_TIMEBASE_HZ ),
+			__us( entry.hist.sum / entry.hist.count, TRACE_TIMEBASE_HZ ), __us( entry.hist.max, TRACE_TIMEBASE_HZ ) );
+	}
+}
+
+int main( int argc, char * argv[] )
+{
+	replay_opts_t opts = { 0 };
+	replay_result_t result = { 0 };
+	replay_trace_t trace = { 0 };
+	const char * flash = NULL;
+	uint64_t ignore = 0;
+	bool compare_all = false;
+	bool histograms = false;
+	bool dump = false;
+	int method;
+	int c;
+
+	opts.loop_rate = DEFAULT_LOOP_RATE;
+	opts.max_report = DEFAULT_MAX_REPORT;
+
+	while ( (c = getopt( argc, argv, "f:i:cl:n:pdvh" )) != -1 ) {
+		switch ( c ) {
+			case 'f':
+				flash = optarg;
+				break;
+			case 'i':
+				method = __method_id( optarg );
+				if ( method < 0 ) {
+					fprintf( stderr, "Unknown method '%s'\n", optarg );
+					return 2;
+				}
+				ignore |= (1ULL << method);
+				break;
+			case 'c':
+				compare_all = true;
+				break;
+			case 'l':
+				opts.loop_rate = strtoul( optarg, NULL, 0 );
+				break;
+			case 'n':
+				opts.max_report = strtoul( optarg, NULL, 0 );
+				break;
+			case 'p':
+				histograms = true;
+				break;
+			case 'd':
+				dump = true;
+				break;
+			case 'v':
+				opts.verbose = true;
+				break;
+			default:
+				__usage( argv[0] );
+				return 2;
+		}
+	}
+
+	if ( optind != (argc - 1) ) {
+		__usage( argv[0] );
+		return 2;
+	}
+
+	opts.ignore = ignore | (compare_all ? 0 : ignore_default_g);
+
+	if ( __load( argv[optind], &trace ) < 0 ) {
+		fprintf( stderr, "Can't read the frame trace %s: %s\n", argv[optind], strerror( errno ) );
+		return 2;
+	}
+
+	printf( "%s: %s trace, %u records", argv[optind],
+		(trace.header.origin == FRAME_TRACE_ORIGIN_HOST) ? "host" : "device", trace.n_records );
+	if ( trace.lost ) {
+		printf( " (%u older ones overwritten)", trace.lost );
+	}
+	printf( ", %u Hz time base\n", trace.header.timebase_hz );
+
+	if ( dump ) {
+		__print_trace( &trace );
+		return 0;
+	}
+
+	if ( trace.header.page_size && (trace.header.page_size != CONFIG_PAGE_SIZE) ) {
+		fprintf( stderr, "The trace is from a device with %u byte pages; this build has %u "
+			"(configure with -Dreplay_board=%s)\n", trace.header.page_size, CONFIG_PAGE_SIZE,
+			(trace.header.page_size == 256) ? "rh71" : "v71" );
+		return 2;
+	}
+
+	if ( flash_init() < 0 ) {
+		return 2;
+	}
+
+	if ( flash && (replay_flash_load( flash ) < 0) ) {
+		fprintf( stderr, "Can't read the flash image %s: %s\n", flash, strerror( errno ) );
+		return 2;
+	}
+
+	replay_system_console( opts.verbose );
+	boot_record_init();
+	moon_server_init();
+
+	replay_transport_start( &trace, &opts, &result );
+
+	// The device's main loop (src/main.c)
+	while ( ! replay_transport_done() ) {
+		moon_server_poll();
+		verify_poll();
+		copy_poll();
+		sys_boot_poll();
+	}
+
+	printf( "%u requests, %u link errors, %u responses: %u the same, %u different, %u missing, "
+		"%u not compared, %u not recorded",
+		result.requests, result.link_errors, result.responses, result.matched,
+		result.diverged, result.missing, result.ignored, result.unseen );
+	if ( result.orphans ) {
+		printf( ", %u recorded without their request", result.orphans );
+	}
+	printf( "\n" );
+
+	__print_timing( &trace, &result );
+
+	if ( histograms ) {
+		__print_histograms();
+	}
+
+	free( trace.records );
+
+	return (result.diverged || result.missing) ? 1 : 0;
+}
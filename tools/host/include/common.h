@@ -0,0 +1,23 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef COMMON_H
+#define COMMON_H
+
+#include <stdint.h>
+
+// Host stand-in for src/include/common.h: the placement attributes are
+// dropped and there's no memory-mapped I/O (nothing built for the host
+// touches a register)
+
+#define __ramfunc
+#define __itcm
+#define __dtcm
+
+#endif // COMMON_H
+
+#ifdef __cplusplus
+}
+#endif
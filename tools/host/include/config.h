@@ -0,0 +1,14 @@
+
+// Host build configuration
+//
+// Stand-in for the Kconfig generated config.h when the firmware's link layer
+// and codec (sll.c, crc.c, moon/codec.c) are built for the host. Only the
+// options those files look at are here; CONFIG_STATS is deliberately unset
+// (the counters are the device's).
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define CONFIG_CRC_SLICE_BY_4 1
+
+#endif // CONFIG_H
@@ -0,0 +1,48 @@
+// Replay build configuration (blreplay)
+//
+// Stand-in for the Kconfig generated config.h when the server and the
+// bootloader service are built for the host to replay frame traces: the
+// options a board builds with by default. The SoC follows the 'replay_board'
+// meson option (REPLAY_BOARD_RH71); the flash is a RAM array mapped at the
+// board's flash address (see flash.c), so partition addresses mean the same
+// as on the device.
+//
+// Not built: handoff to the application, the API table, fast boot (none of
+// them is reachable from a request).
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#if defined(REPLAY_BOARD_RH71)
+	#define CONFIG_SOC_SERIES_SAMRH71 1
+	#define CONFIG_PAGE_SIZE 256
+	#define CONFIG_FLASH_BASE_ADDRESS 0x10000000
+	#define CONFIG_SRAM_BASE_ADDRESS 0x21000000
+	#define CONFIG_SRAM_SIZE 768
+	#define CONFIG_SYS_CLOCK_HZ 4000000
+	#define CONFIG_USART_BAUD 19200
+#else
+	#define CONFIG_SOC_SERIES_SAMV71 1
+	#define CONFIG_PAGE_SIZE 512
+	#define CONFIG_FLASH_BASE_ADDRESS 0x00400000
+	#define CONFIG_SRAM_BASE_ADDRESS 0x20400000
+	#define CONFIG_SRAM_SIZE 384
+	#define CONFIG_SYS_CLOCK_HZ 12000000
+	#define CONFIG_USART_BAUD 38400
+#endif // defined(REPLAY_BOARD_RH71)
+
+#define CONFIG_FLASH_SIZE 128
+#define CONFIG_BOOTLOADER_SIZE 16
+
+#define CONFIG_MOON_TRANSPORT_USART 1
+#define CONFIG_BOOT_RECORD 1
+#define CONFIG_UPLOAD_CHECKPOINT_PAGES 8
+#define CONFIG_PAGE_CACHE_ENTRIES 4
+#define CONFIG_VERIFY_CHUNK_SIZE 256
+#define CONFIG_CRC_SLICE_BY_4 1
+
+#define CONFIG_STATS 1
+#define CONFIG_TRACE 1
+#define CONFIG_TRACE_MAX_METHODS 16
+
+#endif // CONFIG_H
@@ -0,0 +1,27 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef DWT_H
+#define DWT_H
+
+#include "trace.h"
+
+#include <stdint.h>
+
+// Host stand-in for src/arch/arm/include/dwt.h: the "cycle counter" is the
+// native trace.h time base (CLOCK_MONOTONIC in ns)
+
+static inline void dwt_init( void ) {}
+
+static inline uint32_t dwt_get_cycles( void )
+{
+	return trace_now();
+}
+
+#endif // DWT_H
+
+#ifdef __cplusplus
+}
+#endif
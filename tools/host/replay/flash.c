@@ -0,0 +1,297 @@
+// Flash driver for the replay build (see replay.h)
+//
+// The flash array is anonymous memory mapped at CONFIG_FLASH_BASE_ADDRESS, so
+// the services read it through partition addresses as they do on the device
+// (the partition table is src/drivers/flash.c's). Programming goes through a
+// page latch and can only clear bits; the user signature is a page of its own.
+
+#include "replay.h"
+
+#include "flash.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#define FLASH_BYTES				(CONFIG_FLASH_SIZE * 1024)
+#define FLASH_PAGES				(FLASH_BYTES / CONFIG_PAGE_SIZE)
+#define PAGE_WORDS				(CONFIG_PAGE_SIZE / sizeof(uint32_t))
+
+#define PARTITION_ID_APP1		0
+#define PARTITION_ID_APP2		1
+
+#define PARTITION_APP_SIZE		0xE000
+#define PARTITION_APP1_START	(CONFIG_FLASH_BASE_ADDRESS + (CONFIG_BOOTLOADER_SIZE * 1024))
+#define PARTITION_APP2_START	(PARTITION_APP1_START + PARTITION_APP_SIZE)
+
+static uint8_t * flash_g;
+static uint32_t latch_g[PAGE_WORDS];
+static uint32_t latch_owner_g;
+static uint32_t user_signature_g[PAGE_WORDS];
+
+static void __latch_reset()
+{
+	memset( latch_g, 0xFF, sizeof(latch_g) );
+}
+
+// NOTE: MAP_FIXED_NOREPLACE fails rather than replace a mapping that's already
+// there (the executable is built as a PIE so its image is well clear of the
+// low addresses the boards use)
+int flash_init()
+{
+	void * p;
+
+	if ( flash_g ) {
+		return 0;
+	}
+
+	p = mmap( (void *)(uintptr_t)CONFIG_FLASH_BASE_ADDRESS, FLASH_BYTES, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0 );
+	if ( (p == MAP_FAILED) || (p != (void *)(uintptr_t)CONFIG_FLASH_BASE_ADDRESS) ) {
+		fprintf( stderr, "Can't map the flash array at 0x%08X: %s\n", CONFIG_FLASH_BASE_ADDRESS,
+			(p == MAP_FAILED) ? strerror( errno ) : "address taken" );
+		return (-1);
+	}
+
+	flash_g = p;
+	memset( flash_g, 0xFF, FLASH_BYTES );
+	memset( user_signature_g, 0xFF, sizeof(user_signature_g) );
+	__latch_reset();
+
+	return 0;
+}
+
+int replay_flash_load( const char * path )
+{
+	FILE * f;
+	size_t n;
+
+	f = fopen( path, "rb" );
+	if ( ! f ) {
+		return (-1);
+	}
+
+	n = fread( flash_g, 1, FLASH_BYTES, f );
+	fclose( f );
+
+	return (int)n;
+}
+
+int flash_get_partition( uint32_t id, flash_partition_t * partition )
+{
+	switch ( id ) {
+		case PARTITION_ID_APP1:
+			partition->start = PARTITION_APP1_START;
+			break;
+		case PARTITION_ID_APP2:
+			partition->start = PARTITION_APP2_START;
+			break;
+		default:
+			return (-1); // Partition doesn't exist
+	}
+
+	partition->end = partition->start + PARTITION_APP_SIZE;
+
+	return 0;
+}
+
+int flash_erase_block( uint32_t page, uint32_t n_pages )
+{
+	if ( (n_pages == 0) || (n_pages % FLASH_ERASE_MIN_PAGES) || (page % n_pages) || ((page + n_pages) > FLASH_PAGES) ) {
+		return (-1);
+	}
+
+	memset( &flash_g[page * CONFIG_PAGE_SIZE], 0xFF, n_pages * CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_erase_pages( uint32_t id, uint16_t page, uint16_t n_pages )
+{
+	flash_partition_t partition;
+
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (page % FLASH_ERASE_MIN_PAGES) || (n_pages % FLASH_ERASE_MIN_PAGES) ) {
+		return (-2);
+	}
+
+	if ( ((uint32_t)page + n_pages) > ((partition.end - partition.start) / CONFIG_PAGE_SIZE) ) {
+		return (-2);
+	}
+
+	// One erase; the device splits it into aligned blocks, to the same effect
+	memset( (uint8_t *)(uintptr_t)(partition.start + (page * CONFIG_PAGE_SIZE)), 0xFF, n_pages * CONFIG_PAGE_SIZE );
+
+	return 0;
+}
+
+int flash_erase_partition( uint32_t id )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	return flash_erase_pages( id, 0, ((partition.end - partition.start) / CONFIG_PAGE_SIZE) );
+}
+
+uint32_t flash_latch_claim()
+{
+	if ( ++latch_owner_g == 0 ) {
+		latch_owner_g = 1;
+	}
+
+	return latch_owner_g;
+}
+
+uint32_t flash_latch_owner()
+{
+	return latch_owner_g;
+}
+
+int flash_latch_write( uint32_t offset, uint32_t word )
+{
+	if ( (offset & 0x3) || (offset >= CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	latch_g[offset / 4] = word;
+
+	return 0;
+}
+
+int flash_commit_latch( uint32_t id, uint16_t page )
+{
+	flash_partition_t partition;
+	uint32_t * dest;
+	uint32_t i;
+
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (partition.start + (page * CONFIG_PAGE_SIZE)) >= partition.end ) {
+		return (-2); // Invalid page number
+	}
+
+	// Programming only clears bits; the latch reads back as erased afterwards
+	dest = (uint32_t *)(uintptr_t)(partition.start + (page * CONFIG_PAGE_SIZE));
+	for ( i = 0; i < PAGE_WORDS; i++ ) {
+		dest[i] &= latch_g[i];
+	}
+
+	__latch_reset();
+
+	return 0;
+}
+
+int flash_write_page( uint32_t id, uint8_t * page_buffer, uint16_t page )
+{
+	flash_partition_t partition;
+	uint32_t i;
+
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	if ( (partition.start + (page * CONFIG_PAGE_SIZE)) >= partition.end ) {
+		return (-2); // Invalid page number
+	}
+
+	flash_latch_claim();
+
+	for ( i = 0; i < PAGE_WORDS; i++ ) {
+		memcpy( &latch_g[i], &page_buffer[i * 4], sizeof(uint32_t) );
+	}
+
+	return flash_commit_latch( id, page );
+}
+
+static inline int __user_signature_args( uint32_t offset, uint32_t len )
+{
+	if ( (offset & 0x3) || (len & 0x3) || ((offset + len) > CONFIG_PAGE_SIZE) ) {
+		return (-1);
+	}
+
+	return 0;
+}
+
+int flash_read_user_signature( uint32_t offset, uint32_t * data, uint32_t len )
+{
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	memcpy( data, &user_signature_g[offset / 4], len );
+
+	return 0;
+}
+
+int flash_write_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_user_signature( offset, data, len );
+}
+
+int flash_program_user_signature( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	uint32_t i;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	for ( i = 0; i < (len / 4); i++ ) {
+		user_signature_g[(offset / 4) + i] &= data[i];
+	}
+
+	__latch_reset();
+
+	return 0;
+}
+
+int flash_erase_user_signature()
+{
+	memset( user_signature_g, 0xFF, sizeof(user_signature_g) );
+
+	return 0;
+}
+
+#if defined(CONFIG_BOOT_RECORD)
+int flash_write_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	flash_latch_claim();
+
+	return flash_program_record( offset, data, len );
+}
+
+int flash_program_record( uint32_t offset, const uint32_t * data, uint32_t len )
+{
+	uint32_t * record = (uint32_t *)(uintptr_t)(FLASH_RECORD_ADDRESS + offset);
+	uint32_t i;
+
+	if ( (! data) || (__user_signature_args( offset, len ) < 0) ) {
+		return (-1);
+	}
+
+	for ( i = 0; i < (len / 4); i++ ) {
+		record[i] &= data[i];
+	}
+
+	__latch_reset();
+
+	return 0;
+}
+
+int flash_erase_record()
+{
+	memset( (void *)(uintptr_t)FLASH_RECORD_ADDRESS, 0xFF, FLASH_RECORD_BLOCK_SIZE );
+
+	return 0;
+}
+#endif
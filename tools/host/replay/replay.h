@@ -0,0 +1,96 @@
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include "frame_trace.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Frame trace replay (blreplay)
+//
+// The server (moon/server.c), the generated service shims and the bootloader
+// service with the modules behind it are the firmware's sources built for the
+// host. The files here replace the rest:
+//
+// - transport.c feeds the requests of a trace to the server and checks each
+//   response against the one recorded
+// - flash.c is the flash array in RAM, mapped at CONFIG_FLASH_BASE_ADDRESS
+// - system.c keeps the boot action; the jump is only reported
+//
+// A device trace is replayed as the device saw it: its RX records are the
+// requests (its CRC failures and character errors become transport errors)
+// and its TX records the responses and stream frames to compare. In a host
+// trace it's the other way round; frames the host sent that never made it to
+// the device are replayed as well, and responses the host didn't see aren't
+// missed.
+//
+// Nothing waits: the device's main loop is run (idle polls, verify_poll(),
+// ...) for the recorded gap before each request at 'loop_rate' iterations a
+// second, so background work gets as far as it did on the device.
+
+typedef struct {
+	frame_trace_header_t header;
+	frame_trace_record_t * records;	// Oldest first
+	uint32_t n_records;
+	uint32_t lost;					// Overwritten in the ring before the dump
+} replay_trace_t;
+
+typedef struct {
+	uint32_t count;
+	uint64_t recorded;		// Sum, in trace ticks
+	uint32_t recorded_max;
+	uint64_t replayed;		// Sum, in TRACE_TIMEBASE_HZ ticks
+	uint32_t replayed_max;
+} replay_timing_t;
+
+#define REPLAY_N_METHODS	64 // 6-bit method id
+
+typedef struct {
+	uint32_t requests;		// Delivered to the server
+	uint32_t link_errors;	// Recorded CRC failures / character errors (device traces)
+	uint32_t responses;		// Written by the server
+	uint32_t matched;		// Same as recorded
+	uint32_t diverged;		// Not the same as recorded
+	uint32_t ignored;		// Not compared (ignored method, or recorded with a bad CRC)
+	uint32_t missing;		// Recorded but not written by the server
+	uint32_t unseen;		// Written by the server; the host never saw it (host traces)
+	uint32_t orphans;		// Responses whose request isn't in the trace (ring wrapped)
+
+	// Request to response, per method: on the device (device traces) or the
+	// host's round trip (host traces), and through the server here
+	replay_timing_t timing[REPLAY_N_METHODS];
+} replay_result_t;
+
+typedef struct {
+	uint64_t ignore;		// Bit per method id whose responses aren't compared
+	uint32_t loop_rate;		// Device main loop iterations per second
+	uint32_t max_report;	// Divergences printed in full
+	bool verbose;			// Print every frame
+} replay_opts_t;
+
+// Name of a bootloader method (blreplay.c); "?" if unknown
+const char * replay_method_name( uint8_t method );
+
+// -- transport.c -- //
+void replay_transport_start( const replay_trace_t * trace, const replay_opts_t * opts, replay_result_t * result );
+bool replay_transport_done();
+
+// -- flash.c -- //
+
+// Copy a flash image (from address CONFIG_FLASH_BASE_ADDRESS) into the array
+// before the replay; returns the bytes read or (-1)
+int replay_flash_load( const char * path );
+
+// -- system.c -- //
+void replay_system_console( bool on );
+
+#endif // REPLAY_H
+
+#ifdef __cplusplus
+}
+#endif
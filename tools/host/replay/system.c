@@ -0,0 +1,122 @@
+// system.h for the replay build (see replay.h)
+//
+// The boot action and the checks on it are system.c's; the jump is reported
+// instead (the trace goes on with whatever the device did next, usually
+// nothing). The console (printf) goes to stdout with -v.
+
+#include "replay.h"
+
+#include "system.h"
+#include "config.h"
+#include "flash.h"
+#include "boot_record.h"
+#include "clock.h"
+
+#include <stdio.h>
+
+#define BOOT_INVALID_ENTRY 0xFFFFFFFF
+
+static bool boot_enable_g = false;
+static uint32_t boot_entry_g = BOOT_INVALID_ENTRY;
+static uint32_t boot_id_g;
+static bool console_g = false;
+
+void replay_system_console( bool on )
+{
+	console_g = on;
+}
+
+void _putchar( char character )
+{
+	// The firmware ends its lines with "\n\r"
+	if ( console_g && (character != '\r') ) {
+		putchar( character );
+	}
+}
+
+int sys_set_boot_action( uint32_t id )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	boot_entry_g = partition.start;
+	boot_id_g = id;
+
+	return 0;
+}
+
+int sys_set_boot_enable()
+{
+	boot_record_session_t session;
+
+	if ( boot_entry_g == BOOT_INVALID_ENTRY ) {
+		return (-1);
+	}
+
+	if ( sys_check_app( boot_id_g ) < 0 ) {
+		return (-2); // Nothing bootable there
+	}
+
+	if ( boot_record_check( boot_id_g ) == (-2) ) {
+		return (-3);
+	}
+
+	if ( (boot_record_session_get( &session ) == 0) && (session.slot == boot_id_g) ) {
+		return (-3);
+	}
+
+	boot_enable_g = true;
+
+	return 0;
+}
+
+bool sys_get_boot_enable()
+{
+	return boot_enable_g;
+}
+
+void sys_boot_poll()
+{
+	if ( ! sys_get_boot_enable() ) {
+		return;
+	}
+
+	printf( "  -- the device boots APP_%u ($%08X) here\n", boot_id_g + 1, boot_entry_g );
+	boot_enable_g = false;
+}
+
+int sys_check_app( uint32_t id )
+{
+	flash_partition_t partition;
+	if ( flash_get_partition( id, &partition ) < 0 ) {
+		return (-1); // Partition not found
+	}
+
+	const uint32_t * vectors = (const uint32_t *)(uintptr_t)(partition.start);
+	uint32_t sp = vectors[0];
+	uint32_t reset = vectors[1];
+
+	if ( (sp & 0x3) ||
+		(sp <= CONFIG_SRAM_BASE_ADDRESS) ||
+		(sp > (CONFIG_SRAM_BASE_ADDRESS + (CONFIG_SRAM_SIZE * 1024))) ) {
+		return (-2);
+	}
+
+	if ( ! (reset & 0x1) ||
+		((reset & ~0x1) < (partition.start + 8)) ||
+		((reset & ~0x1) >= partition.end) ) {
+		return (-2);
+	}
+
+	return 0;
+}
+
+void sys_fast_boot() {}
+
+// Handoff / trace timebase; the replay never leaves the reset clock
+uint32_t clock_get_core_hz()
+{
+	return CONFIG_SYS_CLOCK_HZ;
+}
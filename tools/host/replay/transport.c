@@ -0,0 +1,361 @@
+// Transport for the replay build (see replay.h)
+//
+// moon_transport_read() hands the server the recorded requests in order and
+// moon_transport_write() matches what it sends against the recorded
+// responses. The two are separate cursors into the trace: a host may have
+// sent the next request before the previous response came in, and either end
+// may have lost frames the other one recorded.
+//
+// A response is matched on its header (service, method, sequence and type)
+// before its bytes are compared. One that was recorded before the next
+// request but that the server doesn't write (given a poll to do it in, as a
+// stream frame would be) is missing.
+
+#include "replay.h"
+
+#include "moon/server.h"
+#include "moon/transport.h"
+#include "moon/codec.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <string.h>
+
+// Idle polls before a request are capped; whatever the device was doing in
+// the background is long done by then (and a trace can have hours-long gaps)
+#define IDLE_POLLS_MAX	1000000
+
+#define REPORT_BYTES	16
+
+static struct {
+	const replay_trace_t * trace;
+	const replay_opts_t * opts;
+	replay_result_t * result;
+
+	uint32_t next_request;		// Next request-side record
+	uint32_t next_response;		// Next response-side record
+	uint32_t idle;				// Idle polls left before next_request
+	bool owed;					// next_response was due at the last read
+
+	int64_t delivered;			// Record of the request being served (-1: none)
+	uint32_t delivered_at;		// trace_now() it was handed over
+	moon_msg_hdr_t delivered_header;
+
+	uint8_t buffer[FRAME_TRACE_DATA_LEN];
+	uint32_t read_len;
+} replay_g;
+
+static inline bool __is_request( const frame_trace_record_t * record )
+{
+	if ( replay_g.trace->header.origin == FRAME_TRACE_ORIGIN_HOST ) {
+		return (record->kind == FRAME_TRACE_TX);
+	}
+
+	return (record->kind == FRAME_TRACE_RX) || (record->kind == FRAME_TRACE_RX_CRC) || (record->kind == FRAME_TRACE_RX_ERROR);
+}
+
+static inline bool __is_response( const frame_trace_record_t * record )
+{
+	if ( replay_g.trace->header.origin == FRAME_TRACE_ORIGIN_HOST ) {
+		return (record->kind == FRAME_TRACE_RX) || (record->kind == FRAME_TRACE_RX_CRC);
+	}
+
+	return (record->kind == FRAME_TRACE_TX);
+}
+
+static uint32_t __next( uint32_t index, bool (*side)( const frame_trace_record_t * ) )
+{
+	while ( (index < replay_g.trace->n_records) && ! side( &replay_g.trace->records[index] ) ) {
+		index++;
+	}
+
+	return index;
+}
+
+static double __ms( uint32_t index )
+{
+	const replay_trace_t * trace = replay_g.trace;
+
+	return (uint32_t)(trace->records[index].time - trace->records[0].time) * 1000.0 / trace->header.timebase_hz;
+}
+
+static void __print_frame( uint32_t index, const char * dir, const uint8_t * data, uint32_t len, const char * note )
+{
+	moon_msg_hdr_t header;
+
+	if ( (len < 3) || (moon_codec_read_header( (uint8_t *)data, &header ) < 0) ) {
+		printf( "  [%5u] %10.3f ms  %-3s  (%u bytes)  %s\n", index, __ms( index ), dir, len, note );
+		return;
+	}
+
+	printf( "  [%5u] %10.3f ms  %-3s  %s seq %u%s  (%u bytes)  %s\n", index, __ms( index ), dir,
+		replay_method_name( header.method ), header.sequence,
+		(header.type == MSG_TYPE_MULTI_STREAM) ? " stream" : "", len, note );
+}
+
+static void __print_bytes( const char * what, const uint8_t * data, uint32_t len, uint32_t from )
+{
+	uint32_t i;
+
+	printf( "          %-9s", what );
+	for ( i = from; (i < len) && (i < (from + REPORT_BYTES)); i++ ) {
+		printf( " %02X", data[i] );
+	}
+	printf( "%s\n", (len > (from + REPORT_BYTES)) ? " ..." : "" );
+}
+
+static void __report( uint32_t index, const uint8_t * written, uint32_t len, const char * why )
+{
+	const frame_trace_record_t * expected = &replay_g.trace->records[index];
+	uint32_t from = 0;
+
+	replay_g.result->diverged++;
+
+	if ( replay_g.result->diverged > replay_g.opts->max_report ) {
+		return;
+	}
+
+	while ( (from < len) && (from < expected->len) && (written[from] == expected->data[from]) ) {
+		from++;
+	}
+
+	__print_frame( index, "!=", expected->data, expected->len, why );
+	__print_bytes( "recorded", expected->data, expected->len, from );
+	__print_bytes( "replayed", written, len, from );
+}
+
+static void __set_idle()
+{
+	const replay_trace_t * trace = replay_g.trace;
+	uint32_t i = replay_g.next_request;
+	uint64_t polls;
+
+	replay_g.idle = 0;
+
+	if ( (i == 0) || (i >= trace->n_records) ) {
+		return;
+	}
+
+	polls = (uint64_t)(uint32_t)(trace->records[i].time - trace->records[i - 1].time)
+		* replay_g.opts->loop_rate / trace->header.timebase_hz;
+	replay_g.idle = (polls > IDLE_POLLS_MAX) ? IDLE_POLLS_MAX : (uint32_t)polls;
+}
+
+void replay_transport_start( const replay_trace_t * trace, const replay_opts_t * opts, replay_result_t * result )
+{
+	memset( &replay_g, 0, sizeof(replay_g) );
+
+	replay_g.trace = trace;
+	replay_g.opts = opts;
+	replay_g.result = result;
+	replay_g.delivered = (-1);
+
+	replay_g.next_request = __next( 0, __is_request );
+	replay_g.next_response = __next( 0, __is_response );
+
+	// The start of a ring that has wrapped: responses to requests that were
+	// overwritten
+	while ( replay_g.next_response < replay_g.next_request ) {
+		result->orphans++;
+		replay_g.next_response = __next( replay_g.next_response + 1, __is_response );
+	}
+}
+
+bool replay_transport_done()
+{
+	return (replay_g.next_request >= replay_g.trace->n_records)
+		&& (replay_g.next_response >= replay_g.trace->n_records);
+}
+
+moon_ret_t moon_transport_init()
+{
+	return MOON_RET_OK;
+}
+
+uint8_t * moon_transport_get_msg_buffer()
+{
+	return replay_g.buffer;
+}
+
+uint32_t moon_transport_get_read_length()
+{
+	return replay_g.read_len;
+}
+
+uint32_t moon_transport_get_max_length()
+{
+	return FRAME_TRACE_DATA_LEN;
+}
+
+// Requests are handed over whole; there's never one partway in
+bool moon_transport_is_idle()
+{
+	return true;
+}
+
+moon_ret_t moon_transport_read()
+{
+	const frame_trace_record_t * record;
+	uint32_t index;
+
+	// A response recorded ahead of the next request: the server has had the
+	// poll this read was in to write it
+	while ( replay_g.next_response < replay_g.next_request ) {
+		if ( ! replay_g.owed ) {
+			replay_g.owed = true;
+			return MOON_RET_MSG_NOT_READY;
+		}
+
+		replay_g.result->missing++;
+		if ( replay_g.result->missing + replay_g.result->diverged <= replay_g.opts->max_report ) {
+			index = replay_g.next_response;
+			__print_frame( index, "!=", replay_g.trace->records[index].data, replay_g.trace->records[index].len,
+				"recorded, not replayed" );
+		}
+
+		replay_g.owed = false;
+		replay_g.next_response = __next( replay_g.next_response + 1, __is_response );
+	}
+
+	if ( replay_g.next_request >= replay_g.trace->n_records ) {
+		return MOON_RET_MSG_NOT_READY;
+	}
+
+	if ( replay_g.idle ) {
+		replay_g.idle--;
+		return MOON_RET_MSG_NOT_READY;
+	}
+
+	index = replay_g.next_request;
+	record = &replay_g.trace->records[index];
+
+	replay_g.next_request = __next( index + 1, __is_request );
+	__set_idle();
+
+	if ( (record->kind == FRAME_TRACE_RX_CRC) || (record->kind == FRAME_TRACE_RX_ERROR) ) {
+		replay_g.result->link_errors++;
+		if ( replay_g.opts->verbose ) {
+			__print_frame( index, "rx", record->data, record->len,
+				(record->kind == FRAME_TRACE_RX_CRC) ? "bad CRC" : "character error" );
+		}
+		return MOON_RET_E_TRANSPORT;
+	}
+
+	memcpy( replay_g.buffer, record->data, record->len );
+	replay_g.read_len = record->len;
+
+	replay_g.delivered = index;
+	moon_codec_read_header( replay_g.buffer, &replay_g.delivered_header );
+	replay_g.result->requests++;
+
+	if ( replay_g.opts->verbose ) {
+		__print_frame( index, "rx", record->data, record->len, "" );
+	}
+
+	replay_g.delivered_at = trace_now();
+
+	return MOON_RET_MSG_READY;
+}
+
+static inline bool __same_message( const moon_msg_hdr_t * a, const moon_msg_hdr_t * b )
+{
+	return (a->service == b->service) && (a->method == b->method)
+		&& (a->sequence == b->sequence) && (a->type == b->type);
+}
+
+moon_ret_t moon_transport_write( uint32_t len )
+{
+	uint32_t now = trace_now();
+	const replay_trace_t * trace = replay_g.trace;
+	const frame_trace_record_t * expected = NULL;
+	replay_timing_t * timing;
+	moon_msg_hdr_t header;
+	moon_msg_hdr_t recorded;
+	uint32_t index = replay_g.next_response;
+	uint32_t ticks;
+	bool same = false;
+
+	replay_g.owed = false;
+	replay_g.result->responses++;
+
+	moon_codec_read_header( replay_g.buffer, &header );
+
+	if ( index < trace->n_records ) {
+		expected = &trace->records[index];
+
+		// The host got it with a bad CRC; all we know is there was one
+		if ( expected->kind == FRAME_TRACE_RX_CRC ) {
+			replay_g.result->ignored++;
+			replay_g.next_response = __next( index + 1, __is_response );
+			if ( replay_g.opts->verbose ) {
+				__print_frame( index, "tx", replay_g.buffer, len, "recorded with a bad CRC" );
+			}
+			return MOON_RET_OK;
+		}
+
+		same = (expected->len >= 3) && (moon_codec_read_header( (uint8_t *)expected->data, &recorded ) >= 0)
+			&& __same_message( &header, &recorded );
+	}
+
+	if ( ! same ) {
+		// A response the host never saw, or a stream frame past the ones the
+		// device got out before the next request came in
+		if ( (trace->header.origin == FRAME_TRACE_ORIGIN_HOST) || (header.type == MSG_TYPE_MULTI_STREAM) ) {
+			replay_g.result->unseen++;
+			replay_g.idle = 0;
+			if ( replay_g.opts->verbose ) {
+				__print_frame( index, "tx", replay_g.buffer, len, "not recorded" );
+			}
+			return MOON_RET_OK;
+		}
+
+		if ( ! expected ) {
+			replay_g.result->diverged++;
+			if ( replay_g.result->diverged <= replay_g.opts->max_report ) {
+				__print_frame( trace->n_records - 1, "!=", replay_g.buffer, len, "replayed past the end of the trace" );
+			}
+			return MOON_RET_OK;
+		}
+
+		__report( index, replay_g.buffer, len, "a response to something else" );
+		replay_g.next_response = __next( index + 1, __is_response );
+		return MOON_RET_OK;
+	}
+
+	replay_g.next_response = __next( index + 1, __is_response );
+
+	if ( replay_g.opts->ignore & (1ULL << header.method) ) {
+		replay_g.result->ignored++;
+	} else if ( (len != expected->len) || memcmp( replay_g.buffer, expected->data, len ) ) {
+		__report( index, replay_g.buffer, len, "differs" );
+	} else {
+		replay_g.result->matched++;
+	}
+
+	if ( replay_g.opts->verbose ) {
+		__print_frame( index, "tx", replay_g.buffer, len, "" );
+	}
+
+	// Request to response (stream frames don't count)
+	if ( (replay_g.delivered >= 0) && (header.type == MSG_TYPE_SINGLE_NORMAL)
+		&& __same_message( &header, &replay_g.delivered_header ) ) {
+		timing = &replay_g.result->timing[header.method];
+		timing->count++;
+
+		ticks = expected->time - trace->records[replay_g.delivered].time;
+		timing->recorded += ticks;
+		if ( ticks > timing->recorded_max ) {
+			timing->recorded_max = ticks;
+		}
+
+		ticks = now - replay_g.delivered_at;
+		timing->replayed += ticks;
+		if ( ticks > timing->replayed_max ) {
+			timing->replayed_max = ticks;
+		}
+
+		replay_g.delivered = (-1);
+	}
+
+	return MOON_RET_OK;
+}
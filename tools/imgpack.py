@@ -0,0 +1,75 @@
+import argparse
+import sys
+
+from bootloader import image
+from bootloader import segments
+
+def main(args):
+    if args.info:
+        with open(args.input, 'rb') as f:
+            header, crcs, binary = image.unpack_image(f.read())
+        if header is None:
+            print('{0}: raw binary ({1} bytes), no image header'.format(args.input, len(binary)))
+        else:
+            print('{0}: {1}'.format(args.input, header))
+        return 0
+
+    with open(args.input, 'rb') as f:
+        binary = f.read()
+
+    elf_or_hex = segments.load(binary)
+
+    if args.slot == 'any':
+        slot = image.IMAGE_SLOT_ANY
+        load_address = args.load_address
+        if load_address is None:
+            print('--load-address is required with --app any')
+            return 1
+    else:
+        slot = int(args.slot) - 1
+        load_address = args.load_address if args.load_address is not None else image.slot_address(args.board, slot)
+
+    # ELF / HEX: the segments are flattened from the load address (gaps FF)
+    if elf_or_hex is not None:
+        binary = segments.to_slot(elf_or_hex, load_address, image.APP_SIZE)
+
+    page_size = args.page_size or board_page_size[args.board]
+
+    data = image.pack_image(binary, load_address, page_size, slot=slot, with_page_crcs=args.page_crcs)
+
+    output = args.output or (args.input.rsplit('.', 1)[0] + '.img')
+    with open(output, 'wb') as f:
+        f.write(data)
+
+    print('{0}: {1}'.format(output, image.ImageHeader.unpack(data)))
+    return 0
+
+board_page_size = {
+    'v71': 512,
+    'rh71': 256
+}
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Prepends an image header (length, CRC-32, slot, load address) to an application binary')
+    parser.add_argument('input', help='Application binary, ELF or Intel HEX file (or image, with --info)')
+    parser.add_argument('-o', '--output', dest='output',
+                        help='Image file to write (default: input with an .img extension)')
+    parser.add_argument('-a', '--app', dest='slot', default='1', choices=['1', '2', 'any'],
+                        help='Slot the binary was linked for; the device rejects it for the other slot')
+    parser.add_argument('--load-address', dest='load_address', type=lambda x: int(x, 0),
+                        help='Address the binary was linked to run from (default: start of the slot)')
+    parser.add_argument('--page-crcs', dest='page_crcs', action='store_true',
+                        help='Include a per-page CRC-32 table')
+    parser.add_argument('-ps', '--page-size', dest='page_size', type=int,
+                        help='Flash page size in bytes (default: from the board)')
+    parser.add_argument('--info', dest='info', action='store_true',
+                        help='Print the header of an existing image and exit')
+
+    bc = parser.add_argument_group('board configs', 'choose board config from the following. defaults to v71.').add_mutually_exclusive_group()
+    bc.add_argument('-v71', '--v71', action='store_const', dest='board', const='v71')
+    bc.add_argument('-rh71', '--rh71', action='store_const', dest='board', const='rh71')
+
+    args = parser.parse_args()
+    args.board = args.board or 'v71'
+
+    sys.exit(main(args))
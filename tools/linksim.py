@@ -0,0 +1,216 @@
+"""Goodput of the upload path over a faulty link.
+
+Uploads an image to a simulated device (blsim.py) through its simulated
+link, with bit errors, dropped bytes, bursts, latency and bandwidth limits
+as given (see blsim.py), and reports per run:
+
+- goodput: image bytes per second of the upload, counted only if the device
+  verifies the slot afterwards
+- efficiency: image bytes per byte that went over the wire either way
+- frames sent and resent, bad frames received, requests the device lost to
+  overruns
+- time to recover: first send to response of the requests that had to be
+  resent (median and worst), and with --outage, from the end of the outage
+  to the first response after it
+
+--sweep runs the same upload for each value of one link parameter, --runs
+repeats each with other seeds. Everything is in one process (the device is
+served from the same event loop, over a pty), so runs are repeatable.
+
+    $ python3 linksim.py -br 115200 --sweep ber 0 1e-5 5e-5 1e-4 2e-4
+    $ python3 linksim.py --burst-rate 1e-4 --burst-len 32 --runs 5 -o bursts.json
+    $ python3 linksim.py --outage 0.5 0.5
+"""
+
+import argparse
+import asyncio
+import json
+import random
+import statistics
+import struct
+import sys
+import time
+import zlib
+
+import serial
+
+import blsim
+import bootloader
+from bootloader.uploader import MESSAGE_LEN_MAX, WRITE_PAGE_BUFFER_OVERHEAD, Link, UploadError, call, upload
+
+_IDS = bootloader.interface.IBootloader
+
+SWEEPABLE = ('ber', 'byte_drop', 'burst_rate', 'burst_len', 'latency', 'bandwidth')
+
+class RunResult(object):
+    def __init__(self, value, seed):
+        self.value = value
+        self.seed = seed
+        self.ok = False
+        self.error = None
+        self.seconds = None
+        self.goodput = None
+        self.efficiency = None
+        self.sent = 0
+        self.resent = 0
+        self.bad_frames = 0
+        self.overruns = 0
+        self.smallest_chunk = None
+        self.recovery_median = None
+        self.recovery_max = None
+        self.outage_recovery = None
+
+async def _checked(link, what, method, args):
+    r = await call(link, method, args)
+    if r != 0:
+        raise UploadError('{0} failed ({1})'.format(what, r))
+
+async def _run(loop, args, device, result, binf):
+    port = serial.Serial(device.path, args.baud_rate, timeout=0)
+    link = Link(port, loop, retries=args.retries)
+    try:
+        slot_args = struct.pack('<BII', 0, len(binf), zlib.crc32(binf))
+        await _checked(link, 'bl_beginUpload', _IDS.BL_BEGINUPLOAD_ID, slot_args)
+
+        outage_end = None
+        if args.outage:
+            at, duration = args.outage
+            loop.call_later(at, device.cut, duration)
+            outage_end = time.monotonic() + at + duration
+
+        pages = bootloader.segments.data_pages(binf, args.page_size)
+        chunk = MESSAGE_LEN_MAX - WRITE_PAGE_BUFFER_OVERHEAD
+        if args.chunk:
+            chunk = min(chunk, args.chunk)
+
+        wire_bytes = link.wire_bytes
+        start = time.monotonic()
+        try:
+            tuner = await upload(link, 0, binf, pages, args.page_size, chunk, retries=args.retries)
+        finally:
+            result.seconds = time.monotonic() - start
+        result.smallest_chunk = tuner.smallest
+        result.efficiency = len(binf) / max(1, link.wire_bytes - wire_bytes)
+
+        await _checked(link, 'bl_verifyApp', _IDS.BL_VERIFYAPP_ID, slot_args)
+        result.goodput = len(binf) / result.seconds
+        result.ok = True
+
+        if outage_end is not None:
+            after = [answered for _, answered in link.recovered if answered >= outage_end]
+            if after:
+                result.outage_recovery = min(after) - outage_end
+    finally:
+        result.sent = link.sent
+        result.resent = link.resent
+        result.bad_frames = link.bad_frames
+        recoveries = [answered - first for first, answered in link.recovered]
+        if recoveries:
+            result.recovery_median = statistics.median(recoveries)
+            result.recovery_max = max(recoveries)
+        link.close()
+        port.close()
+
+def run_once(args, value, seed, binf):
+    params = blsim.link_params(args)
+    if args.sweep:
+        setattr(params, args.sweep_name, value)
+
+    loop = asyncio.new_event_loop()
+    device = blsim.SimDevice(loop, args.page_size, args.baud_rate, seed=seed, link=params)
+    result = RunResult(value, seed)
+    try:
+        loop.run_until_complete(_run(loop, args, device, result, binf))
+    except (UploadError, asyncio.TimeoutError) as e:
+        result.error = str(e) or type(e).__name__
+    finally:
+        result.overruns = device.dropped
+        device.close()
+        loop.close()
+    return result
+
+def _ms(seconds):
+    return '-' if seconds is None else '{0:.0f}'.format(seconds * 1000.0)
+
+def _mean(values):
+    values = [v for v in values if v is not None]
+    return statistics.mean(values) if values else None
+
+def print_table(name, results, runs, out=print):
+    out('{0:>10}  {1:>5}  {2:>9}  {3:>5}  {4:>6}  {5:>6}  {6:>4}  {7:>4}  {8:>5}  {9:>6}  {10:>7}  {11:>6}'.format(
+        name, 'ok', 'goodput', 'eff', 'frames', 'resent', 'bad', 'ovr', 'chunk', 'rec50', 'rec-max', 'outage'))
+    for i in range(0, len(results), runs):
+        group = results[i:i + runs]
+        ok = [r for r in group if r.ok]
+        goodput = _mean([r.goodput for r in ok])
+        efficiency = _mean([r.efficiency for r in ok])
+        chunks = [r.smallest_chunk for r in group if r.smallest_chunk is not None]
+        maxima = [r.recovery_max for r in group if r.recovery_max is not None]
+        out('{0:>10}  {1:>5}  {2:>9}  {3:>5}  {4:>6.0f}  {5:>6.0f}  {6:>4.0f}  {7:>4.0f}  {8:>5}  {9:>6}  {10:>7}  {11:>6}'.format(
+            '-' if group[0].value is None else '{0:g}'.format(group[0].value),
+            '{0}/{1}'.format(len(ok), len(group)),
+            '-' if goodput is None else '{0:.0f}'.format(goodput),
+            '-' if efficiency is None else '{0:.0f}%'.format(efficiency * 100.0),
+            _mean([r.sent for r in group]), _mean([r.resent for r in group]),
+            _mean([r.bad_frames for r in group]), _mean([r.overruns for r in group]),
+            min(chunks) if chunks else '-',
+            _ms(_mean([r.recovery_median for r in group])), _ms(max(maxima) if maxima else None),
+            _ms(_mean([r.outage_recovery for r in ok]))))
+        for r in group:
+            if r.error:
+                out('{0:>10}  seed {1}: {2}'.format('', r.seed, r.error))
+
+def main():
+    parser = argparse.ArgumentParser(description='Upload goodput over a simulated faulty link')
+    parser.add_argument('-br', '--baud', dest='baud_rate', type=int, default=115200,
+                        help='Baud rate (default 115200)')
+    parser.add_argument('-ps', '--page-size', dest='page_size', type=int, default=512,
+                        help='Flash page size (512 V71, 256 RH71)')
+    parser.add_argument('--size', dest='size', type=int, default=16384,
+                        help='Bytes of random data to upload (default 16384)')
+    parser.add_argument('--chunk', dest='chunk', type=int,
+                        help='Largest bl_writePageBuffer chunk (default: a frame\'s worth; it\'s tuned down from there)')
+    parser.add_argument('-r', '--retries', dest='retries', type=int, default=5,
+                        help='Resends of a lost request before giving up (default 5)')
+    parser.add_argument('--outage', dest='outage', type=float, nargs=2, metavar=('AT', 'SECONDS'),
+                        help='Take the link down for SECONDS, AT seconds into the upload')
+    blsim.add_link_arguments(parser)
+    parser.add_argument('--sweep', dest='sweep', nargs='+', metavar='PARAM VALUE',
+                        help='A run per value of one link parameter ({0})'.format(', '.join(SWEEPABLE)))
+    parser.add_argument('--runs', dest='runs', type=int, default=1,
+                        help='Runs per setting, each with its own seed (default 1)')
+    parser.add_argument('-o', '--output', dest='output',
+                        help='Write every run as JSON here')
+    args = parser.parse_args()
+
+    values = [None]
+    if args.sweep:
+        args.sweep_name = args.sweep[0].replace('-', '_')
+        if args.sweep_name not in SWEEPABLE or len(args.sweep) < 2:
+            parser.error('--sweep takes one of {0} and its values'.format(', '.join(SWEEPABLE)))
+        values = [float(v) for v in args.sweep[1:]]
+
+    rng = random.Random(0)
+    binf = bytes(rng.getrandbits(8) for _ in range(args.size))
+
+    results = []
+    for value in values:
+        for seed in range(args.runs):
+            results.append(run_once(args, value, seed, binf))
+            print('.', end='', file=sys.stderr, flush=True)
+    print(file=sys.stderr)
+
+    print_table(args.sweep_name if args.sweep else 'run', results, args.runs)
+
+    if args.output:
+        setup = {key: getattr(args, key) for key in
+            ('baud_rate', 'page_size', 'size', 'chunk', 'retries', 'outage') + SWEEPABLE}
+        setup['sweep'] = args.sweep_name if args.sweep else None
+        with open(args.output, 'w') as f:
+            json.dump({'setup': setup, 'runs': [vars(r) for r in results]}, f, indent=2)
+            f.write('\n')
+
+    exit(0 if all(r.ok for r in results) else 1)
+
+if __name__ == "__main__":
+    main()